@@ -0,0 +1,50 @@
+/*
+ * 串口命令模块（USART1 和 USB 虚拟串口）
+ * - USART1 用 DMA 循环接收 + 空闲线中断分帧，USB 虚拟串口在接收回调里拷进环形缓冲，
+ *   主循环里 Cmd_Poll() 拼行、查命令表执行，不阻塞采样。两个口的命令相同，
+ *   #Q / #DL 的回传走命令来的那个口，文字回复由 printf 输出，两个口都有
+ * - 命令都在主循环里执行，除 #FORMAT 外都不会停住采样
+ * - 命令以 '#' 开头，和上位机的遥测行区分开；成功回 "#OK ..."，参数不对回 "#ERR ..."：
+ *     #TIME <unix秒>            校准软件时钟
+ *     #Q <起始unix秒> <结束unix秒>  按时间范围回传 SD 卡历史记录（见 query.h）
+ *     #DL <起始> <结束> [<块编号>]   批量下载压缩块，可从块编号处续传（见 query.h）
+ *     #ACK <n> / #NAK <n> / #STOP    批量下载的应答，下载期间也马上执行
+ *     #BAUD <波特率> / #BAUD OK  USART1 切换波特率 / 确认切换并保持（见 uartbaud.h）
+ *     #SCHEMA                   重发遥测通道表帧（见 telemetry.h）
+ *     #TLM BIN / #TLM TEXT      遥测改为二进制帧 / 文字行（调试用）
+ *     #CAL PH <k> <b>           pH 标定系数，pH = k * V + b（见 PH_SetCalibration）
+ *     #CAL TURB <K>             浊度标定截距，TU = -865.68 * U25 + K
+ *     #RATE <周期ms> <n>        采样周期，每 n 次采样向 SD 卡记一条，n 为 0 时暂停记录
+ *     #SYNC <扇区数> <毫秒>     SD 卡同步策略（见 SD_Card_SetSyncPolicy，0 表示关闭该条件）
+ *     #STATUS                   一行当前状态：时钟、采样和同步参数、标定、波特率、记录队列
+ *     #BENCH                    SD 卡读写测速（见 sdbench.h），在主循环里分步执行，采样不停
+ *     #FORMAT YES               把 SD 卡格式化为 FAT32 并重建日志（见 SD_Card_Format），清除全部数据。
+ *                               要几秒、期间采样停住，所以只在记录暂停时执行，否则回 #ERR FORMAT LOGGING
+ * - 标定和采样参数只在 RAM 里，重新上电恢复默认值
+ * - 回传期间会回文字的命令推迟到回传结束再执行（只留一条，再来的丢弃）
+ */
+
+#ifndef __CMD_H
+#define __CMD_H
+
+#include "stm32f1xx_hal.h"
+
+#define CMD_LINE_MAX    48U
+
+/* USART1 接收 DMA 循环缓冲 / USB 接收环形缓冲大小（USB 的必须是 2 的幂） */
+#ifndef CMD_RX_DMA
+#define CMD_RX_DMA      256U
+#endif
+
+#ifndef CMD_USB_RX
+#define CMD_USB_RX      256U
+#endif
+
+/* #RATE 允许的采样周期范围 */
+#define CMD_RATE_MIN_MS 200UL
+#define CMD_RATE_MAX_MS 3600000UL
+
+void Cmd_Init(void);
+void Cmd_Poll(void);
+
+#endif
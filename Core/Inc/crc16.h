@@ -0,0 +1,23 @@
+/*
+ * CRC-16/CCITT-FALSE（多项式 0x1021，初值 0xFFFF，不反射，不异或输出）
+ * - SD 卡二进制日志、串口数据块校验共用
+ * - 上位机 Python 端用同一算法校验（见 log_decoder.py）
+ */
+
+#ifndef __CRC16_H
+#define __CRC16_H
+
+#include <stdint.h>
+
+#define CRC16_INIT  0xFFFFU
+
+/* 在 crc 基础上继续累加 len 字节，首次调用传 CRC16_INIT */
+uint16_t CRC16_Update(uint16_t crc, const void *data, uint32_t len);
+
+/* 一次性计算整块数据的 CRC */
+static inline uint16_t CRC16_Calc(const void *data, uint32_t len)
+{
+    return CRC16_Update(CRC16_INIT, data, len);
+}
+
+#endif
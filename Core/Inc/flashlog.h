@@ -0,0 +1,72 @@
+/*
+ * 片内 Flash 后备日志（SD 卡不在或写卡出错期间，sdcard.c 把记录暂存到这里，卡恢复后再转存到卡上）
+ * - 占用 Flash 末尾 FLASH_LOG_PAGES 页，链接脚本里划为 FLASHLOG 区，程序不会放进去。
+ *   只有打开 CMake 选项 SD_FLASH_FALLBACK 时才划出这块（程序区从 64K 减到 64K - 8K）
+ * - 记录按 logblock.h 压缩成 512 字节的块，每页 2 块。块按序号依次写到下一个位置，
+ *   写到末尾回到开头，各页擦写次数相同；写满后擦掉最旧的一页接着写，其中没转存的块丢弃并计数
+ * - 块格式同裸分区（logrec.h），块尾留出 10 字节：
+ *     [500..501] 转存标志，写块时为 0xFFFF，转存到卡上后改写为 0（Flash 只能由 1 改成 0）
+ *     [502..509] LogRawTrailer_t，seq 为块序号，gen 固定为 FLASH_LOG_GEN
+ *   CRC 按转存标志为 0xFFFF 计算，所以待转存的块可以直接在 Flash 里解码
+ * - 块在 RAM 里编码，写满才烧写（256 次半字编程，约 10ms）。擦除（约 20ms）由 FlashLog_Poll
+ *   提前做，下一块要写的页总是已经擦好，FlashLog_Add 正常情况下不用等擦除
+ * - 没写满的块每隔 FLASH_LOG_FLUSH_MS 或供电跌落时提前写出，掉电最多丢这段时间的记录；
+ *   RAM 块放在 .noinit 段，看门狗等热复位后 FlashLog_Init 接着用，不丢
+ * - 擦写期间 CPU 从 Flash 取指会停住，所以只在主循环里做；采样的记录先进 sdcard.c 的队列，
+ *   不受影响
+ */
+
+#ifndef __FLASHLOG_H
+#define __FLASHLOG_H
+
+#include "logrec.h"
+#include "stm32f1xx_hal.h"
+
+/* STM32F103C8（中容量）Flash 页大小 */
+#define FLASH_LOG_PAGE_SIZE     1024U
+
+/* 占用的页数，由 CMake 的 FLASH_LOG_PAGES 同时传给这里和链接脚本（FLASHLOG 区大小）。
+ * 8 页 = 16 块，一块通常能放 100~500 条记录，按 5 秒一条约 2~11 小时 */
+#ifndef FLASH_LOG_PAGES
+#define FLASH_LOG_PAGES         8U
+#endif
+
+#define FLASH_LOG_GEN           0x48534C46UL    /* "FLSH" */
+
+/* 没写满的块最多在 RAM 里放多久 */
+#ifndef FLASH_LOG_FLUSH_MS
+#define FLASH_LOG_FLUSH_MS      (30UL * 60UL * 1000UL)
+#endif
+
+/* 上电时调用一次：扫描 Flash，恢复写入位置和还没转存的块 */
+void FlashLog_Init(void);
+
+/* 追加一条记录，块写满时烧写到 Flash。返回 0 成功，-1 烧写失败（那一块丢弃） */
+int FlashLog_Add(const LogRecord_t *rec);
+
+/* 把 RAM 里没写满的块写到 Flash（供电跌落、关机前调用） */
+void FlashLog_Flush(void);
+
+/* 主循环里调用：提前擦除下一页，到时间写出没写满的块 */
+void FlashLog_Poll(void);
+
+/* 待转存的块数（含 RAM 里没写满的块） */
+uint16_t FlashLog_Pending(void);
+
+/*
+ * 最旧的待转存块（Flash 地址，可直接 LogBlock_Open 解码），没有时返回 NULL。
+ * Flash 里的块都转存完后先把 RAM 里没写满的块写出再返回它。
+ * 块里的记录写上卡并同步后调用 FlashLog_Release 作废这一块。
+ * FlashLog_Release 返回 0 成功；-1 作废标记没写上，这一块留着（复位后会再转存一次），
+ * 之后 FlashLog_Oldest 先补写标记，补写成功前返回 NULL，不会在本次运行中重复转存。
+ */
+const uint8_t *FlashLog_Oldest(void);
+int FlashLog_Release(void);
+
+/* 待转存的记录里最新的一条（复位后接着编序号用），返回 0 成功，-1 没有待转存的记录 */
+int FlashLog_Newest(LogRecord_t *rec);
+
+/* 待转存块数、因 Flash 写满被覆盖而丢弃的块数、作废标记写失败的次数（参数可为 NULL） */
+void FlashLog_GetStats(uint16_t *pending, uint32_t *dropped, uint32_t *release_errors);
+
+#endif
@@ -36,12 +36,59 @@ extern I2C_HandleTypeDef hi2c1;
 
 /* USER CODE BEGIN Private defines */
 
+/* I2C1 总线事务队列
+ * - 所有挂在 I2C1 上的设备（OLED、外置 ADC、溶解氧模块等）都通过队列提交事务
+ * - 事务由中断驱动，上一笔完成的中断里直接启动下一笔，总线不留空档
+ * - 每次只在事务边界做调度：优先级数值越小越先执行，同优先级按提交顺序 */
+#define I2C_BUS_QUEUE_LEN    16U   /* 同时排队的事务数 */
+#define I2C_BUS_INLINE_MAX   17U   /* 写数据在队列内的拷贝上限（OLED 控制字节 + 16 字节数据） */
+#define I2C_BUS_SENSOR_RESERVE 4U  /* 只留给 I2C_PRIO_SENSOR 的空闲槽位，显示刷新占不满队列 */
+
+#define I2C_PRIO_SENSOR      0U    /* 传感器读写，最高优先级 */
+#define I2C_PRIO_NORMAL      1U
+#define I2C_PRIO_DISPLAY     2U    /* 显示刷新，只在没有传感器事务时占用总线 */
+#define I2C_PRIO_LEVELS      3U
+
+/* 事务完成回调，在 I2C 中断上下文中执行，应尽量简短
+ * status: HAL_OK 成功，HAL_ERROR 设备无应答或总线错误 */
+typedef void (*I2C_BusCallback)(HAL_StatusTypeDef status, void *ctx);
+
 /* USER CODE END Private defines */
 
 void MX_I2C1_Init(void);
 
 /* USER CODE BEGIN Prototypes */
 
+/* 提交一次写事务，data 会被拷贝进队列，调用返回后即可复用
+ * 返回 HAL_BUSY 表示队列已满（非传感器优先级只能用到剩 I2C_BUS_SENSOR_RESERVE 个槽位为止），
+ * HAL_ERROR 表示参数不合法 */
+HAL_StatusTypeDef I2C_Bus_Write(uint16_t dev_addr, uint8_t prio,
+                                const uint8_t *data, uint16_t len,
+                                I2C_BusCallback cb, void *ctx);
+
+/* 提交一次读事务，buf 必须保持有效直到回调返回 */
+HAL_StatusTypeDef I2C_Bus_Read(uint16_t dev_addr, uint8_t prio,
+                               uint8_t *buf, uint16_t len,
+                               I2C_BusCallback cb, void *ctx);
+
+/* 寄存器读：先写 mem_addr（1 或 2 字节），重复起始后读 len 字节 */
+HAL_StatusTypeDef I2C_Bus_MemRead(uint16_t dev_addr, uint8_t prio,
+                                  uint16_t mem_addr, uint16_t mem_addr_size,
+                                  uint8_t *buf, uint16_t len,
+                                  I2C_BusCallback cb, void *ctx);
+
+/* 寄存器写：data 同样会被拷贝进队列 */
+HAL_StatusTypeDef I2C_Bus_MemWrite(uint16_t dev_addr, uint8_t prio,
+                                   uint16_t mem_addr, uint16_t mem_addr_size,
+                                   const uint8_t *data, uint16_t len,
+                                   I2C_BusCallback cb, void *ctx);
+
+/* 队列与总线都空闲时返回 1 */
+uint8_t I2C_Bus_IsIdle(void);
+
+/* 等待队列排空，超时返回 HAL_TIMEOUT */
+HAL_StatusTypeDef I2C_Bus_Flush(uint32_t timeout_ms);
+
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
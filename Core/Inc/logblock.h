@@ -0,0 +1,56 @@
+/*
+ * SD 日志压缩块编解码（格式见 logrec.h）
+ * - 每块第一条记录原样保存，之后每条只存和前一条的差：
+ *     时间戳      : 差值的差（delta-of-delta），定时记录时几乎总是 0
+ *     质量标志    : 1 位"是否变化"，变化时再跟 8 位新值
+ *     各通道定点值 : 差值
+ *   序号隐含为前一条 + 1。
+ * - 差值先 zig-zag 变成无符号数，再按下表变长编码（前缀为若干个 1 加一个 0）：
+ *     0            -> "0"               1 位
+ *     < 16         -> "10"   + 4 位     6 位
+ *     < 256        -> "110"  + 8 位     11 位
+ *     < 65536      -> "1110" + 16 位    20 位
+ *     其它         -> "1111" + 32 位    36 位
+ *   水质数据变化缓慢，一条记录通常只需 1~4 字节，一块可放 100~500 条。
+ * - 块与块之间没有依赖，任何一个扇区都能单独解码；上位机解码见 log_decoder.py。
+ */
+
+#ifndef __LOGBLOCK_H
+#define __LOGBLOCK_H
+
+#include "logrec.h"
+
+/* 编码和解码共用的块状态 */
+typedef struct
+{
+    uint8_t    *blk;        /* LOG_BLOCK_SIZE 字节的块缓冲 */
+    uint16_t    count;      /* 块内记录条数 */
+    uint16_t    index;      /* 解码：已取出的条数 */
+    uint16_t    bitpos;     /* 位流已用位数 */
+    uint16_t    limit;      /* 位流可用位数，默认 LOG_BLOCK_BITS */
+    uint32_t    delta;      /* 上一条的时间戳差 */
+    LogRecord_t prev;       /* 上一条记录 */
+} LogBlock_t;
+
+/* 以 first 为第一条开始一个新块（块缓冲清零） */
+void LogBlock_Start(LogBlock_t *b, uint8_t *blk, const LogRecord_t *first);
+
+/* 追加一条记录，返回 0 成功，-1 块内放不下或序号不连续（需要换新块） */
+int LogBlock_Add(LogBlock_t *b, const LogRecord_t *rec);
+
+/* 位流末尾留出 bytes 字节给调用者（裸分区的块尾），在 LogBlock_Start / LogBlock_Resume 之后调用 */
+void LogBlock_Reserve(LogBlock_t *b, uint16_t bytes);
+
+/* 写入记录条数和 CRC，之后块缓冲可以直接写卡；写完还能继续 LogBlock_Add */
+void LogBlock_Finish(LogBlock_t *b);
+
+/* 校验块并准备解码，返回记录条数，-1 表示不是有效的块 */
+int LogBlock_Open(LogBlock_t *b, uint8_t *blk);
+
+/* 取出下一条记录（CRC 重新计算），返回 1 成功，0 已取完或数据错误 */
+int LogBlock_Next(LogBlock_t *b, LogRecord_t *rec);
+
+/* 读入已有的块并恢复编码状态，之后可以接着 LogBlock_Add。返回 0 成功，-1 块无效 */
+int LogBlock_Resume(LogBlock_t *b, uint8_t *blk);
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * 测量通道表（SD 卡日志和实时遥测共用）
+ * - 名称、单位、类型、scale 写进日志文件头和遥测通道表帧，[lo, hi] 和越界标志决定定点换算
+ * - 两边的定点值因此完全相同，采样帧里的值可以直接和历史记录比对
+ * - 改动这张表要同步提升 LOG_VERSION 和 TELEM_VERSION（logrec.h、telemetry.h）
+ */
+
+#ifndef __LOGCHAN_H
+#define __LOGCHAN_H
+
+#include "logrec.h"
+
+/* 通道序号，和 g_logChannels 一一对应 */
+#define LOG_CH_PH           0U
+#define LOG_CH_TEMP         1U
+#define LOG_CH_TDS          2U
+#define LOG_CH_TURB         3U
+#define LOG_CHANNELS        4U
+
+/* 通道描述：desc 原样写进文件头，[lo, hi] 为定点范围，越界置 flag */
+typedef struct
+{
+    LogChannel_t desc;
+    int32_t      lo;
+    int32_t      hi;
+    uint8_t      flag;      /* LOG_FLAG_xxx */
+} LogChanDef_t;
+
+extern const LogChanDef_t g_logChannels[LOG_CHANNELS];
+
+/* 物理值转定点：乘 scale 后四舍五入并截断到 [lo, hi]，越界（含 NaN）时置 *flags |= flag */
+int32_t LogChan_Fixed(uint8_t ch, float v, uint8_t *flags);
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * SD 卡二进制日志格式（DATA.BIN）
+ *
+ * 文件布局（版本 2）：
+ *   扇区 0       : LogHeader_t，512 字节，描述版本和通道
+ *   扇区 1 起    : 压缩块，每扇区一块，每块可以单独解码（编码见 logblock.h）：
+ *                    [0..15]    块内第一条记录，完整的 LogRecord_t
+ *                    [16..17]   块内记录条数
+ *                    [18..509]  之后各条记录相对前一条的差值位流
+ *                    [510..511] CRC16，覆盖前 510 字节
+ *   data_end 之后 : 预分配空间，内容不确定（可能是旧数据）
+ *
+ * 版本 1 的数据区是连续的 LogRecord_t（每扇区 32 条），log_decoder.py 两种都能解码。
+ *
+ * 裸分区（SD_LOG_RAW，不经 FatFs，见 sdraw.h）：MBR 中类型为 LOG_RAW_PART_TYPE 的分区
+ *   扇区 0       : LogHeader_t，gen 为格式化代号，data_end 不用
+ *   扇区 1 起    : 环形块区，序号为 seq 的块写在第 1 + seq % 块数 个扇区。块格式同上，
+ *                  只是位流缩短到 [18..501]，[502..509] 为 LogRawTrailer_t，CRC 同样覆盖前 510 字节
+ *
+ * 所有多字节字段均为小端（与 Cortex-M3 内存布局一致，直接 memcpy 即可）。
+ * 上位机解码见 log_decoder.py，两边的格式改动必须同步并提升 LOG_VERSION。
+ */
+
+#ifndef __LOGREC_H
+#define __LOGREC_H
+
+#include <stdint.h>
+
+#define LOG_MAGIC0          'W'
+#define LOG_MAGIC1          'Q'
+#define LOG_MAGIC2          'L'
+#define LOG_MAGIC3          'G'
+#define LOG_VERSION         2U
+
+#define LOG_HEADER_SIZE     512U
+#define LOG_RECORD_SIZE     16U
+#define LOG_RECS_PER_SECTOR (512U / LOG_RECORD_SIZE)
+#define LOG_CHAN_MAX        8U
+
+/* 压缩块 */
+#define LOG_BLOCK_SIZE      512U
+#define LOG_BLOCK_HDR       (LOG_RECORD_SIZE + 2U)  /* 首条完整记录 + 记录条数 */
+#define LOG_BLOCK_BITS      ((LOG_BLOCK_SIZE - LOG_BLOCK_HDR - 2U) * 8U)
+
+/* 裸分区 */
+#define LOG_RAW_PART_TYPE   0xDAU   /* MBR 分区类型：Non-FS data */
+#define LOG_RAW_TRAILER     8U      /* 块尾 LogRawTrailer_t 的字节数 */
+
+/* 通道数值类型 */
+#define LOG_TYPE_I16        1U
+#define LOG_TYPE_U16        2U
+
+/* 记录质量标志 */
+#define LOG_FLAG_PH_RANGE   0x01U   /* pH 超出 0~14，已截断 */
+#define LOG_FLAG_TEMP_FAULT 0x02U   /* DS18B20 读数异常（<-50 或 >125 ℃） */
+#define LOG_FLAG_TDS_RANGE  0x04U   /* TDS 超出 u16 范围，已截断 */
+#define LOG_FLAG_TURB_RANGE 0x08U   /* 浊度为负或超出 6553.5，已截断 */
+#define LOG_FLAG_TIME_UNSET 0x80U   /* 时钟未校准，ts 为上电后的秒数 */
+
+/* 通道描述：物理值 = 原始值 / scale */
+typedef struct
+{
+    char     name[8];
+    char     unit[4];
+    uint8_t  type;      /* LOG_TYPE_xxx */
+    uint8_t  offset;    /* 在 LogRecord_t 中的字节偏移 */
+    uint16_t scale;
+} LogChannel_t;
+
+typedef struct
+{
+    char         magic[4];      /* "WQLG" */
+    uint16_t     version;       /* LOG_VERSION */
+    uint16_t     header_size;   /* LOG_HEADER_SIZE */
+    uint16_t     record_size;   /* LOG_RECORD_SIZE */
+    uint8_t      chan_count;
+    uint8_t      flags;         /* 创建时的 LOG_FLAG_TIME_UNSET */
+    uint32_t     created;       /* 创建时间，Unix 秒 */
+    uint32_t     period_ms;     /* 记录周期（仅供参考） */
+    uint32_t     data_end;      /* 有效数据末尾（文件偏移），0 表示以文件大小为准 */
+    uint32_t     gen;           /* 裸分区的格式化代号，文件中为 0 */
+    LogChannel_t chan[LOG_CHAN_MAX];
+    uint8_t      pad[LOG_HEADER_SIZE - 28U - 16U * LOG_CHAN_MAX - 2U];
+    uint16_t     crc;           /* CRC16，覆盖前 510 字节 */
+} LogHeader_t;
+
+typedef struct
+{
+    uint32_t ts;        /* Unix 秒 */
+    int16_t  ph;        /* pH x100 */
+    int16_t  temp;      /* 温度 ℃ x100 */
+    uint16_t tds;       /* TDS ppm */
+    uint16_t turb;      /* 浊度 TU x10 */
+    uint8_t  flags;     /* LOG_FLAG_xxx */
+    uint8_t  seq;       /* 记录序号低 8 位，用于发现丢条 */
+    uint16_t crc;       /* CRC16，覆盖前 14 字节 */
+} LogRecord_t;
+
+/* 索引文件（.IDX）：连续的 LogIndex_t，每个压缩块一项 */
+typedef struct
+{
+    uint32_t ts;        /* 块内第一条记录的时间戳 */
+    uint32_t offset;    /* 该块在数据文件中的偏移 */
+} LogIndex_t;
+
+/* 裸分区块尾：不属于本次格式化（gen 不符）或序号与扇区位置不符的块都是旧数据 */
+typedef struct
+{
+    uint32_t seq;       /* 块序号，从 0 起连续递增，不随环形回绕重置 */
+    uint32_t gen;       /* 与分区头 gen 相同 */
+} LogRawTrailer_t;
+
+_Static_assert(sizeof(LogRawTrailer_t) == LOG_RAW_TRAILER, "LogRawTrailer_t size");
+_Static_assert(sizeof(LogHeader_t) == LOG_HEADER_SIZE, "LogHeader_t size");
+_Static_assert(sizeof(LogRecord_t) == LOG_RECORD_SIZE, "LogRecord_t size");
+
+#endif
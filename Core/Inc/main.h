@@ -46,6 +46,9 @@ extern "C" {
 
 /* Exported macro ------------------------------------------------------------*/
 /* USER CODE BEGIN EM */
+/* 放进 .noinit 段的变量：启动代码不清零，热复位（看门狗、NRST、软件复位）后内容还在，
+ * 上电复位时是随机值，使用者自己校验（链接脚本 STM32F103XX_FLASH.ld） */
+#define NOINIT_RAM  __attribute__((section(".noinit")))
 
 /* USER CODE END EM */
 
@@ -53,6 +56,11 @@ extern "C" {
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
+/* 运行参数（main.c），串口命令 #RATE / #CAL TURB 修改，下一个采样周期生效；log_every 为 0 时暂停记录 */
+void App_SetSampling(uint32_t period_ms, uint16_t log_every);
+void App_GetSampling(uint32_t *period_ms, uint16_t *log_every);
+void App_SetTurbidityK(float k);
+float App_GetTurbidityK(void);
 
 /* USER CODE END EFP */
 
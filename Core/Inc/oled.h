@@ -5,7 +5,7 @@
 
 void OLED_Init(void);
 void OLED_Clear(void);
-void OLED_SetCursor(uint8_t column, uint8_t page);
+void OLED_Poll(void);
 void OLED_Print(uint8_t column, uint8_t page, const char *text);
 void OLED_PrintLarge(uint8_t column, uint8_t page, const char *text);
 
@@ -15,5 +15,8 @@ float PH_ReadPH(void);
 // 标定后可以把算出来的 k、b 写进去
 void PH_SetCalibration(float k, float b);
 
+// 读出当前的 k、b，返回 1 表示已用 PH_SetCalibration 标定（否则按手册三点插值，k、b 不用）
+uint8_t PH_GetCalibration(float *k, float *b);
+
 
 #endif
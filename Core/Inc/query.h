@@ -0,0 +1,80 @@
+/*
+ * 历史记录回传模块
+ * - 串口命令 "#Q <起始> <结束>" 触发，从 SD 卡日志里按时间范围读取记录，
+ *   以二进制帧发给上位机：命令从 USART1 来就经 USART1 DMA 发，从 USB 虚拟串口来就经 USB 发
+ *   （usbcdc.h，速度快得多）。文字行（#QBEGIN 等）由 printf 输出，两个口都有
+ * - 回传格式：
+ *     "#QBEGIN <起始> <结束>\r\n"
+ *     若干数据帧：0xA5, n, n 条 LogRecord_t（每条 16 字节，n <= 32）
+ *     结束帧：0xA5, 0
+ *     "#END <记录条数>\r\n"
+ * - 回传期间主循环照常采样和记录，只是暂停串口遥测输出
+ *
+ * 批量下载（整段日志拷到 PC）：
+ * - 串口命令 "#DL <起始> <结束> [<块编号>]" 触发，不解压，把时间范围内的压缩块（每块 512 字节，
+ *   通常 100~500 条记录）原样发出，同样的波特率下比 #Q 快 5~15 倍。首块可能含有早于起始的记录，
+ *   末块可能含有晚于结束的记录，由上位机按时间筛选；"#DL 0 4294967295" 下载全部日志
+ * - 回传格式：
+ *     "#DLBEGIN <起始> <结束> <起始块编号>\r\n"
+ *     若干帧：0xA6, 类型, 编号（u32）, [512 字节], CRC16（类型到数据末尾，crc16.h）
+ *       'H' 文件头（SD_Card_GetHeader），编号为起始块编号，不占编号
+ *       'B' 一块，编号为块编号（SD_Card_SeekBlock）
+ *       'S' 这个编号的块已不存在（裸分区里被覆盖），没有数据
+ *       'E' 结束，没有数据，占一个编号
+ *     "#END <结束帧编号>\r\n"；重发失败时为 "#ERR DL <已确认编号>\r\n"
+ *   上位机把文件头和各块依次存起来就是版本 2 的 .BIN，用 log_decoder.py 解码
+ * - 滑动窗口：上位机每收到一帧回 "#ACK <n>"（编号 n 之前的帧都收到了），已发出未确认的帧
+ *   最多 QUERY_WINDOW 个。校验错或编号不接续时回 "#NAK <n>"，从 n 重发（n 小于起始块编号时
+ *   连文件头一起重发）；QUERY_ACK_TIMEOUT_MS 内没有新确认也从已确认处重发，
+ *   连续 QUERY_RETRY_MAX 次没有进展就放弃。"#STOP" 中止，回 "#OK STOP <已确认编号>"
+ * - 续传：断开后发 "#DL <起始> <结束> <下一个要收的块编号>" 接着下载。
+ *   编号以 #DLBEGIN 和文件头帧里的为准（裸分区里要续传的块已被覆盖时从现存最旧的块开始）
+ * - 两帧交替：一帧由 DMA（或 USB）发送时读下一扇区，串口不停顿；下载期间只处理 #ACK / #NAK / #STOP，
+ *   其它命令等下载结束再执行
+ */
+
+#ifndef __QUERY_H
+#define __QUERY_H
+
+#include "stm32f1xx_hal.h"
+
+#define QUERY_FRAME_MAGIC   0xA5U
+#define QUERY_BLOCK_MAGIC   0xA6U
+
+/* 回传走的端口 */
+#define QUERY_PORT_UART     0U
+#define QUERY_PORT_USB      1U
+
+/* 批量下载已发出未确认的最多帧数。115200 波特率一帧约 45ms，8 帧能容忍约 300ms 的应答延迟 */
+#ifndef QUERY_WINDOW
+#define QUERY_WINDOW        8U
+#endif
+
+#ifndef QUERY_ACK_TIMEOUT_MS
+#define QUERY_ACK_TIMEOUT_MS    1000UL
+#endif
+
+#ifndef QUERY_RETRY_MAX
+#define QUERY_RETRY_MAX     5U
+#endif
+
+/* 经 port 开始回传，返回 0 成功，-1 正在回传或 SD 卡不可用 */
+int Query_Start(uint8_t port, uint32_t from, uint32_t to);
+
+/*
+ * 经 port 开始批量下载，resume 为 1 时从编号为 index 的块续传，否则从起始时间所在块开始。
+ * 返回 0 成功，-1 正在回传或 SD 卡不可用
+ */
+int Query_StartBlocks(uint8_t port, uint32_t from, uint32_t to, uint8_t resume, uint32_t index);
+
+/* 批量下载的应答：编号 n 之前的帧都收到了 / 从 n 重发 / 中止。不在下载时忽略 */
+void Query_Ack(uint32_t n);
+void Query_Nak(uint32_t n);
+void Query_Stop(void);
+
+/* 主循环空闲时反复调用：启动下一帧发送，并在发送期间读取下一扇区 */
+void Query_Poll(void);
+
+uint8_t Query_IsActive(void);
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * SD 卡读写测速模块
+ * - 串口命令 "#BENCH" 触发，直接经 disk_read/disk_write（即 user_diskio.c 的
+ *   USER_read/USER_write）读写卡，不经过 FatFs 文件层
+ * - 测试项：顺序写/读（单块、多块）、随机单块读/写，读出的数据逐扇区校验
+ * - 每次调用用 DWT 周期计数器计时，输出吞吐量、平均/最大延迟和按 2 的幂分档的延迟直方图：
+ *     "#BENCH BEGIN <起始扇区> <扇区数>\r\n"
+ *     "#BENCH <测试项> ops=<次数> kbps=<KB/s> avg=<us> max=<us> err=<错误数>\r\n"
+ *     "#HIST <测试项> <64us以下>,<128us以下>,...,<512ms以下>,<512ms及以上>\r\n"
+ *     "#BENCH END\r\n"
+ * - 读写区域是 LOG/BENCH.TMP 临时文件自己的簇（见 SD_Card_ScratchOpen），测完删除
+ * - 分步执行：SD_Bench_Start 建好测速区后立即返回，主循环里 SD_Bench_Poll 每次只做几毫秒，
+ *   采样和写日志不停；全部做完大约需要数秒到数十秒（取决于卡）
+ */
+
+#ifndef __SDBENCH_H
+#define __SDBENCH_H
+
+#include "stm32f1xx_hal.h"
+
+/* 测速区域大小（扇区），默认 1MB */
+#ifndef SD_BENCH_AREA_SECTORS
+#define SD_BENCH_AREA_SECTORS   2048U
+#endif
+
+/* 多块读写每次的扇区数，受 RAM 限制（缓冲区 = SD_BENCH_MULTI * 512 字节） */
+#ifndef SD_BENCH_MULTI
+#define SD_BENCH_MULTI          4U
+#endif
+
+/* 随机读写的次数 */
+#ifndef SD_BENCH_RANDOM_OPS
+#define SD_BENCH_RANDOM_OPS     128U
+#endif
+
+/* SD_Bench_Poll 每次调用最多占用的时间（毫秒），超过后留到下次 */
+#ifndef SD_BENCH_STEP_MS
+#define SD_BENCH_STEP_MS        5U
+#endif
+
+#define SD_BENCH_HIST_BINS      15U
+
+/* 建立测速区并开始测试，返回 0 已开始，其它为 SD 卡错误或已在测试（已打印 #ERR BENCH） */
+int SD_Bench_Start(void);
+
+/* 主循环里反复调用：执行一小段测试，结果逐项打印到串口 */
+void SD_Bench_Poll(void);
+
+/* 正在测试 */
+uint8_t SD_Bench_Active(void);
+
+#endif
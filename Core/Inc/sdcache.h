@@ -0,0 +1,53 @@
+/*
+ * SD 卡元数据扇区写回缓存（位于 FatFs 和扇区驱动之间）
+ * - 只缓存 FAT 和目录扇区：FatFs（_FS_TINY = 0）只经卷窗口 fs->win 读写这两类扇区，
+ *   文件数据走 FIL 缓冲或直接用调用者的缓冲区，所以按缓冲区地址就能区分
+ * - 写入只改缓存，到下一个同步点（CTRL_SYNC 或 SD_Cache_Flush）才写卡，
+ *   期间同一扇区改多少次都只写一次；按扇区号从小到大写出，FAT 总在目录之前落盘
+ * - 槽位用满时淘汰最久没用的一个，脏的先写卡
+ * - 数据读写和缓存中的扇区重叠时以缓存为准，不会读到旧内容
+ */
+
+#ifndef __SDCACHE_H
+#define __SDCACHE_H
+
+#include "ff.h"
+#include "diskio.h"
+
+/* 缓存槽数，每槽 512 字节。3 个槽够放一次轮转改到的目录、FAT 和 FSINFO 扇区 */
+#ifndef SD_CACHE_SLOTS
+#define SD_CACHE_SLOTS  3U
+#endif
+
+/* 底层扇区读写函数（驱动实现，不经过缓存） */
+typedef DRESULT (*SD_CacheRead_t)(BYTE *buff, DWORD sector, UINT count);
+typedef DRESULT (*SD_CacheWrite_t)(const BYTE *buff, DWORD sector, UINT count);
+
+typedef struct
+{
+    uint32_t hits;          /* 读命中 */
+    uint32_t misses;        /* 读未命中 */
+    uint32_t absorbed;      /* 只改了缓存、没有立即写卡的元数据写入 */
+    uint32_t written;       /* 实际写卡的元数据扇区 */
+} SD_CacheStats_t;
+
+/* 卡初始化成功后调用：登记底层读写函数并清空缓存（不写回旧内容） */
+void SD_Cache_Init(SD_CacheRead_t read, SD_CacheWrite_t write);
+
+/* 驱动的 read/write 入口改调这两个函数，参数与 disk_read/disk_write 相同 */
+DRESULT SD_Cache_Read(BYTE *buff, DWORD sector, UINT count);
+DRESULT SD_Cache_Write(const BYTE *buff, DWORD sector, UINT count);
+
+/* 驱动处理 CTRL_SYNC 时调用：没有 SD_Cache_Hold 时写出全部脏扇区 */
+DRESULT SD_Cache_Sync(void);
+
+/* 连续几次 f_sync 期间暂不写回，最后由 SD_Cache_Flush 一次写出，
+ * 同一目录扇区被几次 f_sync 改写时只写卡一次 */
+void SD_Cache_Hold(void);
+
+/* 取消 SD_Cache_Hold 并写出全部脏扇区 */
+DRESULT SD_Cache_Flush(void);
+
+void SD_Cache_GetStats(SD_CacheStats_t *stats);
+
+#endif
@@ -1,7 +1,8 @@
 /*
  * SD 卡日志模块（基于 FatFs）
- * - 负责把每次采集到的 pH / TDS / 温度 / 浊度 追加写入 data.csv
+ * - 负责把每次采集到的 pH / TDS / 温度 / 浊度 追加写入 LOG/YYMMDDNN.BIN（格式见 logrec.h）
  * - 底层存储介质由 FATFS/App/fatfs.c + FATFS/Target/user_diskio.c 提供
+ * - SD_LOG_RAW 为 1 时改写卡上的裸分区（sdraw.h），接口不变
  */
 
 #ifndef PH_SDCARD_H
@@ -10,7 +11,119 @@
 #include "stm32f1xx_hal.h"
 
 /*
- * 初始化 SD 卡与文件系统，并打开/创建日志文件 data.csv。
+ * 存储方式：
+ *   0 - LOG 目录下按日期轮转的 FAT 文件，PC 直接读卡（默认）
+ *   1 - MBR 里类型 0xDA 的裸分区，不经 FatFs 的只追加环形日志（sdraw.h）：
+ *       不改写 FAT 和目录项，多块连续写，写满后覆盖最旧的数据，适合无人值守长期记录；
+ *       PC 端用 log_decoder.py --raw 导出。此模式下轮转、预分配和 .IDX 索引都不用
+ */
+#ifndef SD_LOG_RAW
+#define SD_LOG_RAW              0
+#endif
+
+/*
+ * 片内 Flash 后备日志（flashlog.h）：
+ *   SD_FLASH_FALLBACK - 为 1 时卡不在或写卡出错期间记录存进片内 Flash 末尾的环形区，
+ *                       卡恢复后自动转存到卡上，早于之后的新记录写入；为 0 时这期间的记录丢弃。
+ *                       要占掉 FLASH_LOG_PAGES 页程序空间，默认关，用 CMake 选项
+ *                       -DSD_FLASH_FALLBACK=ON 打开（同时改链接脚本的 FLASHLOG 区）
+ *   SD_RETRY_MS       - 离线时每隔多久重新初始化一次卡
+ */
+#ifndef SD_FLASH_FALLBACK
+#define SD_FLASH_FALLBACK       0
+#endif
+
+#ifndef SD_RETRY_MS
+#define SD_RETRY_MS             60000UL
+#endif
+
+/*
+ * 复位保护（sdjournal.h）：为 1 时还没写上卡的记录同时记在 .noinit RAM 里，
+ * 看门狗、复位键等热复位后由 SD_Card_Init 补写，不丢；只占 516 字节 RAM。
+ * 裸分区模式下攒着的块（SD_RAW_BATCH）也算没写上卡，日志放满时连同没写满的块提前写出，
+ * 攒批基本不起作用，更看重批量写卡时设为 0
+ */
+#ifndef SD_JOURNAL
+#define SD_JOURNAL              1
+#endif
+
+/*
+ * 同步策略默认值（运行时可用 SD_Card_SetSyncPolicy 修改，0 表示关闭该条件）：
+ *   SD_SYNC_EVERY_SECTORS - 每写出多少个整扇区做一次 f_sync
+ *   SD_SYNC_INTERVAL_MS   - 距上次 f_sync 超过多少毫秒时在 SD_Card_Poll 里同步
+ * 掉电最多丢失一个同步周期内的数据；PVD 检测到供电跌落时会立即同步。
+ * 写上卡的块不同步也能在上电时找回，SD_JOURNAL 为 1 时热复位不丢数据，同步间隔可以放长，
+ * 只影响 PC 直接读卡时能看到的文件大小和掉电风险。
+ */
+#ifndef SD_SYNC_EVERY_SECTORS
+#define SD_SYNC_EVERY_SECTORS   8U
+#endif
+
+#ifndef SD_SYNC_INTERVAL_MS
+#define SD_SYNC_INTERVAL_MS     300000UL
+#endif
+
+/*
+ * 预分配：文件每次扩展的字节数（会向上取整到擦除块大小），
+ * 默认 1MB，按 5 秒一条约可记录 3.8 天。
+ * SD_CLMT_ITEMS 为簇链映射表的项数，文件碎片超过 (SD_CLMT_ITEMS-2)/2 段时退回普通查找。
+ */
+#ifndef SD_PREALLOC_BYTES
+#define SD_PREALLOC_BYTES       (1024UL * 1024UL)
+#endif
+
+#ifndef SD_CLMT_ITEMS
+#define SD_CLMT_ITEMS           32U
+#endif
+
+/*
+ * 预分配的空间里可能是卡上以前的旧日志，CRC 正确、序号碰巧接上时上电找回末尾会把它当成新数据。
+ * 写块前先把它后面 SD_CLEAN_AHEAD 个扇区清零（每攒够一批清一次），数据末尾之后总是清过的扇区
+ */
+#ifndef SD_CLEAN_AHEAD
+#define SD_CLEAN_AHEAD          8U
+#endif
+
+/*
+ * 轮转：单个文件的最大字节数，超过后换下一个分段（日期变化也会换）。
+ * .IDX 索引每个压缩块（扇区）一项。
+ */
+#ifndef SD_ROTATE_BYTES
+#define SD_ROTATE_BYTES         (4UL * 1024UL * 1024UL)
+#endif
+
+/*
+ * 采集端与写入端之间的记录队列长度（条，必须是 2 的幂），默认 64 条 = 两个扇区。
+ * SD_Card_Log 只负责入队，写卡在 SD_Card_Poll 里进行，卡忙时只推迟写入，不影响采样；
+ * 队列满时新记录被丢弃并计数（见 SD_Card_GetQueueStats）。
+ */
+#ifndef SD_QUEUE_RECORDS
+#define SD_QUEUE_RECORDS        64U
+#endif
+
+/*
+ * SD_Card_Format 格式化时的簇大小（字节）。大簇让 FAT 表更小、预分配和快速查找表的碎片更少，
+ * 长期高速记录时分配簇的次数也少；FatFs R0.11 最大 64KB。
+ * 卡太小（约 4.5GB 以下）、大簇凑不够 FAT32 的簇数时改由 FatFs 按容量自动选择。
+ */
+#ifndef SD_FORMAT_CLUSTER
+#define SD_FORMAT_CLUSTER       (64UL * 1024UL)
+#endif
+
+#define SD_LOG_DIR              "LOG"
+#define SD_LOG_PATH_LEN         20U     /* "LOG/YYMMDDNN.BIN" + '\0' */
+
+/* 记录周期，写入文件头供上位机参考（与 main.c 中的调用频率保持一致） */
+#ifndef SD_LOG_PERIOD_MS
+#define SD_LOG_PERIOD_MS        5000UL
+#endif
+
+/*
+ * 初始化 SD 卡与文件系统，并打开/创建当天的日志文件。
+ * 失败时（SD_FLASH_FALLBACK）之后的记录先存进片内 Flash，SD_Card_Poll 定时重试。
+ * 第一次调用时补写热复位前还没写上卡的记录（SD_JOURNAL）。
+ * 当天已有文件的格式版本不符时不往里追加，改写下一个分段。
+ * 裸分区模式下卡上可以没有 FAT 分区，改为找到裸分区并恢复写入位置。
  * 返回值：
  *   0     - 成功
  *   其它  - FatFs 错误码（FRESULT）或负数表示本模块内部错误
@@ -18,13 +131,123 @@
 int SD_Card_Init(void);
 
 /*
- * 记录一条数据：pH / TDS / 温度 / 浊度。
+ * 记录一条数据：pH / TDS / 温度 / 浊度，时间戳取 SD_Card_GetTime()。
+ * 卡离线时照样入队，由 SD_Card_Poll 存进片内 Flash。
+ * 超出定点范围的数值会被截断，并在记录的质量标志中注明。
+ * 只把记录放进队列，不访问 SD 卡，实际写入由 SD_Card_Poll 完成。
  * 返回值：
  *   0     - 成功
- *   其它  - 错误
+ *   -1    - 日志文件未打开（且没有 Flash 后备）
+ *   -2    - 队列已满，本条丢弃
  */
 int SD_Card_Log(float ph, float tds, float temp, float turb);
 
+/*
+ * 立即把队列和暂存区全部写出并 f_sync，保证已记录的数据全部落盘。
+ * Flash 里有积压时先全部转存；卡离线时改为全部写进 Flash。
+ */
+int SD_Card_Sync(void);
+
+/*
+ * 主循环空闲时反复调用：从队列取记录写卡（每次最多写一个扇区），
+ * 检查同步策略和供电跌落标志，必要时执行同步。
+ */
+void SD_Card_Poll(void);
+
+/*
+ * 修改同步策略，参数含义同 SD_SYNC_EVERY_SECTORS / SD_SYNC_INTERVAL_MS。
+ */
+void SD_Card_SetSyncPolicy(uint16_t every_sectors, uint32_t interval_ms);
+void SD_Card_GetSyncPolicy(uint16_t *every_sectors, uint32_t *interval_ms);
+
+/*
+ * 软件时钟（Unix 秒）。未调用 SD_Card_SetTime 前为上电后的秒数，
+ * 此时写入的记录带 LOG_FLAG_TIME_UNSET 标志。
+ */
+void SD_Card_SetTime(uint32_t unix_time);
+uint32_t SD_Card_GetTime(void);
+
+/* 已用 SD_Card_SetTime 校准过时钟 */
+uint8_t SD_Card_TimeSet(void);
+
+/* 卡已挂载、日志已打开（不在离线状态），可以查询 */
+uint8_t SD_Card_IsOnline(void);
+
+/*
+ * 软件时钟转 FatFs 时间格式，供 fatfs.c 的 get_fattime 使用。
+ */
+uint32_t SD_Card_FatTime(void);
+
+/* 历史记录读取游标 */
+typedef struct
+{
+    uint32_t day;       /* 文件日期（自 1970-01-01 起的天数） */
+    uint8_t  part;      /* 分段号 */
+    uint32_t offset;    /* 下一条记录所在块在文件中的偏移（裸分区为块序号） */
+    uint16_t skip;      /* 该块里已经读过的记录条数 */
+    uint32_t end;       /* 该文件有效数据末尾，0 表示未知 */
+} SD_LogCursor_t;
+
+/*
+ * 按时间定位记录：游标指向第一条时间戳 >= t 的记录。
+ * 只读当前版本（LOG_VERSION）的文件，升级前的旧格式文件在设备端当作空文件跳过。
+ * 返回 0 成功，-1 没有不早于 t 的日志文件。
+ * 只能查到已写出的数据，需要包含最新记录时先调用 SD_Card_Sync。
+ */
+int SD_Card_Locate(uint32_t t, SD_LogCursor_t *cur);
+
+/*
+ * 从游标处顺序读取最多 len 字节的整条记录（解压后的 LogRecord_t），文件读完自动跳到下一个文件。
+ * 返回读到的字节数，0 表示已到全部日志末尾，负数为错误。
+ */
+int SD_Card_ReadNext(SD_LogCursor_t *cur, void *buf, uint32_t len);
+
+/*
+ * 批量下载（query.h 的 #DL）按块读取，不解压：
+ *   块编号 - 文件模式为从 base 所在块起的块数（base 本身为 0），跨文件连续编号；
+ *            裸分区为块序号，base 不用。同一范围断开重连后编号不变，可以续传
+ *   SD_Card_GetHeader    - 拼一个当前格式的文件头（512 字节，data_end 为 0），
+ *                          和读出的块依次存起来就是版本 2 的 .BIN，log_decoder.py 可直接解码
+ *   SD_Card_SeekBlock    - 游标定位到编号为 index 的块，不读块内容。返回实际定位到的编号：
+ *                          超出日志末尾时为末尾，裸分区里已被覆盖时为现存最旧的块
+ *   SD_Card_ReadRawBlock - 读游标处的块原样拷进 blk（512 字节）并前进一块。返回 1 读到，
+ *                          2 这个编号的块已不存在（裸分区里被覆盖或读不出），0 已到全部日志末尾，负数为错误
+ * 块是卡上的样子，最后一块可能还在往里加记录，需要包含最新记录时先调用 SD_Card_Sync。
+ */
+void SD_Card_GetHeader(void *hdr);
+uint32_t SD_Card_SeekBlock(const SD_LogCursor_t *base, uint32_t index, SD_LogCursor_t *cur);
+int SD_Card_ReadRawBlock(SD_LogCursor_t *cur, void *blk);
+
+/*
+ * 队列统计：当前排队条数、历史最大排队条数、因队列满丢弃的条数。
+ */
+void SD_Card_GetQueueStats(uint16_t *pending, uint16_t *peak, uint32_t *dropped);
+
+/*
+ * 获取卡的真实几何参数（SD_Card_Init 成功后有效）：
+ *   sectors     - 总扇区数（512 字节），未知时为 0
+ *   erase_block - 擦除块（AU）大小，单位扇区
+ */
+void SD_Card_GetGeometry(uint32_t *sectors, uint32_t *erase_block);
+
+/*
+ * 测速用的裸扇区区域（见 sdbench.c）：建临时文件 LOG/BENCH.TMP 并扩展到 sectors 个扇区，
+ * 返回其第一段连续区域的物理起始扇区 first 和扇区数 count（可能小于 sectors）。
+ * 调用前会先同步日志；用完必须调用 SD_Card_ScratchClose 删除临时文件。
+ * 返回 0 成功，其它为错误。
+ */
+int SD_Card_ScratchOpen(uint32_t sectors, uint32_t *first, uint32_t *count);
+void SD_Card_ScratchClose(void);
+
+/*
+ * 把整张卡格式化为 FAT32（簇大小见 SD_FORMAT_CLUSTER，数据区按擦除块对齐），再重新 SD_Card_Init。
+ * 卡上原有数据全部丢失。本工程的 FatFs R0.11 不支持 exFAT，出厂为 exFAT 的 SDXC 卡（64GB 以上）
+ * 需要先这样格式化，或在 PC 上格式化为 FAT32（例如 mkfs.vfat -F 32 -s 128）。
+ * 扇区号是 32 位，容量最大 2TB。裸分区模式下不可用，返回 -1。
+ * 返回值同 SD_Card_Init，f_mkfs 失败时为其 FRESULT。
+ */
+int SD_Card_Format(void);
+
 /*
  * 关闭日志文件并卸载文件系统，可在系统关闭前调用（可选）。
  */
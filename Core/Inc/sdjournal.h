@@ -0,0 +1,40 @@
+/*
+ * SD 日志的复位保护日志（SD_JOURNAL 为 1 时 sdcard.c 使用）
+ * - 还没写上卡的记录（队列里的和暂存块里没写出的）另外编码进一个放在 .noinit 段的压缩块。
+ *   启动代码只清零 .bss，不碰 .noinit，看门狗、复位键、软件复位之后内容还在
+ * - 格式为魔数 + 一个 logblock.h 的压缩块（带记录条数和 CRC），每加一条都重新算 CRC；
+ *   上电复位时 SRAM 内容随机，魔数和 CRC 对不上就当作没有
+ * - 暂存块写上卡（或记录转进片内 Flash）之后 sdcard.c 调用 SD_Journal_Clear 清空，
+ *   再把队列里还没取出的记录重新加进来，所以这里总是"卡上还没有的记录"
+ * - 一块通常能放 100~500 条；放满后 SD_Journal_Add 返回 -1，sdcard.c 把没写满的块
+ *   原地写一次卡（不用 f_sync，上电时 FindEnd 能找回），清空后接着记
+ */
+
+#ifndef __SDJOURNAL_H
+#define __SDJOURNAL_H
+
+#include "logrec.h"
+
+/*
+ * 上电时调用一次：检查 .noinit 里复位前留下的记录，返回条数（冷启动或内容无效时为 0 并清空），
+ * 之后用 SD_Journal_Next 依次取出。可以再调用一次从头重新取。
+ */
+uint16_t SD_Journal_Open(void);
+
+/*
+ * 取出下一条复位前留下的记录，返回 1 成功，0 已取完。
+ * 取的过程中 SD_Journal_Add / SD_Journal_Clear 不起作用（重放时写卡会调用它们）；
+ * 取完后这些记录仍留在日志里，新记录接在后面，写上卡后由调用者清空。
+ */
+int SD_Journal_Next(LogRecord_t *rec);
+
+/* 记入一条还没写上卡的记录，返回 0 成功，-1 放满了（本条及之后的都没记进去，直到清空） */
+int SD_Journal_Add(const LogRecord_t *rec);
+
+/* 日志里的记录都已写上卡：清空 */
+void SD_Journal_Clear(void);
+
+/* 是否放满了 */
+uint8_t SD_Journal_Full(void);
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * SD 卡裸分区日志存储（SD_LOG_RAW 为 1 时 sdcard.c 用它代替 FatFs 文件，格式见 logrec.h）
+ * - 日志写在 MBR 里类型为 LOG_RAW_PART_TYPE（0xDA）的分区，可在 Linux 下用 fdisk 建立，
+ *   卡上其它分区（例如给 PC 用的 FAT 分区）不受影响
+ * - 只追加的环形日志：块按序号依次写到下一个扇区，写到分区末尾后回到开头覆盖最旧的块。
+ *   没有 FAT、目录项和文件头要改写，每个扇区只在轮到它时写一次，磨损均匀
+ * - 写满的块先攒在 RAM 里，攒够 SD_RAW_BATCH 块用一次多块写命令（CMD25）顺序写出
+ * - 上电恢复写入位置：从分区开头起，"块序号 == 第一块序号 + 位置" 的扇区属于最新一圈，
+ *   这个条件在写入位置之前成立、之后不成立，二分查找只需读 log2(块数) 个扇区
+ * - 分区头无效（新建的分区）时写入新分区头，格式化代号 gen 和旧数据不同，旧块全部作废
+ * - PC 端用 log_decoder.py --raw 把分区导出成 CSV 或 .BIN 文件
+ */
+
+#ifndef __SDRAW_H
+#define __SDRAW_H
+
+#include "logrec.h"
+
+/* 攒多少个写满的块一起写卡，每块占 512 字节 RAM。掉电时这些块和正在编码的块会丢失 */
+#ifndef SD_RAW_BATCH
+#define SD_RAW_BATCH    4U
+#endif
+
+/*
+ * 找到裸分区并恢复写入位置。hdr 为分区头无效时写入的新分区头（gen 由本函数生成），
+ * last 为 512 字节缓冲。返回值：
+ *   0     - 成功，分区里还没有块
+ *   1     - 成功，最后一块已读进 last，可以 LogBlock_Resume 接着往里加记录
+ *   -1    - 卡上没有裸分区或分区太小
+ *   -2    - 读写卡错误
+ */
+int SD_Raw_Open(const LogHeader_t *hdr, uint8_t *last);
+
+/* 正在编码的块的序号，以及卡上还没被覆盖的最旧块的序号 */
+uint32_t SD_Raw_Head(void);
+uint32_t SD_Raw_First(void);
+
+/* 在 LogBlock_Finish 之前调用：把块序号和 gen 写进块尾 */
+void SD_Raw_Stamp(uint8_t *blk);
+
+/*
+ * 写出当前块（已 SD_Raw_Stamp 和 LogBlock_Finish）。
+ * full 为 1 时块已写满，放进批量缓冲，攒够 SD_RAW_BATCH 块才写卡，之后序号加一；
+ * 否则（同步时块还没满）连同攒着的块立即写卡，序号不变，块写满后原地重写。
+ * 返回 0 成功，其它为 DRESULT 错误（攒着的块丢弃）
+ */
+int SD_Raw_Write(const uint8_t *blk, uint8_t full);
+
+/* 把攒着的块写卡 */
+int SD_Raw_Sync(void);
+
+/* 攒着还没写卡的块数 */
+uint8_t SD_Raw_Batched(void);
+
+/* 读序号为 seq 的块（攒着还没写卡的也能读到），返回 0 成功，-1 块不存在或已被覆盖，其它为 DRESULT 错误 */
+int SD_Raw_Read(uint32_t seq, uint8_t *buf);
+
+/* 写出攒着的块并等卡编程结束 */
+void SD_Raw_Close(void);
+
+#endif
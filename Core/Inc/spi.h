@@ -36,12 +36,16 @@ extern SPI_HandleTypeDef hspi1;
 
 /* USER CODE BEGIN Private defines */
 
+/* SD 卡两档时钟：初始化阶段 72MHz/256 ≈ 281kHz，数据传输阶段 72MHz/4 = 18MHz */
+#define SPI1_PRESCALER_SD_INIT   SPI_BAUDRATEPRESCALER_256
+#define SPI1_PRESCALER_SD_FAST   SPI_BAUDRATEPRESCALER_4
+
 /* USER CODE END Private defines */
 
 void MX_SPI1_Init(void);
 
 /* USER CODE BEGIN Prototypes */
-
+void MX_SPI1_SetBaudRatePrescaler(uint32_t prescaler);
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
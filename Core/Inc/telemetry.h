@@ -0,0 +1,57 @@
+/*
+ * 实时遥测（每秒一帧，经 USART1 和 USB 虚拟串口发给上位机）
+ * - 默认为二进制帧：定点数 + CRC16，COBS 编码，前后各一个 0x00：
+ *     0x00, COBS(帧内容 + CRC16), 0x00
+ *   帧内容（小端）：
+ *     'T' 采样：  类型, 版本, 序号（u16）, 时间（u32，SD_Card_GetTime）, 标志（LOG_FLAG_xxx）,
+ *                 通道数 n, n 个定点值（i16 / u16，物理值 = 原始值 / scale）
+ *     'S' 通道表：类型, 版本, 通道数 n, n 个 {名称[8], 单位[4], 类型（LOG_TYPE_xxx）, scale（u16）}
+ *   CRC16 覆盖帧内容（crc16.h）。COBS 编码后帧内没有 0x00，文字行（命令回复、调试输出）里也没有，
+ *   两者可以混在同一个口上：上位机读到 0x00 就按帧读到下一个 0x00，否则按文字读到行尾
+ * - 版本握手：上电、切回二进制格式和收到 "#SCHEMA" 时发一次通道表帧。上位机按通道表解码采样帧
+ *   （表驱动，见 telemetry.py），遇到没见过的版本号就发 "#SCHEMA"。
+ *   通道表（logchan.c 的 g_logChannels）有改动时提升 TELEM_VERSION
+ * - 定点换算和超范围标志与 SD 卡日志记录共用 LogChan_Fixed（logchan.h），采样帧里的值可以直接和历史记录比对
+ * - 文字格式只用于串口助手调试，"#TLM TEXT" 切换，每秒一行 "PH=7.02;TEMP=25.30;TDS=250;TURB=12.3"，
+ *   "#TLM BIN" 切回
+ */
+
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include "stm32f1xx_hal.h"
+#include "logchan.h"
+
+#define TELEM_VERSION       1U
+
+#define TELEM_TYPE_SAMPLE   'T'
+#define TELEM_TYPE_SCHEMA   'S'
+
+#define TELEM_MODE_BIN      0U
+#define TELEM_MODE_TEXT     1U
+
+#ifndef TELEM_MODE_DEFAULT
+#define TELEM_MODE_DEFAULT  TELEM_MODE_BIN
+#endif
+
+/* 通道在 Telemetry_Send 参数里的位置，即 logchan.h 的通道序号 */
+#define TELEM_CH_PH         LOG_CH_PH
+#define TELEM_CH_TEMP       LOG_CH_TEMP
+#define TELEM_CH_TDS        LOG_CH_TDS
+#define TELEM_CH_TURB       LOG_CH_TURB
+#define TELEM_CHANNELS      LOG_CHANNELS
+
+/* 上电时调用一次：发一次通道表 */
+void Telemetry_Init(void);
+
+/* 发一帧采样，val 按 TELEM_CH_xxx 排列 */
+void Telemetry_Send(const float *val);
+
+/* 发通道表帧（"#SCHEMA" 命令） */
+void Telemetry_SendSchema(void);
+
+/* 切换输出格式 TELEM_MODE_xxx，切回二进制时先发一次通道表 */
+void Telemetry_SetMode(uint8_t mode);
+uint8_t Telemetry_GetMode(void);
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * USART1 波特率协商
+ * - 上电固定 115200（MX_USART1_UART_Init）。上位机连上后可以请求更高的波特率，
+ *   72MHz 下 USART1 最高 4.5Mbaud，批量下载（#DL）和回传（#Q）快 10~20 倍：
+ *     上位机  #BAUD <波特率>
+ *     设备    #OK BAUD <波特率>     （旧波特率，发完后切换；不支持的波特率回 #ERR BAUD）
+ *     上位机  切换，发 #BAUD OK
+ *     设备    #OK BAUD OK           （新波特率，确认切换）
+ * - 自动退回 115200（UART_BAUD_DEFAULT）：
+ *     切换后 UART_BAUD_CONFIRM_MS 内没收到 #BAUD OK；
+ *     连续 UART_BAUD_ERR_MAX 次接收错误（帧错误、噪声、溢出）没收到一行完整的命令；
+ *     UART_BAUD_IDLE_MS 内没收到任何命令，上位机每隔几秒发一次 #BAUD OK 保持
+ *   上位机收帧 CRC 连续出错或收不到数据时同样自己退回 115200，之后发的命令在设备端是接收错误，
+ *   设备随即也退回
+ * - 只改 BRR，不重新初始化 USART，DMA 接收不中断；USB 虚拟串口不受影响（#BAUD 只对 USART1 有效）
+ */
+
+#ifndef __UARTBAUD_H
+#define __UARTBAUD_H
+
+#include "stm32f1xx_hal.h"
+
+#define UART_BAUD_DEFAULT       115200UL    /* 与 MX_USART1_UART_Init 一致 */
+
+/* 允许的最高波特率。接收走 DMA（cmd.c），不受中断响应限制，默认取 72MHz 下的上限 4.5Mbaud */
+#ifndef UART_BAUD_MAX
+#define UART_BAUD_MAX           4500000UL
+#endif
+
+/* 实际波特率（PCLK2 / BRR）与请求值的最大误差，千分之几 */
+#ifndef UART_BAUD_TOLERANCE
+#define UART_BAUD_TOLERANCE     20U
+#endif
+
+#ifndef UART_BAUD_CONFIRM_MS
+#define UART_BAUD_CONFIRM_MS    1000UL
+#endif
+
+#ifndef UART_BAUD_IDLE_MS
+#define UART_BAUD_IDLE_MS       10000UL
+#endif
+
+#ifndef UART_BAUD_ERR_MAX
+#define UART_BAUD_ERR_MAX       8U
+#endif
+
+/*
+ * 请求切换到 rate，返回 0 接受（等发送缓冲里的数据按旧波特率发完后在 UartBaud_Poll 里切换），
+ * -1 不支持（超出范围或误差太大）
+ */
+int UartBaud_Request(uint32_t rate);
+
+/* 收到 #BAUD OK：返回 1 表示确认了一次切换，0 表示没有待确认的切换（只当作保持） */
+uint8_t UartBaud_Confirm(void);
+
+/* USART1 收到一行完整的命令（Cmd_Poll 里调用） */
+void UartBaud_Alive(void);
+
+/* USART1 接收错误（HAL_UART_ErrorCallback 里调用） */
+void UartBaud_RxError(void);
+
+/* 主循环里反复调用：执行切换，检查超时和错误 */
+void UartBaud_Poll(void);
+
+/* 当前波特率 */
+uint32_t UartBaud_Get(void);
+
+#endif
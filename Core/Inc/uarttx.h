@@ -0,0 +1,49 @@
+/*
+ * USART1 发送环形缓冲
+ * - printf（syscalls.c 的 _write）把整段文字拷进环形缓冲就返回，由 DMA 在后台发出，
+ *   发完一段在发送完成中断里接着发下一段。一行遥测约 40 字节，拷贝只要几微秒，
+ *   不再像逐字节 HAL_UART_Transmit 那样每个字符等 87us
+ * - 缓冲满时按 UART_TX_OVERFLOW 处理：UART_TX_DROP 丢弃放不下的部分，
+ *   UART_TX_BLOCK 等 DMA 腾出空间（中断里或关中断时仍然丢弃，等不到）
+ * - 只能在主循环里写入（单写入方，不用加锁）；中断里的输出直接丢弃
+ * - 历史记录回传的帧用 UartTx_Send 直接从帧缓冲发出，不拷贝；发完调用
+ *   UartTx_TxCpltCallback。环形缓冲里还有文字时先发文字，保证先后顺序（同 usbcdc.h）
+ * - HAL_UART_TxCpltCallback 在这里实现；HAL_UART_ErrorCallback 在 cmd.c，发送出错时调用 UartTx_Error
+ */
+
+#ifndef __UARTTX_H
+#define __UARTTX_H
+
+#include "stm32f1xx_hal.h"
+
+#define UART_TX_DROP            0U
+#define UART_TX_BLOCK           1U
+
+/* 环形缓冲大小，必须是 2 的幂。115200 波特率下 512 字节约 45ms 发完 */
+#ifndef UART_TX_RING
+#define UART_TX_RING            512U
+#endif
+
+#ifndef UART_TX_OVERFLOW
+#define UART_TX_OVERFLOW        UART_TX_BLOCK
+#endif
+
+/* 写入环形缓冲并启动发送，不等发完 */
+void UartTx_Write(const uint8_t *buf, uint16_t len);
+
+/*
+ * 不拷贝地发送 buf（发完之前不能改动），返回 0 已开始发送，
+ * -1 上一次发送还没完成或环形缓冲里还有数据
+ */
+int UartTx_Send(const uint8_t *buf, uint16_t len);
+
+/* 正在发送（或环形缓冲里还有数据） */
+uint8_t UartTx_Busy(void);
+
+/* UartTx_Send 的数据发完后在中断里调用，弱定义，由使用者实现 */
+void UartTx_TxCpltCallback(void);
+
+/* HAL_UART_ErrorCallback 里调用：发送 DMA 出错中止时丢弃正在发的一段，接着发后面的 */
+void UartTx_Error(void);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * USB 虚拟串口（CDC-ACM），和 USART1 并行使用
+ * - 直接用 HAL 的 PCD 驱动（usb.c，MX_USB_PCD_Init）实现设备枚举和 CDC 类请求，
+ *   不依赖 ST 的 USB Device 中间件；Linux 下识别为 /dev/ttyACM0，Windows 10 以上免驱
+ * - 端点：EP0 控制；0x81 / 0x01 批量输入 / 输出（64 字节）；0x82 中断输入（通知，不使用）
+ * - 全速 USB 一帧（1ms）最多 19 个 64 字节的批量包，单缓冲实际约 0.8~1MB/s，
+ *   比 115200 波特率的串口快 70~90 倍；波特率等线路设置只记录、回读，不影响传输速度
+ * - 上位机打开端口（DTR 置位）后才发送；关闭端口、拔线或总线复位时丢弃没发出的数据
+ * - 两种发送方式共用 0x81 端点：
+ *     USB_CDC_Write  拷贝进发送环形缓冲，立即返回（printf 用）
+ *     USB_CDC_Send   直接发调用者的缓冲，不拷贝，发完调用 USB_CDC_TxCpltCallback（回传帧用）。
+ *                    环形缓冲里还有数据时先发那些，保证文字行和二进制帧的先后顺序
+ * - 所有回调都在 USB 中断里执行（优先级同 USART1，两者不互相打断）
+ */
+
+#ifndef __USBCDC_H
+#define __USBCDC_H
+
+#include "stm32f1xx_hal.h"
+
+#define USB_CDC_VID             0x0483U     /* ST 的 VID 和虚拟串口 PID */
+#define USB_CDC_PID             0x5740U
+
+#define USB_CDC_PACKET_SIZE     64U
+
+/* 发送环形缓冲大小，必须是 2 的幂。printf 的遥测行一秒一行，256 字节足够 */
+#ifndef USB_CDC_TX_RING
+#define USB_CDC_TX_RING         256U
+#endif
+
+/* 环形缓冲满时 USB_CDC_Write 最多等多久，超时丢弃剩下的数据 */
+#ifndef USB_CDC_WRITE_TIMEOUT_MS
+#define USB_CDC_WRITE_TIMEOUT_MS    20UL
+#endif
+
+/* MX_USB_PCD_Init 之后调用一次：分配端点缓冲区并接上总线 */
+void USB_CDC_Init(void);
+
+/* 已枚举且上位机打开了端口 */
+uint8_t USB_CDC_IsOpen(void);
+
+/* 写入发送环形缓冲。端口没打开时直接丢弃；只能在主循环里调用，中断里的输出直接丢弃 */
+void USB_CDC_Write(const uint8_t *buf, uint16_t len);
+
+/*
+ * 不拷贝地发送 buf（发完之前不能改动），返回 0 已开始发送，
+ * -1 端口没打开、上一次发送还没完成或环形缓冲里还有数据
+ */
+int USB_CDC_Send(const uint8_t *buf, uint16_t len);
+
+/* 0x81 端点正在发送（或环形缓冲里还有数据） */
+uint8_t USB_CDC_TxBusy(void);
+
+/* USB_CDC_Send 的数据发完（或端口关闭被丢弃）后调用，弱定义，由使用者实现 */
+void USB_CDC_TxCpltCallback(void);
+
+/* 收到上位机发来的数据，弱定义，由使用者实现 */
+void USB_CDC_RxCallback(const uint8_t *data, uint16_t len);
+
+#endif
@@ -0,0 +1,455 @@
+/*
+ * 串口命令模块实现
+ * - USART1 用 DMA 循环接收进 s_rxDma，空闲线（一串数据收完后总线空闲一个字节时间）、
+ *   半满、全满时 HAL 调 HAL_UARTEx_RxEventCallback 报告 DMA 写到的位置；
+ *   中断里只记下位置，不逐字节进中断，高波特率下也不会溢出
+ * - USB 虚拟串口收到的数据在 USB_CDC_RxCallback 里拷进 s_usbRx 环形缓冲
+ * - 主循环 Cmd_Poll() 取出两边新收到的字节拼行（两个口各用一个行缓冲，互不干扰），
+ *   一行收完就查命令表 s_cmds 执行，命令处理全在主循环里，不占用中断
+ * - 接收缓冲只在主循环里读，两次 Cmd_Poll 之间收到的数据超过缓冲大小时最早的会被覆盖，
+ *   命令都很短，上位机一问一答，实际不会发生
+ */
+
+#include "cmd.h"
+
+#include "query.h"
+#include "ph.h"
+#include "sdbench.h"
+#include "sdcard.h"
+#include "telemetry.h"
+#include "uartbaud.h"
+#include "uarttx.h"
+#include "usart.h"
+#include "usbcdc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CMD_F_ARG       0x01U   /* 必须带参数 */
+#define CMD_F_QUERY     0x02U   /* 回传期间也马上执行（不回文字） */
+
+typedef struct
+{
+    const char *name;           /* 命令字，可以带固定的第一个参数，如 "#CAL PH" */
+    void (*handler)(char *arg, uint8_t port);
+    uint8_t flags;              /* CMD_F_xxx */
+} Cmd_Entry_t;
+
+static uint8_t  s_rxDma[CMD_RX_DMA];        /* USART1 接收 DMA 循环缓冲 */
+static volatile uint16_t s_rxDmaPos = 0;    /* DMA 已写到的位置（接收事件时更新） */
+static uint16_t s_rxReadPos = 0;
+static volatile uint8_t s_rxRestart = 0;    /* 接收出错，HAL 已停止 DMA，等主循环重新启动 */
+
+static uint8_t  s_usbRx[CMD_USB_RX];
+static volatile uint16_t s_usbHead = 0;     /* 自由计数，只在 USB 中断里前移 */
+static volatile uint16_t s_usbTail = 0;     /* 只在主循环里前移 */
+
+static char     s_rxBuf[2][CMD_LINE_MAX];   /* 按端口（QUERY_PORT_xxx）分开 */
+static uint8_t  s_rxLen[2];
+
+static char     s_deferred[CMD_LINE_MAX];   /* 回传期间推迟执行的命令，只留一条 */
+static uint8_t  s_deferredPort = QUERY_PORT_UART;
+static uint8_t  s_deferredReady = 0;
+
+static void Cmd_StartRx(void)
+{
+    s_rxDmaPos = 0;
+    s_rxReadPos = 0;
+    HAL_UARTEx_ReceiveToIdle_DMA(&huart1, s_rxDma, CMD_RX_DMA);
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    if (huart != &huart1)
+    {
+        return;
+    }
+
+    /* 循环模式下 Size 为 DMA 在缓冲里写到的位置，写满一圈时为 CMD_RX_DMA */
+    s_rxDmaPos = (uint16_t)(Size % CMD_RX_DMA);
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if (huart != &huart1)
+    {
+        return;
+    }
+
+    UartTx_Error();
+
+    /* 噪声/帧错误/溢出后 HAL 会停止 DMA 接收，由 Cmd_Poll 重新启动。
+     * 连续出错说明两边波特率对不上，由 UartBaud_Poll 退回 115200 */
+    if (huart->RxState == HAL_UART_STATE_READY)
+    {
+        UartBaud_RxError();
+        s_rxRestart = 1;
+    }
+}
+
+void USB_CDC_RxCallback(const uint8_t *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+    {
+        if ((uint16_t)(s_usbHead - s_usbTail) >= CMD_USB_RX)
+        {
+            return;     /* 主循环来不及取，丢弃 */
+        }
+        s_usbRx[s_usbHead % CMD_USB_RX] = data[i];
+        __DMB();
+        s_usbHead++;
+    }
+}
+
+/* 解析一个整数参数，*p 前移到参数之后；没有数字时返回 -1 */
+static int Cmd_ParseU32(char **p, uint32_t *v)
+{
+    char *end;
+    *v = strtoul(*p, &end, 10);
+    if (end == *p)
+    {
+        return -1;
+    }
+    *p = end;
+    return 0;
+}
+
+static int Cmd_ParseFloat(char **p, float *v)
+{
+    char *end;
+    *v = strtof(*p, &end);
+    if (end == *p)
+    {
+        return -1;
+    }
+    *p = end;
+    return 0;
+}
+
+static void Cmd_Time(char *arg, uint8_t port)
+{
+    uint32_t t = strtoul(arg, NULL, 10);
+    SD_Card_SetTime(t);
+    printf("#OK TIME %lu\r\n", (unsigned long)t);
+}
+
+static void Cmd_Query(char *arg, uint8_t port)
+{
+    char *end;
+    uint32_t from = strtoul(arg, &end, 10);
+    uint32_t to = strtoul(end, NULL, 10);
+    if (Query_Start(port, from, to) != 0)
+    {
+        printf("#ERR Q\r\n");
+    }
+}
+
+static void Cmd_Download(char *arg, uint8_t port)
+{
+    char *end;
+    char *tail;
+    uint32_t from = strtoul(arg, &end, 10);
+    uint32_t to = strtoul(end, &end, 10);
+    uint32_t index = strtoul(end, &tail, 10);
+    if (Query_StartBlocks(port, from, to, (tail != end) ? 1U : 0U, index) != 0)
+    {
+        printf("#ERR DL\r\n");
+    }
+}
+
+static void Cmd_Ack(char *arg, uint8_t port)
+{
+    Query_Ack(strtoul(arg, NULL, 10));
+}
+
+static void Cmd_Nak(char *arg, uint8_t port)
+{
+    Query_Nak(strtoul(arg, NULL, 10));
+}
+
+static void Cmd_Stop(char *arg, uint8_t port)
+{
+    Query_Stop();
+}
+
+static void Cmd_Bench(char *arg, uint8_t port)
+{
+    SD_Bench_Start();   /* 之后由主循环 SD_Bench_Poll 分步执行 */
+}
+
+static void Cmd_Format(char *arg, uint8_t port)
+{
+    uint32_t period;
+    uint16_t every;
+
+    /* 格式化要几秒，期间主循环停住；只在记录已暂停（#RATE <ms> 0）、没有测速时执行 */
+    App_GetSampling(&period, &every);
+    if (every != 0U)
+    {
+        printf("#ERR FORMAT LOGGING\r\n");
+        return;
+    }
+    if (SD_Bench_Active())
+    {
+        printf("#ERR FORMAT BENCH\r\n");
+        return;
+    }
+
+    int err = SD_Card_Format();
+    if (err != 0)
+    {
+        printf("#ERR FORMAT %d\r\n", err);
+    }
+    else
+    {
+        printf("#OK FORMAT\r\n");
+    }
+}
+
+static void Cmd_BaudOk(char *arg, uint8_t port)
+{
+    if (port == QUERY_PORT_UART && UartBaud_Confirm())
+    {
+        printf("#OK BAUD OK\r\n");
+    }
+}
+
+static void Cmd_Baud(char *arg, uint8_t port)
+{
+    uint32_t rate = strtoul(arg, NULL, 10);
+    if (port == QUERY_PORT_UART && UartBaud_Request(rate) == 0)
+    {
+        printf("#OK BAUD %lu\r\n", (unsigned long)rate);
+    }
+    else
+    {
+        printf("#ERR BAUD\r\n");
+    }
+}
+
+static void Cmd_Schema(char *arg, uint8_t port)
+{
+    Telemetry_SendSchema();
+}
+
+static void Cmd_Tlm(char *arg, uint8_t port)
+{
+    if (strcmp(arg, "BIN") != 0 && strcmp(arg, "TEXT") != 0)
+    {
+        printf("#ERR TLM\r\n");
+        return;
+    }
+    printf("#OK TLM %s\r\n", arg);
+    Telemetry_SetMode((strcmp(arg, "TEXT") == 0) ? TELEM_MODE_TEXT : TELEM_MODE_BIN);
+}
+
+static void Cmd_CalPh(char *arg, uint8_t port)
+{
+    float k, b;
+    if (Cmd_ParseFloat(&arg, &k) != 0 || Cmd_ParseFloat(&arg, &b) != 0)
+    {
+        printf("#ERR CAL PH\r\n");
+        return;
+    }
+    PH_SetCalibration(k, b);
+    printf("#OK CAL PH %.4f %.4f\r\n", (double)k, (double)b);
+}
+
+static void Cmd_CalTurb(char *arg, uint8_t port)
+{
+    float k;
+    if (Cmd_ParseFloat(&arg, &k) != 0)
+    {
+        printf("#ERR CAL TURB\r\n");
+        return;
+    }
+    App_SetTurbidityK(k);
+    printf("#OK CAL TURB %.2f\r\n", (double)k);
+}
+
+static void Cmd_Rate(char *arg, uint8_t port)
+{
+    uint32_t period, every;
+    if (Cmd_ParseU32(&arg, &period) != 0 || Cmd_ParseU32(&arg, &every) != 0 ||
+        period < CMD_RATE_MIN_MS || period > CMD_RATE_MAX_MS || every > 0xFFFFU)
+    {
+        printf("#ERR RATE\r\n");
+        return;
+    }
+    App_SetSampling(period, (uint16_t)every);
+    printf("#OK RATE %lu %lu\r\n", (unsigned long)period, (unsigned long)every);
+}
+
+static void Cmd_Sync(char *arg, uint8_t port)
+{
+    uint32_t sectors, interval;
+    if (Cmd_ParseU32(&arg, &sectors) != 0 || Cmd_ParseU32(&arg, &interval) != 0 ||
+        sectors > 0xFFFFU)
+    {
+        printf("#ERR SYNC\r\n");
+        return;
+    }
+    SD_Card_SetSyncPolicy((uint16_t)sectors, interval);
+    printf("#OK SYNC %lu %lu\r\n", (unsigned long)sectors, (unsigned long)interval);
+}
+
+static void Cmd_Status(char *arg, uint8_t port)
+{
+    uint32_t period, syncMs, dropped;
+    uint16_t every, syncSectors, pending, peak;
+    float k, b;
+
+    App_GetSampling(&period, &every);
+    SD_Card_GetSyncPolicy(&syncSectors, &syncMs);
+    SD_Card_GetQueueStats(&pending, &peak, &dropped);
+    uint8_t custom = PH_GetCalibration(&k, &b);
+
+    printf("#STATUS TIME=%s%lu RATE=%lu LOG=%u SYNC=%u,%lu",
+           SD_Card_TimeSet() ? "" : "+", (unsigned long)SD_Card_GetTime(),
+           (unsigned long)period, (unsigned)every, (unsigned)syncSectors, (unsigned long)syncMs);
+    if (custom)
+    {
+        printf(" PH=%.4f,%.4f", (double)k, (double)b);
+    }
+    else
+    {
+        printf(" PH=DEFAULT");
+    }
+    printf(" TURB=%.2f BAUD=%lu TLM=%s Q=%u/%u/%lu\r\n",
+           (double)App_GetTurbidityK(), (unsigned long)UartBaud_Get(),
+           (Telemetry_GetMode() == TELEM_MODE_TEXT) ? "TEXT" : "BIN",
+           (unsigned)pending, (unsigned)peak, (unsigned long)dropped);
+}
+
+/* 命令表：按顺序匹配，带固定参数的（如 "#BAUD OK"）排在同名命令前面 */
+static const Cmd_Entry_t s_cmds[] =
+{
+    { "#ACK",        Cmd_Ack,      CMD_F_ARG | CMD_F_QUERY },
+    { "#NAK",        Cmd_Nak,      CMD_F_ARG | CMD_F_QUERY },
+    { "#STOP",       Cmd_Stop,     CMD_F_QUERY },
+    { "#BAUD OK",    Cmd_BaudOk,   CMD_F_QUERY },
+    { "#BAUD",       Cmd_Baud,     CMD_F_ARG },
+    { "#TIME",       Cmd_Time,     CMD_F_ARG },
+    { "#Q",          Cmd_Query,    CMD_F_ARG },
+    { "#DL",         Cmd_Download, CMD_F_ARG },
+    { "#SCHEMA",     Cmd_Schema,   0 },
+    { "#TLM",        Cmd_Tlm,      CMD_F_ARG },
+    { "#CAL PH",     Cmd_CalPh,    CMD_F_ARG },
+    { "#CAL TURB",   Cmd_CalTurb,  CMD_F_ARG },
+    { "#RATE",       Cmd_Rate,     CMD_F_ARG },
+    { "#SYNC",       Cmd_Sync,     CMD_F_ARG },
+    { "#STATUS",     Cmd_Status,   0 },
+    { "#BENCH",      Cmd_Bench,    0 },
+    { "#FORMAT YES", Cmd_Format,   0 },
+};
+
+/* 查命令表，*arg 指向命令字之后的参数（没有时为 NULL）；没有匹配的返回 NULL */
+static const Cmd_Entry_t *Cmd_Find(char *line, char **arg)
+{
+    for (uint8_t i = 0; i < sizeof(s_cmds) / sizeof(s_cmds[0]); i++)
+    {
+        size_t n = strlen(s_cmds[i].name);
+        if (strncmp(line, s_cmds[i].name, n) != 0 || (line[n] != '\0' && line[n] != ' '))
+        {
+            continue;
+        }
+        *arg = (line[n] == ' ' && line[n + 1] != '\0') ? &line[n + 1] : NULL;
+        if ((s_cmds[i].flags & CMD_F_ARG) && *arg == NULL)
+        {
+            return NULL;
+        }
+        return &s_cmds[i];
+    }
+    return NULL;
+}
+
+static void Cmd_Line(char *line, uint8_t port)
+{
+    char *arg = NULL;
+    const Cmd_Entry_t *cmd = Cmd_Find(line, &arg);
+
+    /* 回传历史数据期间串口被二进制帧占用，会回文字的命令等回传结束再执行；
+     * 批量下载的应答（#ACK / #NAK / #STOP）和波特率保持（#BAUD OK）马上执行 */
+    if (Query_IsActive() && (cmd == NULL || !(cmd->flags & CMD_F_QUERY)))
+    {
+        if (!s_deferredReady)
+        {
+            strcpy(s_deferred, line);
+            s_deferredPort = port;
+            s_deferredReady = 1;
+        }
+        return;
+    }
+
+    if (cmd == NULL)
+    {
+        printf("#ERR %.*s\r\n", (int)strcspn(line, " "), line);
+        return;
+    }
+    cmd->handler(arg, port);
+}
+
+/* 收到一个字符（主循环里调用），'\n' 或 '\r' 结束一行 */
+static void Cmd_RxChar(uint8_t port, char c)
+{
+    if (c == '\n' || c == '\r')
+    {
+        if (s_rxLen[port] > 0U)
+        {
+            s_rxBuf[port][s_rxLen[port]] = '\0';
+            s_rxLen[port] = 0;
+            if (port == QUERY_PORT_UART)
+            {
+                UartBaud_Alive();
+            }
+            Cmd_Line(s_rxBuf[port], port);
+        }
+    }
+    else if (s_rxLen[port] < CMD_LINE_MAX - 1U)
+    {
+        s_rxBuf[port][s_rxLen[port]++] = c;
+    }
+    else
+    {
+        s_rxLen[port] = 0;  /* 行太长，丢弃 */
+    }
+}
+
+void Cmd_Init(void)
+{
+    s_rxLen[QUERY_PORT_UART] = 0;
+    s_rxLen[QUERY_PORT_USB] = 0;
+    s_deferredReady = 0;
+    Cmd_StartRx();
+}
+
+void Cmd_Poll(void)
+{
+    if (s_deferredReady && !Query_IsActive())
+    {
+        s_deferredReady = 0;
+        Cmd_Line(s_deferred, s_deferredPort);
+    }
+
+    if (s_rxRestart && huart1.RxState == HAL_UART_STATE_READY)
+    {
+        /* 出错前收到的半行也不要了 */
+        s_rxRestart = 0;
+        s_rxLen[QUERY_PORT_UART] = 0;
+        Cmd_StartRx();
+    }
+
+    while (s_rxReadPos != s_rxDmaPos)
+    {
+        char c = (char)s_rxDma[s_rxReadPos];
+        s_rxReadPos = (uint16_t)((s_rxReadPos + 1U) % CMD_RX_DMA);
+        Cmd_RxChar(QUERY_PORT_UART, c);
+    }
+
+    while (s_usbTail != s_usbHead)
+    {
+        char c = (char)s_usbRx[s_usbTail % CMD_USB_RX];
+        s_usbTail++;
+        Cmd_RxChar(QUERY_PORT_USB, c);
+    }
+}
@@ -0,0 +1,27 @@
+/*
+ * CRC-16/CCITT-FALSE 计算
+ * - 按半字节查表（16 项，32 字节 Flash），比逐位计算快约 4 倍，
+ *   又不用 512 字节的整字节表
+ */
+
+#include "crc16.h"
+
+static const uint16_t s_crcNibble[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+uint16_t CRC16_Update(uint16_t crc, const void *data, uint32_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (len--)
+    {
+        crc = (uint16_t)((crc << 4) ^ s_crcNibble[(crc >> 12) ^ (*p >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ s_crcNibble[(crc >> 12) ^ (*p & 0x0FU)]);
+        p++;
+    }
+
+    return crc;
+}
@@ -0,0 +1,394 @@
+/*
+ * 片内 Flash 后备日志实现
+ * - 序号为 seq 的块在第 seq % FLASH_LOG_BLOCKS 个位置，[s_tail, s_head) 为待转存的块
+ * - s_blankSeq 为已确认擦好的页的第一块序号，FlashLog_Poll 据此决定要不要擦下一页
+ * - 烧写中途复位留下的坏块 CRC 不对，扫描时当作空位，下次写到它时跳过或随整页擦掉
+ * - RAM 块 s_blk 在 .noinit 段，每加一条就盖上块尾、算好 CRC，热复位后 FlashLog_Init 接着用
+ */
+
+#include "flashlog.h"
+
+#include "crc16.h"
+#include "logblock.h"
+#include "main.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FLASH_LOG_BLOCKS_PER_PAGE   (FLASH_LOG_PAGE_SIZE / LOG_BLOCK_SIZE)
+#define FLASH_LOG_BLOCKS            (FLASH_LOG_PAGES * FLASH_LOG_BLOCKS_PER_PAGE)
+#define FLASH_LOG_TRAILER_OFS       (LOG_BLOCK_SIZE - 2U - LOG_RAW_TRAILER)
+#define FLASH_LOG_FLAG_OFS          (FLASH_LOG_TRAILER_OFS - 2U)
+#define FLASH_LOG_RESERVE           (LOG_RAW_TRAILER + 2U)
+
+/* 块状态 */
+#define FLASH_LOG_EMPTY     0U      /* 空白或损坏 */
+#define FLASH_LOG_PENDING   1U      /* 还没转存 */
+#define FLASH_LOG_DONE      2U      /* 已转存 */
+
+extern uint8_t _flashlog_start[];   /* 链接脚本里 FLASHLOG 区的起始地址 */
+
+static uint8_t    s_blk[LOG_BLOCK_SIZE] NOINIT_RAM __attribute__((aligned(4)));
+static LogBlock_t s_enc;
+static uint32_t   s_encTick = 0;    /* RAM 块开始的时刻 */
+static uint32_t   s_head = 0;       /* 下一个写入 Flash 的块序号 */
+static uint32_t   s_tail = 0;       /* 最旧的待转存块序号 */
+static uint32_t   s_blankSeq = 0xFFFFFFFFUL;
+static uint32_t   s_dropped = 0;
+static uint8_t    s_releaseFailed = 0;  /* s_releaseSeq 块已转存，但作废标记没写上 */
+static uint32_t   s_releaseSeq = 0;
+static uint32_t   s_releaseErrors = 0;
+
+static uint8_t *FlashLog_Block(uint32_t seq)
+{
+    return &_flashlog_start[(seq % FLASH_LOG_BLOCKS) * LOG_BLOCK_SIZE];
+}
+
+static uint8_t FlashLog_State(const uint8_t *p, uint32_t *seq)
+{
+    static const uint16_t erased = 0xFFFFU;
+    LogRawTrailer_t tr;
+    uint16_t crc, flag;
+
+    memcpy(&tr, &p[FLASH_LOG_TRAILER_OFS], sizeof(tr));
+    memcpy(&flag, &p[FLASH_LOG_FLAG_OFS], sizeof(flag));
+    memcpy(&crc, &p[LOG_BLOCK_SIZE - 2U], sizeof(crc));
+    if (tr.gen != FLASH_LOG_GEN)
+    {
+        return FLASH_LOG_EMPTY;
+    }
+
+    /* 转存标志按 0xFFFF 参与 CRC */
+    uint16_t c = CRC16_Update(CRC16_INIT, p, FLASH_LOG_FLAG_OFS);
+    c = CRC16_Update(c, &erased, sizeof(erased));
+    c = CRC16_Update(c, &p[FLASH_LOG_TRAILER_OFS], LOG_RAW_TRAILER);
+    if (c != crc)
+    {
+        return FLASH_LOG_EMPTY;
+    }
+
+    *seq = tr.seq;
+    return (flag == 0xFFFFU) ? FLASH_LOG_PENDING : FLASH_LOG_DONE;
+}
+
+static uint8_t FlashLog_IsBlank(const uint8_t *p, uint32_t len)
+{
+    const uint32_t *w = (const uint32_t *)p;
+
+    for (uint32_t i = 0; i < len / 4U; i++)
+    {
+        if (w[i] != 0xFFFFFFFFUL)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* 擦除 seq 所在的页，页里还没转存的旧块作废 */
+static int FlashLog_ErasePage(uint32_t seq)
+{
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t page = seq - seq % FLASH_LOG_BLOCKS_PER_PAGE;
+    uint32_t fault = 0;
+
+    /* 页里原来是 page - FLASH_LOG_BLOCKS 起的一页块 */
+    if (page + FLASH_LOG_BLOCKS_PER_PAGE > FLASH_LOG_BLOCKS &&
+        s_tail < page + FLASH_LOG_BLOCKS_PER_PAGE - FLASH_LOG_BLOCKS)
+    {
+        s_dropped += page + FLASH_LOG_BLOCKS_PER_PAGE - FLASH_LOG_BLOCKS - s_tail;
+        s_tail = page + FLASH_LOG_BLOCKS_PER_PAGE - FLASH_LOG_BLOCKS;
+    }
+
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = (uintptr_t)FlashLog_Block(page);
+    erase.NbPages = 1U;
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef st = HAL_FLASHEx_Erase(&erase, &fault);
+    HAL_FLASH_Lock();
+    if (st != HAL_OK)
+    {
+        printf("Flash log: erase page error\r\n");
+        return -1;
+    }
+    s_blankSeq = page;
+    return 0;
+}
+
+/* RAM 块盖上序号 s_head 的块尾并算好 CRC，和烧写进 Flash 的内容一样 */
+static void FlashLog_Seal(void)
+{
+    static const uint16_t erased = 0xFFFFU;
+    LogRawTrailer_t tr;
+
+    tr.seq = s_head;
+    tr.gen = FLASH_LOG_GEN;
+    memcpy(&s_blk[FLASH_LOG_FLAG_OFS], &erased, sizeof(erased));
+    memcpy(&s_blk[FLASH_LOG_TRAILER_OFS], &tr, sizeof(tr));
+    LogBlock_Finish(&s_enc);
+}
+
+/* 把 RAM 块烧写到 s_head 处，之后 RAM 块清空（失败时这一块丢弃） */
+static int FlashLog_WriteBlock(void)
+{
+    uint8_t *dst = FlashLog_Block(s_head);
+    int ret = 0;
+
+    /* 写入位置不空白（上次烧写中途复位）：在页中间就跳过这个位置，在页首就擦掉这一页 */
+    if (!FlashLog_IsBlank(dst, LOG_BLOCK_SIZE))
+    {
+        if (s_head % FLASH_LOG_BLOCKS_PER_PAGE != 0U)
+        {
+            if (s_tail == s_head)
+            {
+                s_tail++;
+            }
+            s_head++;
+            dst = FlashLog_Block(s_head);
+        }
+        if (!FlashLog_IsBlank(dst, LOG_BLOCK_SIZE) && FlashLog_ErasePage(s_head) != 0)
+        {
+            ret = -1;
+        }
+    }
+
+    FlashLog_Seal();
+    if (ret == 0)
+    {
+        HAL_FLASH_Unlock();
+        for (uint32_t i = 0; i < LOG_BLOCK_SIZE && ret == 0; i += 2U)
+        {
+            uint16_t half;
+            memcpy(&half, &s_blk[i], sizeof(half));
+            if (half != 0xFFFFU &&
+                HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, (uintptr_t)&dst[i], half) != HAL_OK)
+            {
+                ret = -1;
+            }
+        }
+        HAL_FLASH_Lock();
+        if (ret == 0 && memcmp(dst, s_blk, LOG_BLOCK_SIZE) != 0)
+        {
+            ret = -1;
+        }
+    }
+
+    /* 写坏的位置也占掉一个序号，扫描时 CRC 不对会当作空位 */
+    s_head++;
+    s_enc.count = 0;
+    if (ret != 0)
+    {
+        s_dropped++;
+        if (s_tail == s_head - 1U)
+        {
+            s_tail = s_head;
+        }
+        printf("Flash log: program block %lu error\r\n", (unsigned long)(s_head - 1U));
+    }
+    return ret;
+}
+
+void FlashLog_Init(void)
+{
+    uint32_t seq, last = 0, oldest = 0;
+    uint8_t found = 0, pending = 0;
+
+    s_enc.count = 0;
+    s_blankSeq = 0xFFFFFFFFUL;
+
+    /* 最大的序号为最后写入的块；待转存的块是它之前连续的一段 */
+    for (uint32_t pos = 0; pos < FLASH_LOG_BLOCKS; pos++)
+    {
+        uint8_t st = FlashLog_State(FlashLog_Block(pos), &seq);
+        if (st == FLASH_LOG_EMPTY || seq % FLASH_LOG_BLOCKS != pos)
+        {
+            continue;
+        }
+        if (!found || seq > last)
+        {
+            last = seq;
+        }
+        if (st == FLASH_LOG_PENDING && (!pending || seq < oldest))
+        {
+            oldest = seq;
+            pending = 1;
+        }
+        found = 1;
+    }
+
+    s_head = found ? last + 1U : 0U;
+    s_tail = pending ? oldest : s_head;
+    if (s_head - s_tail > FLASH_LOG_BLOCKS)
+    {
+        s_tail = s_head - FLASH_LOG_BLOCKS;
+    }
+
+    /* 热复位前 RAM 里没写满的块：序号正好是下一块时接着往里加 */
+    if (FlashLog_State(s_blk, &seq) == FLASH_LOG_PENDING && seq == s_head &&
+        LogBlock_Resume(&s_enc, s_blk) == 0)
+    {
+        LogBlock_Reserve(&s_enc, FLASH_LOG_RESERVE);
+        s_encTick = HAL_GetTick();
+    }
+    else
+    {
+        s_enc.count = 0;
+    }
+    printf("Flash log: %u blocks pending\r\n", (unsigned)FlashLog_Pending());
+}
+
+int FlashLog_Add(const LogRecord_t *rec)
+{
+    int ret = 0;
+
+    if (s_enc.count != 0U)
+    {
+        if (LogBlock_Add(&s_enc, rec) == 0)
+        {
+            FlashLog_Seal();
+            return 0;
+        }
+        ret = FlashLog_WriteBlock();
+    }
+
+    LogBlock_Start(&s_enc, s_blk, rec);
+    LogBlock_Reserve(&s_enc, FLASH_LOG_RESERVE);
+    FlashLog_Seal();
+    s_encTick = HAL_GetTick();
+    return ret;
+}
+
+void FlashLog_Flush(void)
+{
+    if (s_enc.count != 0U)
+    {
+        FlashLog_WriteBlock();
+    }
+}
+
+void FlashLog_Poll(void)
+{
+    /* 下一块要写在页首时，这一页必须已经擦好 */
+    uint32_t next = s_head + (FLASH_LOG_BLOCKS_PER_PAGE - s_head % FLASH_LOG_BLOCKS_PER_PAGE) % FLASH_LOG_BLOCKS_PER_PAGE;
+    if (s_blankSeq != next)
+    {
+        if (FlashLog_IsBlank(FlashLog_Block(next), FLASH_LOG_PAGE_SIZE))
+        {
+            s_blankSeq = next;
+        }
+        else
+        {
+            FlashLog_ErasePage(next);
+        }
+        return;
+    }
+
+    if (s_enc.count != 0U && (HAL_GetTick() - s_encTick) >= FLASH_LOG_FLUSH_MS)
+    {
+        FlashLog_WriteBlock();
+    }
+}
+
+uint16_t FlashLog_Pending(void)
+{
+    return (uint16_t)(s_head - s_tail + ((s_enc.count != 0U) ? 1U : 0U));
+}
+
+/* 给 s_tail 块写上作废标记并读回确认，成功才前移 s_tail */
+static int FlashLog_MarkDone(void)
+{
+    static const uint16_t done = 0;
+    uint8_t *p = &FlashLog_Block(s_tail)[FLASH_LOG_FLAG_OFS];
+    uint16_t flag;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef st = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, (uintptr_t)p, done);
+    HAL_FLASH_Lock();
+
+    memcpy(&flag, p, sizeof(flag));
+    if (st != HAL_OK || flag != done)
+    {
+        s_releaseFailed = 1;
+        s_releaseSeq = s_tail;
+        s_releaseErrors++;
+        printf("Flash log: release block %lu error\r\n", (unsigned long)s_tail);
+        return -1;
+    }
+    s_releaseFailed = 0;
+    s_tail++;
+    return 0;
+}
+
+const uint8_t *FlashLog_Oldest(void)
+{
+    uint32_t seq;
+
+    /* 上次作废失败的块已经转存过，先补写标记，写不上就不再交出块，免得重复转存
+     * （这一块已随整页擦除丢弃时不用再补） */
+    if (s_releaseFailed && s_tail == s_releaseSeq && FlashLog_MarkDone() != 0)
+    {
+        return NULL;
+    }
+    s_releaseFailed = 0;
+
+    if (s_tail == s_head)
+    {
+        if (s_enc.count == 0U || FlashLog_WriteBlock() != 0)
+        {
+            return NULL;
+        }
+    }
+
+    /* 坏块（烧写失败）直接跳过 */
+    while (s_tail != s_head)
+    {
+        const uint8_t *p = FlashLog_Block(s_tail);
+        if (FlashLog_State(p, &seq) == FLASH_LOG_PENDING && seq == s_tail)
+        {
+            return p;
+        }
+        s_tail++;
+    }
+    return NULL;
+}
+
+int FlashLog_Release(void)
+{
+    if (s_tail == s_head)
+    {
+        return 0;
+    }
+    return FlashLog_MarkDone();
+}
+
+int FlashLog_Newest(LogRecord_t *rec)
+{
+    LogBlock_t dec;
+    uint32_t seq;
+
+    if (s_enc.count != 0U)
+    {
+        *rec = s_enc.prev;
+        return 0;
+    }
+
+    /* 最后写入的块（写坏的跳过，再往前找） */
+    for (uint32_t n = s_head; n != s_tail; n--)
+    {
+        uint8_t *p = FlashLog_Block(n - 1U);
+        if (FlashLog_State(p, &seq) == FLASH_LOG_PENDING && seq == n - 1U && LogBlock_Open(&dec, p) > 0)
+        {
+            while (LogBlock_Next(&dec, rec))
+            {
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void FlashLog_GetStats(uint16_t *pending, uint32_t *dropped, uint32_t *release_errors)
+{
+    if (pending != NULL) *pending = FlashLog_Pending();
+    if (dropped != NULL) *dropped = s_dropped;
+    if (release_errors != NULL) *release_errors = s_releaseErrors;
+}
@@ -21,6 +21,202 @@
 #include "i2c.h"
 
 /* USER CODE BEGIN 0 */
+#include <string.h>
+
+#define I2C_OP_WRITE      0U
+#define I2C_OP_READ       1U
+#define I2C_OP_MEM_WRITE  2U
+#define I2C_OP_MEM_READ   3U
+
+#define I2C_SLOT_NONE     0xFFU
+
+typedef struct
+{
+  uint16_t dev_addr;      /* HAL 风格的 8 位地址（7 位地址左移一位） */
+  uint16_t mem_addr;
+  uint16_t mem_addr_size;
+  uint16_t len;
+  uint8_t  op;
+  uint8_t  next;          /* 同优先级 FIFO 链表 / 空闲链表 */
+  uint8_t *rx_buf;
+  I2C_BusCallback cb;
+  void    *ctx;
+  uint8_t  tx_data[I2C_BUS_INLINE_MAX];
+} I2C_BusXfer;
+
+static I2C_BusXfer s_busPool[I2C_BUS_QUEUE_LEN];
+static uint8_t s_busHead[I2C_PRIO_LEVELS];
+static uint8_t s_busTail[I2C_PRIO_LEVELS];
+static uint8_t s_busFree = I2C_SLOT_NONE;
+static uint8_t s_busFreeCount = 0;
+static volatile uint8_t s_busActive = I2C_SLOT_NONE;
+
+static void I2C_Bus_Reset(void)
+{
+  for (uint8_t i = 0; i < I2C_BUS_QUEUE_LEN; i++)
+  {
+    s_busPool[i].next = (uint8_t)(i + 1U);
+  }
+  s_busPool[I2C_BUS_QUEUE_LEN - 1U].next = I2C_SLOT_NONE;
+  s_busFree = 0;
+  s_busFreeCount = I2C_BUS_QUEUE_LEN;
+
+  for (uint8_t p = 0; p < I2C_PRIO_LEVELS; p++)
+  {
+    s_busHead[p] = I2C_SLOT_NONE;
+    s_busTail[p] = I2C_SLOT_NONE;
+  }
+  s_busActive = I2C_SLOT_NONE;
+}
+
+/* 取出优先级最高的待执行事务，调用方需已关中断 */
+static uint8_t I2C_Bus_PopNext(void)
+{
+  for (uint8_t p = 0; p < I2C_PRIO_LEVELS; p++)
+  {
+    uint8_t idx = s_busHead[p];
+    if (idx != I2C_SLOT_NONE)
+    {
+      s_busHead[p] = s_busPool[idx].next;
+      if (s_busHead[p] == I2C_SLOT_NONE)
+      {
+        s_busTail[p] = I2C_SLOT_NONE;
+      }
+      return idx;
+    }
+  }
+  return I2C_SLOT_NONE;
+}
+
+static HAL_StatusTypeDef I2C_Bus_StartXfer(I2C_BusXfer *x)
+{
+  switch (x->op)
+  {
+    case I2C_OP_WRITE:
+      return HAL_I2C_Master_Transmit_IT(&hi2c1, x->dev_addr, x->tx_data, x->len);
+    case I2C_OP_READ:
+      return HAL_I2C_Master_Receive_IT(&hi2c1, x->dev_addr, x->rx_buf, x->len);
+    case I2C_OP_MEM_WRITE:
+      return HAL_I2C_Mem_Write_IT(&hi2c1, x->dev_addr, x->mem_addr, x->mem_addr_size,
+                                  x->tx_data, x->len);
+    case I2C_OP_MEM_READ:
+      return HAL_I2C_Mem_Read_IT(&hi2c1, x->dev_addr, x->mem_addr, x->mem_addr_size,
+                                 x->rx_buf, x->len);
+    default:
+      return HAL_ERROR;
+  }
+}
+
+/* 总线空闲时启动下一笔事务；启动失败的事务直接以错误结束，继续尝试后面的。
+ * 调用方需已关中断（中断回调里本身就在 I2C 中断上下文） */
+static void I2C_Bus_Kick(void)
+{
+  while (s_busActive == I2C_SLOT_NONE)
+  {
+    uint8_t idx = I2C_Bus_PopNext();
+    if (idx == I2C_SLOT_NONE)
+    {
+      return;
+    }
+
+    s_busActive = idx;
+    if (I2C_Bus_StartXfer(&s_busPool[idx]) == HAL_OK)
+    {
+      return;
+    }
+
+    I2C_BusXfer *x = &s_busPool[idx];
+    s_busActive = I2C_SLOT_NONE;
+    if (x->cb != NULL)
+    {
+      x->cb(HAL_ERROR, x->ctx);
+    }
+    x->next = s_busFree;
+    s_busFree = idx;
+    s_busFreeCount++;
+  }
+}
+
+/* 当前事务结束：回调通知设备驱动，归还槽位，并立即启动下一笔 */
+static void I2C_Bus_Complete(HAL_StatusTypeDef status)
+{
+  uint8_t idx = s_busActive;
+  if (idx == I2C_SLOT_NONE)
+  {
+    return;
+  }
+
+  I2C_BusXfer *x = &s_busPool[idx];
+  s_busActive = I2C_SLOT_NONE;
+  if (x->cb != NULL)
+  {
+    x->cb(status, x->ctx);
+  }
+  x->next = s_busFree;
+  s_busFree = idx;
+  s_busFreeCount++;
+
+  I2C_Bus_Kick();
+}
+
+static HAL_StatusTypeDef I2C_Bus_Submit(uint8_t op, uint16_t dev_addr, uint8_t prio,
+                                        uint16_t mem_addr, uint16_t mem_addr_size,
+                                        const uint8_t *tx, uint8_t *rx, uint16_t len,
+                                        I2C_BusCallback cb, void *ctx)
+{
+  if (len == 0U || prio >= I2C_PRIO_LEVELS)
+  {
+    return HAL_ERROR;
+  }
+  if (tx != NULL && len > I2C_BUS_INLINE_MAX)
+  {
+    return HAL_ERROR;
+  }
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  /* 最后几个槽位留给传感器，显示刷新排满队列时传感器事务仍能提交 */
+  uint8_t idx = s_busFree;
+  if (idx == I2C_SLOT_NONE ||
+      (prio != I2C_PRIO_SENSOR && s_busFreeCount <= I2C_BUS_SENSOR_RESERVE))
+  {
+    __set_PRIMASK(primask);
+    return HAL_BUSY;
+  }
+  s_busFree = s_busPool[idx].next;
+  s_busFreeCount--;
+
+  I2C_BusXfer *x = &s_busPool[idx];
+  x->op = op;
+  x->dev_addr = dev_addr;
+  x->mem_addr = mem_addr;
+  x->mem_addr_size = mem_addr_size;
+  x->len = len;
+  x->rx_buf = rx;
+  x->cb = cb;
+  x->ctx = ctx;
+  x->next = I2C_SLOT_NONE;
+  if (tx != NULL)
+  {
+    memcpy(x->tx_data, tx, len);
+  }
+
+  if (s_busTail[prio] == I2C_SLOT_NONE)
+  {
+    s_busHead[prio] = idx;
+  }
+  else
+  {
+    s_busPool[s_busTail[prio]].next = idx;
+  }
+  s_busTail[prio] = idx;
+
+  I2C_Bus_Kick();
+
+  __set_PRIMASK(primask);
+  return HAL_OK;
+}
 
 /* USER CODE END 0 */
 
@@ -51,7 +247,7 @@ void MX_I2C1_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN I2C1_Init 2 */
-
+  I2C_Bus_Reset();
   /* USER CODE END I2C1_Init 2 */
 
 }
@@ -80,6 +276,12 @@ void HAL_I2C_MspInit(I2C_HandleTypeDef* i2cHandle)
 
     /* I2C1 clock enable */
     __HAL_RCC_I2C1_CLK_ENABLE();
+
+    /* I2C1 interrupt Init */
+    HAL_NVIC_SetPriority(I2C1_EV_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+    HAL_NVIC_SetPriority(I2C1_ER_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
   /* USER CODE BEGIN I2C1_MspInit 1 */
 
   /* USER CODE END I2C1_MspInit 1 */
@@ -105,6 +307,9 @@ void HAL_I2C_MspDeInit(I2C_HandleTypeDef* i2cHandle)
 
     HAL_GPIO_DeInit(GPIOB, GPIO_PIN_9);
 
+    /* I2C1 interrupt Deinit */
+    HAL_NVIC_DisableIRQ(I2C1_EV_IRQn);
+    HAL_NVIC_DisableIRQ(I2C1_ER_IRQn);
   /* USER CODE BEGIN I2C1_MspDeInit 1 */
 
   /* USER CODE END I2C1_MspDeInit 1 */
@@ -113,4 +318,94 @@ void HAL_I2C_MspDeInit(I2C_HandleTypeDef* i2cHandle)
 
 /* USER CODE BEGIN 1 */
 
+HAL_StatusTypeDef I2C_Bus_Write(uint16_t dev_addr, uint8_t prio,
+                                const uint8_t *data, uint16_t len,
+                                I2C_BusCallback cb, void *ctx)
+{
+  if (data == NULL) return HAL_ERROR;
+  return I2C_Bus_Submit(I2C_OP_WRITE, dev_addr, prio, 0, 0, data, NULL, len, cb, ctx);
+}
+
+HAL_StatusTypeDef I2C_Bus_Read(uint16_t dev_addr, uint8_t prio,
+                               uint8_t *buf, uint16_t len,
+                               I2C_BusCallback cb, void *ctx)
+{
+  if (buf == NULL) return HAL_ERROR;
+  return I2C_Bus_Submit(I2C_OP_READ, dev_addr, prio, 0, 0, NULL, buf, len, cb, ctx);
+}
+
+HAL_StatusTypeDef I2C_Bus_MemRead(uint16_t dev_addr, uint8_t prio,
+                                  uint16_t mem_addr, uint16_t mem_addr_size,
+                                  uint8_t *buf, uint16_t len,
+                                  I2C_BusCallback cb, void *ctx)
+{
+  if (buf == NULL) return HAL_ERROR;
+  return I2C_Bus_Submit(I2C_OP_MEM_READ, dev_addr, prio, mem_addr, mem_addr_size,
+                        NULL, buf, len, cb, ctx);
+}
+
+HAL_StatusTypeDef I2C_Bus_MemWrite(uint16_t dev_addr, uint8_t prio,
+                                   uint16_t mem_addr, uint16_t mem_addr_size,
+                                   const uint8_t *data, uint16_t len,
+                                   I2C_BusCallback cb, void *ctx)
+{
+  if (data == NULL) return HAL_ERROR;
+  return I2C_Bus_Submit(I2C_OP_MEM_WRITE, dev_addr, prio, mem_addr, mem_addr_size,
+                        data, NULL, len, cb, ctx);
+}
+
+uint8_t I2C_Bus_IsIdle(void)
+{
+  if (s_busActive != I2C_SLOT_NONE) return 0;
+  for (uint8_t p = 0; p < I2C_PRIO_LEVELS; p++)
+  {
+    if (s_busHead[p] != I2C_SLOT_NONE) return 0;
+  }
+  return 1;
+}
+
+HAL_StatusTypeDef I2C_Bus_Flush(uint32_t timeout_ms)
+{
+  uint32_t start = HAL_GetTick();
+  while (!I2C_Bus_IsIdle())
+  {
+    if ((HAL_GetTick() - start) >= timeout_ms)
+    {
+      return HAL_TIMEOUT;
+    }
+  }
+  return HAL_OK;
+}
+
+/* HAL 完成/错误回调：全部汇总到 I2C_Bus_Complete */
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == I2C1) I2C_Bus_Complete(HAL_OK);
+}
+
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == I2C1) I2C_Bus_Complete(HAL_OK);
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == I2C1) I2C_Bus_Complete(HAL_OK);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == I2C1) I2C_Bus_Complete(HAL_OK);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == I2C1) I2C_Bus_Complete(HAL_ERROR);
+}
+
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == I2C1) I2C_Bus_Complete(HAL_ERROR);
+}
+
 /* USER CODE END 1 */
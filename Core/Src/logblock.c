@@ -0,0 +1,269 @@
+/*
+ * SD 日志压缩块编解码实现
+ * - 位流按字节内高位在前排列，和 log_decoder.py 一致
+ * - 通道字段在 LogRecord_t 里的偏移和符号由 s_fields 表决定，增删通道只改表
+ */
+
+#include "logblock.h"
+
+#include "crc16.h"
+#include <stddef.h>
+#include <string.h>
+
+#define LOG_BLOCK_BUCKETS   5U
+
+/* 各档的数值位数，第 k 档的前缀为 k 个 1 再加一个 0（最后一档没有 0） */
+static const uint8_t s_bucketBits[LOG_BLOCK_BUCKETS] = { 0U, 4U, 8U, 16U, 32U };
+
+/* 参与差值编码的通道：在 LogRecord_t 中的偏移，是否有符号 */
+static const struct
+{
+    uint8_t offset;
+    uint8_t is_signed;
+} s_fields[] =
+{
+    { offsetof(LogRecord_t, ph),   1U },
+    { offsetof(LogRecord_t, temp), 1U },
+    { offsetof(LogRecord_t, tds),  0U },
+    { offsetof(LogRecord_t, turb), 0U },
+};
+
+#define LOG_BLOCK_FIELDS    (sizeof(s_fields) / sizeof(s_fields[0]))
+
+static int32_t LogBlock_Field(const LogRecord_t *rec, uint8_t i)
+{
+    const uint8_t *p = (const uint8_t *)rec + s_fields[i].offset;
+    uint16_t v = (uint16_t)(p[0] | (p[1] << 8));
+    return s_fields[i].is_signed ? (int32_t)(int16_t)v : (int32_t)v;
+}
+
+static void LogBlock_SetField(LogRecord_t *rec, uint8_t i, int32_t v)
+{
+    uint8_t *p = (uint8_t *)rec + s_fields[i].offset;
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)((uint32_t)v >> 8);
+}
+
+static uint32_t LogBlock_ZigZag(uint32_t v)
+{
+    return (v << 1) ^ (uint32_t)-(int32_t)(v >> 31);
+}
+
+static uint32_t LogBlock_UnZigZag(uint32_t z)
+{
+    return (z >> 1) ^ (uint32_t)-(int32_t)(z & 1U);
+}
+
+static uint8_t LogBlock_Bucket(uint32_t z)
+{
+    uint8_t k = 0;
+    while (k < LOG_BLOCK_BUCKETS - 1U && z >= (1UL << s_bucketBits[k]))
+    {
+        k++;
+    }
+    return k;
+}
+
+/* 编码 z 需要的位数 */
+static uint16_t LogBlock_Cost(uint32_t z)
+{
+    uint8_t k = LogBlock_Bucket(z);
+    uint8_t prefix = (k < LOG_BLOCK_BUCKETS - 1U) ? (uint8_t)(k + 1U) : k;
+    return (uint16_t)(prefix + s_bucketBits[k]);
+}
+
+static void LogBlock_PutBits(LogBlock_t *b, uint32_t v, uint8_t n)
+{
+    uint8_t *bits = &b->blk[LOG_BLOCK_HDR];
+    while (n--)
+    {
+        if ((v >> n) & 1U)
+        {
+            bits[b->bitpos >> 3] |= (uint8_t)(0x80U >> (b->bitpos & 7U));
+        }
+        b->bitpos++;
+    }
+}
+
+static uint32_t LogBlock_GetBits(LogBlock_t *b, uint8_t n)
+{
+    const uint8_t *bits = &b->blk[LOG_BLOCK_HDR];
+    uint32_t v = 0;
+    while (n--)
+    {
+        /* 越过位流末尾按 0 读，由 LogBlock_Next 检查 bitpos 判为数据错误 */
+        uint32_t bit = (b->bitpos < b->limit)
+                       ? ((bits[b->bitpos >> 3] >> (7U - (b->bitpos & 7U))) & 1U) : 0U;
+        v = (v << 1) | bit;
+        b->bitpos++;
+    }
+    return v;
+}
+
+static void LogBlock_PutValue(LogBlock_t *b, uint32_t z)
+{
+    uint8_t k = LogBlock_Bucket(z);
+    LogBlock_PutBits(b, (1UL << k) - 1U, k);
+    if (k < LOG_BLOCK_BUCKETS - 1U)
+    {
+        LogBlock_PutBits(b, 0U, 1U);
+    }
+    LogBlock_PutBits(b, z, s_bucketBits[k]);
+}
+
+static uint32_t LogBlock_GetValue(LogBlock_t *b)
+{
+    uint8_t k = 0;
+    while (k < LOG_BLOCK_BUCKETS - 1U && LogBlock_GetBits(b, 1U) != 0U)
+    {
+        k++;
+    }
+    return LogBlock_GetBits(b, s_bucketBits[k]);
+}
+
+void LogBlock_Start(LogBlock_t *b, uint8_t *blk, const LogRecord_t *first)
+{
+    memset(blk, 0, LOG_BLOCK_SIZE);
+    memcpy(blk, first, LOG_RECORD_SIZE);
+    b->blk = blk;
+    b->count = 1;
+    b->index = 1;
+    b->bitpos = 0;
+    b->limit = LOG_BLOCK_BITS;
+    b->delta = 0;
+    b->prev = *first;
+}
+
+void LogBlock_Reserve(LogBlock_t *b, uint16_t bytes)
+{
+    b->limit = (uint16_t)(LOG_BLOCK_BITS - bytes * 8U);
+}
+
+int LogBlock_Add(LogBlock_t *b, const LogRecord_t *rec)
+{
+    uint32_t delta = rec->ts - b->prev.ts;
+    uint32_t zts = LogBlock_ZigZag(delta - b->delta);
+    uint32_t zch[LOG_BLOCK_FIELDS];
+    uint16_t cost;
+    uint8_t i;
+
+    if (rec->seq != (uint8_t)(b->prev.seq + 1U))
+    {
+        return -1;
+    }
+
+    cost = (uint16_t)(LogBlock_Cost(zts) + 1U + ((rec->flags != b->prev.flags) ? 8U : 0U));
+    for (i = 0; i < LOG_BLOCK_FIELDS; i++)
+    {
+        zch[i] = LogBlock_ZigZag((uint32_t)(LogBlock_Field(rec, i) - LogBlock_Field(&b->prev, i)));
+        cost = (uint16_t)(cost + LogBlock_Cost(zch[i]));
+    }
+    if (b->bitpos + cost > b->limit)
+    {
+        return -1;
+    }
+
+    LogBlock_PutValue(b, zts);
+    if (rec->flags != b->prev.flags)
+    {
+        LogBlock_PutBits(b, 1U, 1U);
+        LogBlock_PutBits(b, rec->flags, 8U);
+    }
+    else
+    {
+        LogBlock_PutBits(b, 0U, 1U);
+    }
+    for (i = 0; i < LOG_BLOCK_FIELDS; i++)
+    {
+        LogBlock_PutValue(b, zch[i]);
+    }
+
+    b->count++;
+    b->index = b->count;
+    b->delta = delta;
+    b->prev = *rec;
+    return 0;
+}
+
+void LogBlock_Finish(LogBlock_t *b)
+{
+    uint16_t crc;
+
+    memcpy(&b->blk[LOG_RECORD_SIZE], &b->count, sizeof(b->count));
+    crc = CRC16_Calc(b->blk, LOG_BLOCK_SIZE - 2U);
+    memcpy(&b->blk[LOG_BLOCK_SIZE - 2U], &crc, sizeof(crc));
+}
+
+int LogBlock_Open(LogBlock_t *b, uint8_t *blk)
+{
+    LogRecord_t first;
+    uint16_t crc;
+
+    memcpy(&crc, &blk[LOG_BLOCK_SIZE - 2U], sizeof(crc));
+    memcpy(&first, blk, LOG_RECORD_SIZE);
+    memcpy(&b->count, &blk[LOG_RECORD_SIZE], sizeof(b->count));
+    if (crc != CRC16_Calc(blk, LOG_BLOCK_SIZE - 2U) ||
+        first.crc != CRC16_Calc(&first, LOG_RECORD_SIZE - 2U) || b->count == 0U)
+    {
+        return -1;
+    }
+
+    b->blk = blk;
+    b->index = 0;
+    b->bitpos = 0;
+    b->limit = LOG_BLOCK_BITS;
+    b->delta = 0;
+    return b->count;
+}
+
+int LogBlock_Next(LogBlock_t *b, LogRecord_t *rec)
+{
+    if (b->index >= b->count || b->bitpos > b->limit)
+    {
+        return 0;
+    }
+
+    if (b->index == 0U)
+    {
+        memcpy(rec, b->blk, LOG_RECORD_SIZE);
+    }
+    else
+    {
+        *rec = b->prev;
+        b->delta += LogBlock_UnZigZag(LogBlock_GetValue(b));
+        rec->ts = b->prev.ts + b->delta;
+        if (LogBlock_GetBits(b, 1U) != 0U)
+        {
+            rec->flags = (uint8_t)LogBlock_GetBits(b, 8U);
+        }
+        for (uint8_t i = 0; i < LOG_BLOCK_FIELDS; i++)
+        {
+            int32_t d = (int32_t)LogBlock_UnZigZag(LogBlock_GetValue(b));
+            LogBlock_SetField(rec, i, LogBlock_Field(&b->prev, i) + d);
+        }
+        rec->seq = (uint8_t)(b->prev.seq + 1U);
+        rec->crc = CRC16_Calc(rec, LOG_RECORD_SIZE - 2U);
+        if (b->bitpos > b->limit)
+        {
+            return 0;
+        }
+    }
+
+    b->index++;
+    b->prev = *rec;
+    return 1;
+}
+
+int LogBlock_Resume(LogBlock_t *b, uint8_t *blk)
+{
+    LogRecord_t rec;
+
+    if (LogBlock_Open(b, blk) < 0)
+    {
+        return -1;
+    }
+    while (LogBlock_Next(b, &rec))
+    {
+    }
+    return (b->index == b->count) ? 0 : -1;
+}
@@ -0,0 +1,35 @@
+/*
+ * 测量通道表和定点换算
+ */
+
+#include "logchan.h"
+
+#include <stddef.h>
+
+_Static_assert(LOG_CHANNELS <= LOG_CHAN_MAX, "too many log channels");
+
+const LogChanDef_t g_logChannels[LOG_CHANNELS] =
+{
+    { { "PH",   "",    LOG_TYPE_I16, offsetof(LogRecord_t, ph),   100 }, 0,     1400,  LOG_FLAG_PH_RANGE   },
+    { { "TEMP", "C",   LOG_TYPE_I16, offsetof(LogRecord_t, temp), 100 }, -5000, 12500, LOG_FLAG_TEMP_FAULT },
+    { { "TDS",  "ppm", LOG_TYPE_U16, offsetof(LogRecord_t, tds),  1   }, 0,     65535, LOG_FLAG_TDS_RANGE  },
+    { { "TURB", "TU",  LOG_TYPE_U16, offsetof(LogRecord_t, turb), 10  }, 0,     65535, LOG_FLAG_TURB_RANGE },
+};
+
+int32_t LogChan_Fixed(uint8_t ch, float v, uint8_t *flags)
+{
+    const LogChanDef_t *def = &g_logChannels[ch];
+    float x = v * (float)def->desc.scale;
+
+    if (!(x >= (float)def->lo))     /* 同时处理 NaN */
+    {
+        *flags |= def->flag;
+        return def->lo;
+    }
+    if (x > (float)def->hi)
+    {
+        *flags |= def->flag;
+        return def->hi;
+    }
+    return (int32_t)((x < 0.0f) ? (x - 0.5f) : (x + 0.5f));
+}
@@ -19,10 +19,12 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 #include "adc.h"
+#include "dma.h"
 #include "fatfs.h"
 #include "i2c.h"
 #include "spi.h"
 #include "usart.h"
+#include "usb.h"
 #include "gpio.h"
 
 /* Private includes ----------------------------------------------------------*/
@@ -31,6 +33,13 @@
 #include "oled.h"
 #include "ds18b20.h"
 #include "sdcard.h"
+#include "sdbench.h"
+#include "cmd.h"
+#include "query.h"
+#include "uarttx.h"
+#include "uartbaud.h"
+#include "usbcdc.h"
+#include "telemetry.h"
 #include <stdio.h>
 #include "tds.h"
 #include "turbidity.h"
@@ -48,6 +57,11 @@
 /* 浊度百分比映射上限（TU 对应 100%），可根据标定调整 */
 #define TURB_MAX_TU   3000.0f
 
+/* 运行参数默认值，运行时可用串口命令修改（#RATE / #CAL TURB，见 cmd.h） */
+#define APP_SAMPLE_PERIOD_MS  1000U   /* 采样周期 */
+#define APP_LOG_EVERY         5U      /* 每几次采样向 SD 卡记一条 */
+#define APP_TURB_K            3200.0f /* 浊度标定截距 K */
+
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -71,10 +85,13 @@ void SystemClock_Config(void);
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
 
-/* 重定向 printf 到 USART1，方便串口调试 */
+/* 单个字符输出到 USART1 发送环形缓冲（DMA 后台发送），USB 虚拟串口打开时同时输出一份。
+ * printf 走 syscalls.c 的 _write，整段写入，不经过这里 */
 int __io_putchar(int ch)
 {
-  HAL_UART_Transmit(&huart1, (uint8_t *)&ch, 1, HAL_MAX_DELAY);
+  uint8_t c = (uint8_t)ch;
+  UartTx_Write(&c, 1);
+  USB_CDC_Write(&c, 1);
   return ch;
 }
 
@@ -91,6 +108,11 @@ typedef struct
 static SensorData_t g_sensorData;
 static uint32_t g_sdLogCounter = 0;
 
+/* 运行参数，由命令处理（主循环里）修改，下一个周期生效 */
+static uint32_t g_samplePeriodMs = APP_SAMPLE_PERIOD_MS;
+static uint16_t g_logEvery = APP_LOG_EVERY;
+static float g_turbK = APP_TURB_K;
+
 /**
  * @brief  读取所有传感器数据
  * @param  data  输出结构体指针
@@ -185,11 +207,13 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_ADC1_Init();
   MX_USART1_UART_Init();
   MX_I2C1_Init();
   MX_SPI1_Init();
   MX_FATFS_Init();
+  MX_USB_PCD_Init();
   /* USER CODE BEGIN 2 */
   /* 初始化 OLED 显示屏（I2C 接 I2C1） */
   OLED_Init();
@@ -203,18 +227,23 @@ int main(void)
     OLED_PrintLarge(0, 0, "TEMP ERR");
   }
 
-  /* 浊度公式：TU = -865.68 * U25 + K
-   * 其中 K 为你实测标定得到的截距，这里先给一个默认值。
-   * 后续你做浊度标定实验时，可以把拟合出来的 K 写到这里。*/
-  float K = 3200.0f;
-
   /* 初始化 SD 卡与文件系统（FatFs）并打开数据日志文件 */
   int sd_ok = SD_Card_Init();
   if (sd_ok != 0)
   {
-    /* 若 SD 卡初始化失败，不影响主功能，仅在屏幕上提示 */
+    /* 若 SD 卡初始化失败，不影响主功能，仅在屏幕上提示；
+     * 打开了 SD_FLASH_FALLBACK 时记录暂存到片内 Flash，插上卡后自动转存（见 sdcard.h） */
     OLED_PrintLarge(0, 6, "SD ERR");
   }
+
+  /* 接上 USB（虚拟串口 /dev/ttyACM0），和 USART1 收发同样的命令和数据 */
+  USB_CDC_Init();
+
+  /* 遥测通道表，上位机据此解码之后的二进制帧 */
+  Telemetry_Init();
+
+  /* 开始接收上位机串口命令（校时、查询历史记录） */
+  Cmd_Init();
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -224,13 +253,16 @@ int main(void)
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
-    /* 周期性任务：采集 -> 显示 -> 通过串口发送一帧数据给上位机 */
-    App_ReadSensors(&g_sensorData, K);
+    /* 周期性任务：采集 -> 显示 -> 通过串口发送一帧数据给上位机
+     * 周期从采集开始计时，采集、显示和写卡的耗时都算在一个周期之内 */
+    uint32_t tickStart = HAL_GetTick();
+    App_ReadSensors(&g_sensorData, g_turbK);
     App_UpdateDisplay(&g_sensorData);
 
-    /* 每 5 秒向 SD 卡追加一帧数据 */
+    /* 每 g_logEvery 次采样（默认 5 秒）向 SD 卡追加一帧数据（只入队，写卡在下面的 SD_Card_Poll 里），
+     * g_logEvery 为 0 时暂停记录 */
     g_sdLogCounter++;
-    if (g_sdLogCounter >= 5)
+    if (g_logEvery != 0U && g_sdLogCounter >= g_logEvery)
     {
       SD_Card_Log(g_sensorData.ph,
                   g_sensorData.tds_ppm,
@@ -239,21 +271,36 @@ int main(void)
       g_sdLogCounter = 0;
     }
 
-    /* 串口统一输出一帧数据（方便 Python / PyQt5 上位机解析）：
-     * 形如：
-     *   PH=7.02;TEMP=25.3;TU=123.4;TDS=250\r\n
-     * 你在上位机只需按 ';' 分割，再按 '=' 取值即可。
+    /* 串口统一输出一帧数据给 Python / PyQt5 上位机：
+     * 默认为带序号、时间戳和 CRC 的二进制帧，上位机按通道表解码（见 telemetry.h / telemetry.py）；
+     * 串口助手调试时发 "#TLM TEXT" 改为文字行：
+     *   PH=7.02;TEMP=25.30;TDS=250;TURB=123.4\r\n
      */
-    printf("PH=%.2f;TEMP=%.2f;TU=%.2f;TDS=%.0f\r\n",
-           (double)g_sensorData.ph,
-           (double)g_sensorData.temp_c,
-           (double)g_sensorData.turbidity,
-           (double)g_sensorData.tds_ppm);
-
-    /* 采样周期：1 秒
+    if (!Query_IsActive())
+    {
+      float values[TELEM_CHANNELS];
+      values[TELEM_CH_PH] = g_sensorData.ph;
+      values[TELEM_CH_TEMP] = g_sensorData.temp_c;
+      values[TELEM_CH_TDS] = g_sensorData.tds_ppm;
+      values[TELEM_CH_TURB] = g_sensorData.turbidity;
+      Telemetry_Send(values);
+    }
+
+    /* 采样周期：默认 1 秒，"#RATE" 命令可改
      * 若以后需要更高实时性（例如 5Hz），可以把这个改小，
-     * 或者用定时器中断/RTOS 来做，这在论文中也可以写成“改进方向”。 */
-    HAL_Delay(1000);
+     * 或者用定时器中断/RTOS 来做，这在论文中也可以写成“改进方向”。
+     * 等待期间处理串口命令、历史记录回传、SD 卡写入、测速和同步策略，并把显存变化分批发给 OLED，
+     * 其余时间 WFI 休眠到下一个中断（SysTick / 串口 DMA / USB / I2C）。 */
+    while ((HAL_GetTick() - tickStart) < g_samplePeriodMs)
+    {
+      OLED_Poll();
+      Cmd_Poll();
+      UartBaud_Poll();
+      Query_Poll();
+      SD_Card_Poll();
+      SD_Bench_Poll();
+      __WFI();
+    }
   }
   /* USER CODE END 3 */
 }
@@ -296,8 +343,9 @@ void SystemClock_Config(void)
   {
     Error_Handler();
   }
-  PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_ADC;
+  PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_ADC|RCC_PERIPHCLK_USB;
   PeriphClkInit.AdcClockSelection = RCC_ADCPCLK2_DIV6;
+  PeriphClkInit.UsbClockSelection = RCC_USBCLKSOURCE_PLL_DIV1_5;
   if (HAL_RCCEx_PeriphCLKConfig(&PeriphClkInit) != HAL_OK)
   {
     Error_Handler();
@@ -306,6 +354,32 @@ void SystemClock_Config(void)
 
 /* USER CODE BEGIN 4 */
 
+void App_SetSampling(uint32_t period_ms, uint16_t log_every)
+{
+  g_samplePeriodMs = period_ms;
+  g_logEvery = log_every;
+  g_sdLogCounter = 0;
+}
+
+void App_GetSampling(uint32_t *period_ms, uint16_t *log_every)
+{
+  *period_ms = g_samplePeriodMs;
+  *log_every = g_logEvery;
+}
+
+/* 浊度公式：TU = -865.68 * U25 + K
+ * 其中 K 为你实测标定得到的截距，默认值见 APP_TURB_K。
+ * 做浊度标定实验时，可以用 "#CAL TURB <K>" 把拟合出来的 K 写进来。*/
+void App_SetTurbidityK(float k)
+{
+  g_turbK = k;
+}
+
+float App_GetTurbidityK(void)
+{
+  return g_turbK;
+}
+
 /* USER CODE END 4 */
 
 /**
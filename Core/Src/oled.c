@@ -1,17 +1,20 @@
 /*
  * OLED 显示驱动（SSD1306 协议兼容）
  * - 接口：I2C1，SCL = PB8, SDA = PB9（见 i2c.c）
+ * - 画图函数只改 RAM 里的显存，主循环里 OLED_Poll() 把改过的列以 I2C_PRIO_DISPLAY
+ *   分批提交到 I2C1 事务队列，队列满（只剩留给传感器的槽位）时留到下次，从不等待；
+ *   总线上有传感器事务时显示数据自动让路
  * - OLED_Init()     初始化并清屏
+ * - OLED_Poll()     主循环里反复调用，发送初始化命令和显存变化
  * - OLED_Clear()    全屏清零
  * - OLED_Print()    正常 1x 字符显示
  * - OLED_PrintLarge() 放大 2x 字符显示（用于标题/数值）
  */
 
 #include "oled.h"
+#include "i2c.h"
 #include <string.h>
 
-extern I2C_HandleTypeDef hi2c1;
-
 #define OLED_I2C_ADDR    (0x3C << 1) // 常见0x3C地址，若不同请改
 #define OLED_WIDTH       128
 #define OLED_PAGES       8
@@ -66,38 +69,130 @@ static const Glyph5x7 *GlyphFind(char c)
     return &s_font[0]; // 空格
 }
 
-static HAL_StatusTypeDef OLED_WriteCommand(uint8_t cmd)
+// 显存：每页 128 列，每列一个字节（8 行像素）。画图只改显存，OLED_Poll 把改过的列发出去
+static uint8_t s_fb[OLED_PAGES][OLED_WIDTH];
+static uint8_t s_dirtyLo[OLED_PAGES];   // 每页待发送的列范围 [lo, hi)，lo >= hi 表示没有
+static uint8_t s_dirtyHi[OLED_PAGES];
+
+// 初始化命令，由 OLED_Poll 分批发出（控制字节 0x00 后跟连续命令）
+static const uint8_t s_initCmds[] = {
+    0xAE,
+    0x20, 0x02, // page addressing
+    0x81, 0x7F, // contrast
+    0xA1,       // segment remap
+    0xC8,       // COM scan direction
+    0xA6,       // normal display
+    0xA8, 0x3F, // multiplex ratio 1/64
+    0xD3, 0x00, // display offset
+    0xD5, 0x80, // clock divide
+    0xD9, 0xF1, // pre-charge
+    0xDA, 0x12, // COM pins
+    0xDB, 0x40, // VCOMH deselect
+    0x8D, 0x14, // charge pump
+    0xAF,
+};
+
+#define OLED_PAGE_NONE   0xFFU
+
+static uint8_t s_initPos = sizeof(s_initCmds);  // 还没发出的初始化命令
+static uint8_t s_pushPage = OLED_PAGE_NONE;     // 正在发送的页
+static uint8_t s_pushCol = 0;
+static uint8_t s_pushEnd = 0;
+static uint8_t s_pushCursor = 0;                // 该页还没发定位命令
+
+// 写进显存，内容有变化的列并进该页的待发送范围
+static void OLED_Put(uint8_t column, uint8_t page, const uint8_t *data, size_t len)
 {
-    uint8_t buf[2] = {0x00, cmd};
-    return HAL_I2C_Master_Transmit(&hi2c1, OLED_I2C_ADDR, buf, 2, HAL_MAX_DELAY);
+    if (page >= OLED_PAGES || column >= OLED_WIDTH) return;
+    if (len > (size_t)(OLED_WIDTH - column)) len = OLED_WIDTH - column;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t col = (uint8_t)(column + i);
+        if (s_fb[page][col] == data[i]) continue;
+        s_fb[page][col] = data[i];
+        if (s_dirtyLo[page] >= s_dirtyHi[page])
+        {
+            s_dirtyLo[page] = col;
+            s_dirtyHi[page] = (uint8_t)(col + 1);
+        }
+        else
+        {
+            if (col < s_dirtyLo[page]) s_dirtyLo[page] = col;
+            if (col >= s_dirtyHi[page]) s_dirtyHi[page] = (uint8_t)(col + 1);
+        }
+    }
 }
 
-static HAL_StatusTypeDef OLED_WriteData(const uint8_t *data, size_t len)
+static void OLED_MarkAll(void)
 {
-    uint8_t tmp[17];
-    size_t offset = 0;
-    HAL_StatusTypeDef status = HAL_OK;
-
-    while (offset < len && status == HAL_OK)
+    for (uint8_t page = 0; page < OLED_PAGES; page++)
     {
-        size_t chunk = len - offset;
-        if (chunk > 16) chunk = 16;
-        tmp[0] = 0x40;
-        memcpy(&tmp[1], &data[offset], chunk);
-        status = HAL_I2C_Master_Transmit(&hi2c1, OLED_I2C_ADDR, tmp, chunk + 1, HAL_MAX_DELAY);
-        offset += chunk;
+        s_dirtyLo[page] = 0;
+        s_dirtyHi[page] = OLED_WIDTH;
     }
-    return status;
 }
 
-void OLED_SetCursor(uint8_t column, uint8_t page)
+// 提交到 I2C 队列，数据已拷贝，调用方缓冲可立即复用；队列满时返回 HAL_BUSY，由调用方下次再试
+static HAL_StatusTypeDef OLED_Submit(const uint8_t *buf, size_t len)
 {
-    if (column >= OLED_WIDTH) column = 0;
-    if (page >= OLED_PAGES) page = 0;
+    return I2C_Bus_Write(OLED_I2C_ADDR, I2C_PRIO_DISPLAY, buf, (uint16_t)len, NULL, NULL);
+}
 
-    OLED_WriteCommand(0xB0 | (page & 0x07));
-    OLED_WriteCommand(0x00 | (column & 0x0F));
-    OLED_WriteCommand(0x10 | (column >> 4));
+void OLED_Poll(void)
+{
+    uint8_t tmp[I2C_BUS_INLINE_MAX];
+
+    // 初始化命令没发完之前不发显存
+    while (s_initPos < sizeof(s_initCmds))
+    {
+        size_t chunk = sizeof(s_initCmds) - s_initPos;
+        if (chunk > sizeof(tmp) - 1) chunk = sizeof(tmp) - 1;
+        tmp[0] = 0x00;
+        memcpy(&tmp[1], &s_initCmds[s_initPos], chunk);
+        if (OLED_Submit(tmp, chunk + 1) == HAL_BUSY) return;
+        s_initPos += (uint8_t)chunk;
+    }
+
+    while (1)
+    {
+        if (s_pushPage == OLED_PAGE_NONE)
+        {
+            uint8_t page = 0;
+            while (page < OLED_PAGES && s_dirtyLo[page] >= s_dirtyHi[page]) page++;
+            if (page == OLED_PAGES) return;
+
+            // 先清掉待发送范围，发送期间再画的列会重新并进来，之后补发
+            s_pushPage = page;
+            s_pushCol = s_dirtyLo[page];
+            s_pushEnd = s_dirtyHi[page];
+            s_pushCursor = 1;
+            s_dirtyLo[page] = OLED_WIDTH;
+            s_dirtyHi[page] = 0;
+        }
+
+        if (s_pushCursor)
+        {
+            // 三条定位命令合并成一次事务
+            tmp[0] = 0x00;
+            tmp[1] = (uint8_t)(0xB0 | (s_pushPage & 0x07));
+            tmp[2] = (uint8_t)(0x00 | (s_pushCol & 0x0F));
+            tmp[3] = (uint8_t)(0x10 | (s_pushCol >> 4));
+            if (OLED_Submit(tmp, 4) == HAL_BUSY) return;
+            s_pushCursor = 0;
+        }
+
+        while (s_pushCol < s_pushEnd)
+        {
+            size_t chunk = s_pushEnd - s_pushCol;
+            if (chunk > sizeof(tmp) - 1) chunk = sizeof(tmp) - 1;
+            tmp[0] = 0x40;
+            memcpy(&tmp[1], &s_fb[s_pushPage][s_pushCol], chunk);
+            if (OLED_Submit(tmp, chunk + 1) == HAL_BUSY) return;
+            s_pushCol += (uint8_t)chunk;
+        }
+        s_pushPage = OLED_PAGE_NONE;
+    }
 }
 
 void OLED_Clear(void)
@@ -105,10 +200,9 @@ void OLED_Clear(void)
     uint8_t zeros[16] = {0};
     for (uint8_t page = 0; page < OLED_PAGES; page++)
     {
-        OLED_SetCursor(0, page);
         for (uint8_t col = 0; col < OLED_WIDTH; col += sizeof(zeros))
         {
-            OLED_WriteData(zeros, sizeof(zeros));
+            OLED_Put(col, page, zeros, sizeof(zeros));
         }
     }
 }
@@ -116,21 +210,13 @@ void OLED_Clear(void)
 void OLED_Init(void)
 {
     HAL_Delay(100);
-    OLED_WriteCommand(0xAE);
-    OLED_WriteCommand(0x20); OLED_WriteCommand(0x02); // page addressing
-    OLED_WriteCommand(0x81); OLED_WriteCommand(0x7F); // contrast
-    OLED_WriteCommand(0xA1); // segment remap
-    OLED_WriteCommand(0xC8); // COM scan direction
-    OLED_WriteCommand(0xA6); // normal display
-    OLED_WriteCommand(0xA8); OLED_WriteCommand(0x3F); // multiplex ratio 1/64
-    OLED_WriteCommand(0xD3); OLED_WriteCommand(0x00); // display offset
-    OLED_WriteCommand(0xD5); OLED_WriteCommand(0x80); // clock divide
-    OLED_WriteCommand(0xD9); OLED_WriteCommand(0xF1); // pre-charge
-    OLED_WriteCommand(0xDA); OLED_WriteCommand(0x12); // COM pins
-    OLED_WriteCommand(0xDB); OLED_WriteCommand(0x40); // VCOMH deselect
-    OLED_WriteCommand(0x8D); OLED_WriteCommand(0x14); // charge pump
-    OLED_WriteCommand(0xAF);
-    OLED_Clear();
+
+    // 屏上电后内容不确定，显存清零后整屏发一次
+    memset(s_fb, 0, sizeof(s_fb));
+    OLED_MarkAll();
+    s_pushPage = OLED_PAGE_NONE;
+    s_initPos = 0;
+    OLED_Poll();
 }
 
 static void OLED_DrawChar(uint8_t column, uint8_t page, char c)
@@ -151,8 +237,7 @@ static void OLED_DrawChar(uint8_t column, uint8_t page, char c)
         columns[col] = bits;
     }
 
-    OLED_SetCursor(column, page);
-    OLED_WriteData(columns, sizeof(columns)); // 最后一列是空列
+    OLED_Put(column, page, columns, sizeof(columns)); // 最后一列是空列
 }
 
 // 2x 放大：宽高各乘2，整体高度14行，占用2页
@@ -202,10 +287,8 @@ static void OLED_DrawChar2x(uint8_t column, uint8_t page, char c)
     top[idx] = top[idx + 1] = 0;
     bottom[idx] = bottom[idx + 1] = 0;
 
-    OLED_SetCursor(column, page);
-    OLED_WriteData(top, sizeof(top));
-    OLED_SetCursor(column, page + 1);
-    OLED_WriteData(bottom, sizeof(bottom));
+    OLED_Put(column, page, top, sizeof(top));
+    OLED_Put(column, page + 1, bottom, sizeof(bottom));
 }
 
 void OLED_Print(uint8_t column, uint8_t page, const char *text)
@@ -154,3 +154,10 @@ void PH_SetCalibration(float k, float b)
     s_ph_b = b;
     s_custom_cal = 1;
 }
+
+uint8_t PH_GetCalibration(float *k, float *b)
+{
+    *k = s_ph_k;
+    *b = s_ph_b;
+    return s_custom_cal;
+}
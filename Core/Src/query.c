@@ -0,0 +1,473 @@
+/*
+ * 历史记录回传模块实现
+ *
+ * 两个帧缓冲交替使用：一个由 DMA 往串口发送时，主循环从 SD 卡把下一扇区
+ * 读进另一个。115200 波特率发 514 字节约 45ms，而 SD 卡读一个扇区只要
+ * 1~2ms，所以串口几乎不停顿，整体速度由串口决定。经 USB 回传时发一帧不到 1ms，
+ * 速度由读卡决定。
+ *
+ * 批量下载（#DL）用同样的两个缓冲，每帧一个压缩块，出错重发按"回退 N 帧"：
+ * 收到 #NAK 或超时后等正在发的一帧发完，丢掉已读好的帧，游标用 SD_Card_SeekBlock
+ * 退回已确认处重新读。块编号只由起点和块数决定，不用缓存已发出的帧。
+ */
+
+#include "query.h"
+
+#include "crc16.h"
+#include "logrec.h"
+#include "sdcard.h"
+#include "uarttx.h"
+#include "usbcdc.h"
+#include <stdio.h>
+#include <string.h>
+
+#define QUERY_FRAME_HDR     2U
+#define QUERY_FRAME_MAX     (QUERY_FRAME_HDR + LOG_RECS_PER_SECTOR * LOG_RECORD_SIZE)
+
+/* 批量下载帧：0xA6, 类型, 编号（u32）, [块], CRC16 */
+#define QUERY_BLOCK_HDR     6U
+#define QUERY_BLOCK_MAX     (QUERY_BLOCK_HDR + LOG_BLOCK_SIZE + 2U)
+
+/* 帧缓冲状态 */
+#define QBUF_EMPTY          0U
+#define QBUF_READY          1U
+#define QBUF_SENDING        2U
+
+/* 回传方式 */
+#define QUERY_MODE_RECORDS  0U      /* #Q，解压后的记录 */
+#define QUERY_MODE_BLOCKS   1U      /* #DL，原样的压缩块 */
+
+static uint8_t  s_buf[2][QUERY_BLOCK_MAX] __attribute__((aligned(4)));
+static uint16_t s_bufLen[2];
+static volatile uint8_t s_bufState[2];
+static uint8_t  s_fill = 0;     /* 下一个要读入的缓冲 */
+static uint8_t  s_send = 0;     /* 下一个要发送的缓冲 */
+
+static SD_LogCursor_t s_cur;
+static uint32_t s_to = 0;
+static uint32_t s_count = 0;
+static uint8_t  s_eof = 0;
+static uint8_t  s_active = 0;
+static uint8_t  s_mode = QUERY_MODE_RECORDS;
+static uint8_t  s_port = QUERY_PORT_UART;
+
+/* 批量下载 */
+static SD_LogCursor_t s_base;   /* 块编号的起点 */
+static uint32_t s_startIdx = 0; /* 本次下载的起始块编号 */
+static uint32_t s_nextIdx = 0;  /* 下一个要读入缓冲的帧的编号 */
+static uint32_t s_ackIdx = 0;   /* 上位机确认收到的帧之后的编号 */
+static uint32_t s_ackTick = 0;
+static uint8_t  s_retries = 0;
+static uint8_t  s_noData = 0;   /* 起始时间之后没有日志 */
+static uint8_t  s_sendHdr = 0;  /* 下一帧先发文件头 */
+static uint8_t  s_rewind = 0;   /* 等正在发的帧发完后从 s_ackIdx 重发 */
+static uint8_t  s_fail = 0;
+static uint8_t  s_stop = 0;
+
+/* 一帧发完（中断里调用） */
+static void Query_TxDone(void)
+{
+    if (s_bufState[s_send] == QBUF_SENDING)
+    {
+        s_bufState[s_send] = QBUF_EMPTY;
+        s_send ^= 1U;
+    }
+}
+
+void UartTx_TxCpltCallback(void)
+{
+    if (s_port == QUERY_PORT_UART)
+    {
+        Query_TxDone();
+    }
+}
+
+void USB_CDC_TxCpltCallback(void)
+{
+    if (s_port == QUERY_PORT_USB)
+    {
+        Query_TxDone();
+    }
+}
+
+/* 回传端口上没有数据在发 */
+static uint8_t Query_PortIdle(void)
+{
+    if (s_port == QUERY_PORT_USB)
+    {
+        return USB_CDC_TxBusy() ? 0U : 1U;
+    }
+    return UartTx_Busy() ? 0U : 1U;
+}
+
+/* 从 SD 卡读一帧到 s_fill 缓冲，遇到时间晚于 s_to 的记录即结束 */
+static void Query_Fill(void)
+{
+    uint8_t *frame = s_buf[s_fill];
+    int n = SD_Card_ReadNext(&s_cur, &frame[QUERY_FRAME_HDR],
+                             QUERY_FRAME_MAX - QUERY_FRAME_HDR);
+    if (n <= 0)
+    {
+        s_eof = 1;
+        return;
+    }
+
+    uint8_t recs = (uint8_t)((uint32_t)n / LOG_RECORD_SIZE);
+    for (uint8_t i = 0; i < recs; i++)
+    {
+        const LogRecord_t *rec = (const LogRecord_t *)&frame[QUERY_FRAME_HDR + i * LOG_RECORD_SIZE];
+        if (rec->ts > s_to)
+        {
+            recs = i;
+            s_eof = 1;
+            break;
+        }
+    }
+    if (recs == 0U)
+    {
+        return;
+    }
+
+    frame[0] = QUERY_FRAME_MAGIC;
+    frame[1] = recs;
+    s_bufLen[s_fill] = (uint16_t)(QUERY_FRAME_HDR + recs * LOG_RECORD_SIZE);
+    s_bufState[s_fill] = QBUF_READY;
+    s_fill ^= 1U;
+    s_count += recs;
+}
+
+/* 发送缓冲已就绪且端口空闲时启动 DMA（或 USB）发送，不拷贝 */
+static void Query_Send(void)
+{
+    if (s_bufState[s_send] != QBUF_READY || !Query_PortIdle())
+    {
+        return;
+    }
+
+    s_bufState[s_send] = QBUF_SENDING;
+    int ret = (s_port == QUERY_PORT_USB) ? USB_CDC_Send(s_buf[s_send], s_bufLen[s_send])
+                                         : UartTx_Send(s_buf[s_send], s_bufLen[s_send]);
+    if (ret != 0)
+    {
+        s_bufState[s_send] = QBUF_READY;
+    }
+}
+
+/* 读一帧批量下载数据到 s_fill 缓冲：文件头、下一块，或读到末尾时的结束帧 */
+static void Query_FillBlock(void)
+{
+    uint8_t *frame = s_buf[s_fill];
+    uint32_t idx = s_nextIdx;
+    uint16_t len = QUERY_BLOCK_HDR;
+    uint8_t type;
+
+    if (s_sendHdr)
+    {
+        type = 'H';
+        idx = s_startIdx;
+        SD_Card_GetHeader(&frame[QUERY_BLOCK_HDR]);
+        len += LOG_BLOCK_SIZE;
+        s_sendHdr = 0;
+    }
+    else
+    {
+        if (s_nextIdx - s_ackIdx >= QUERY_WINDOW)
+        {
+            return;
+        }
+
+        int got = s_noData ? 0 : SD_Card_ReadRawBlock(&s_cur, &frame[QUERY_BLOCK_HDR]);
+        if (got < 0)
+        {
+            s_fail = 1;
+            return;
+        }
+
+        /* 块首条记录晚于结束时间就不用再发了；CRC 错的块时间不可信，照发 */
+        if (got == 1)
+        {
+            uint16_t crc;
+            uint32_t ts;
+            memcpy(&crc, &frame[QUERY_BLOCK_HDR + LOG_BLOCK_SIZE - 2U], sizeof(crc));
+            memcpy(&ts, &frame[QUERY_BLOCK_HDR], sizeof(ts));
+            if (crc == CRC16_Calc(&frame[QUERY_BLOCK_HDR], LOG_BLOCK_SIZE - 2U) && ts > s_to)
+            {
+                got = 0;
+            }
+        }
+
+        if (got == 1)
+        {
+            type = 'B';
+            len += LOG_BLOCK_SIZE;
+        }
+        else if (got == 2)
+        {
+            type = 'S';
+        }
+        else
+        {
+            type = 'E';
+            s_eof = 1;
+        }
+        s_nextIdx++;
+    }
+
+    frame[0] = QUERY_BLOCK_MAGIC;
+    frame[1] = type;
+    memcpy(&frame[2], &idx, sizeof(idx));
+    uint16_t crc = CRC16_Calc(&frame[1], len - 1U);
+    memcpy(&frame[len], &crc, sizeof(crc));
+    s_bufLen[s_fill] = (uint16_t)(len + 2U);
+    s_bufState[s_fill] = QBUF_READY;
+    s_fill ^= 1U;
+}
+
+/* 没有帧在发送时：丢掉已读好的帧，游标退回已确认处 */
+static void Query_Rewind(void)
+{
+    SD_LogCursor_t cur;
+
+    s_bufState[0] = QBUF_EMPTY;
+    s_bufState[1] = QBUF_EMPTY;
+    s_fill = 0;
+    s_send = 0;
+    s_rewind = 0;
+    s_ackTick = HAL_GetTick();
+    if (s_ackIdx == s_startIdx)
+    {
+        s_sendHdr = 1;
+    }
+
+    if (!s_noData && SD_Card_SeekBlock(&s_base, s_ackIdx, &cur) != s_ackIdx)
+    {
+        /* 要重发的块在裸分区里已被覆盖，编号接不上了，让上位机续传 */
+        s_fail = 1;
+        return;
+    }
+    s_cur = cur;
+    s_nextIdx = s_ackIdx;
+    s_eof = 0;
+}
+
+static void Query_PollBlocks(void)
+{
+    uint8_t idle = (s_bufState[0] != QBUF_SENDING && s_bufState[1] != QBUF_SENDING &&
+                    Query_PortIdle()) ? 1U : 0U;
+
+    if (!s_rewind && s_nextIdx != s_ackIdx &&
+        (HAL_GetTick() - s_ackTick) > QUERY_ACK_TIMEOUT_MS)
+    {
+        s_ackTick = HAL_GetTick();
+        if (++s_retries > QUERY_RETRY_MAX)
+        {
+            s_fail = 1;
+        }
+        else
+        {
+            s_rewind = 1;
+        }
+    }
+
+    if (s_fail || s_stop || (s_eof && s_ackIdx == s_nextIdx))
+    {
+        if (idle)
+        {
+            s_bufState[0] = QBUF_EMPTY;
+            s_bufState[1] = QBUF_EMPTY;
+            s_active = 0;
+            if (s_fail)
+            {
+                printf("#ERR DL %lu\r\n", (unsigned long)s_ackIdx);
+            }
+            else if (s_stop)
+            {
+                printf("#OK STOP %lu\r\n", (unsigned long)s_ackIdx);
+            }
+            else
+            {
+                printf("#END %lu\r\n", (unsigned long)(s_nextIdx - 1U));
+            }
+        }
+        return;
+    }
+
+    if (s_rewind)
+    {
+        if (idle)
+        {
+            Query_Rewind();
+        }
+        return;
+    }
+
+    Query_Send();
+    if (!s_eof && s_bufState[s_fill] == QBUF_EMPTY)
+    {
+        Query_FillBlock();
+        Query_Send();
+    }
+}
+
+int Query_Start(uint8_t port, uint32_t from, uint32_t to)
+{
+    if (s_active || !SD_Card_IsOnline())
+    {
+        return -1;
+    }
+
+    /* 先把暂存区写出，让刚记录的数据也能查到 */
+    SD_Card_Sync();
+
+    s_eof = (SD_Card_Locate(from, &s_cur) != 0) ? 1U : 0U;
+    s_to = to;
+    s_count = 0;
+    s_fill = 0;
+    s_send = 0;
+    s_bufState[0] = QBUF_EMPTY;
+    s_bufState[1] = QBUF_EMPTY;
+    s_mode = QUERY_MODE_RECORDS;
+    s_port = port;
+    s_active = 1;
+
+    printf("#QBEGIN %lu %lu\r\n", (unsigned long)from, (unsigned long)to);
+    return 0;
+}
+
+int Query_StartBlocks(uint8_t port, uint32_t from, uint32_t to, uint8_t resume, uint32_t index)
+{
+    if (s_active || !SD_Card_IsOnline())
+    {
+        return -1;
+    }
+
+    /* 同 Query_Start：最后一块写出到卡上 */
+    SD_Card_Sync();
+
+    s_noData = (SD_Card_Locate(from, &s_base) != 0) ? 1U : 0U;
+    if (s_noData)
+    {
+        s_startIdx = resume ? index : 0U;
+    }
+    else
+    {
+        /* 默认从起始时间所在块开始：文件模式下它就是编号 0，裸分区为它的块序号 */
+        s_startIdx = SD_Card_SeekBlock(&s_base, resume ? index : (SD_LOG_RAW ? s_base.offset : 0U), &s_cur);
+    }
+    s_to = to;
+    s_nextIdx = s_startIdx;
+    s_ackIdx = s_startIdx;
+    s_ackTick = HAL_GetTick();
+    s_retries = 0;
+    s_sendHdr = 1;
+    s_rewind = 0;
+    s_fail = 0;
+    s_stop = 0;
+    s_eof = 0;
+    s_fill = 0;
+    s_send = 0;
+    s_bufState[0] = QBUF_EMPTY;
+    s_bufState[1] = QBUF_EMPTY;
+    s_mode = QUERY_MODE_BLOCKS;
+    s_port = port;
+    s_active = 1;
+
+    printf("#DLBEGIN %lu %lu %lu\r\n", (unsigned long)from, (unsigned long)to, (unsigned long)s_startIdx);
+    return 0;
+}
+
+void Query_Ack(uint32_t n)
+{
+    if (!s_active || s_mode != QUERY_MODE_BLOCKS)
+    {
+        return;
+    }
+    if (n > s_ackIdx && n <= s_nextIdx)
+    {
+        s_ackIdx = n;
+        s_ackTick = HAL_GetTick();
+        s_retries = 0;
+    }
+}
+
+void Query_Nak(uint32_t n)
+{
+    if (!s_active || s_mode != QUERY_MODE_BLOCKS)
+    {
+        return;
+    }
+    /* 上位机没收到文件头：从第一块重发，先补发文件头 */
+    uint8_t hdr = 0;
+    if (n < s_startIdx)
+    {
+        n = s_startIdx;
+        hdr = 1;
+    }
+    if (n < s_ackIdx || n > s_nextIdx)
+    {
+        return;
+    }
+    s_ackIdx = n;
+    s_rewind = 1;
+    if (hdr)
+    {
+        s_sendHdr = 1;
+    }
+}
+
+void Query_Stop(void)
+{
+    if (s_active && s_mode == QUERY_MODE_BLOCKS)
+    {
+        s_stop = 1;
+    }
+}
+
+void Query_Poll(void)
+{
+    if (!s_active)
+    {
+        return;
+    }
+    if (s_port == QUERY_PORT_USB && !USB_CDC_IsOpen())
+    {
+        /* 上位机关了 USB 端口（没发出的帧已被 usbcdc.c 丢弃），没人接收了，直接结束 */
+        s_bufState[0] = QBUF_EMPTY;
+        s_bufState[1] = QBUF_EMPTY;
+        s_active = 0;
+        return;
+    }
+    if (s_mode == QUERY_MODE_BLOCKS)
+    {
+        Query_PollBlocks();
+        return;
+    }
+
+    /* 先让串口动起来，再利用发送时间读下一扇区 */
+    Query_Send();
+    if (!s_eof && s_bufState[s_fill] == QBUF_EMPTY)
+    {
+        Query_Fill();
+        Query_Send();
+    }
+
+    if (s_eof && s_bufState[0] == QBUF_EMPTY && s_bufState[1] == QBUF_EMPTY && Query_PortIdle())
+    {
+        static const uint8_t endFrame[QUERY_FRAME_HDR] = { QUERY_FRAME_MAGIC, 0 };
+        if (s_port == QUERY_PORT_USB)
+        {
+            USB_CDC_Write(endFrame, sizeof(endFrame));
+        }
+        else
+        {
+            UartTx_Write(endFrame, sizeof(endFrame));
+        }
+        s_active = 0;
+        printf("#END %lu\r\n", (unsigned long)s_count);
+    }
+}
+
+uint8_t Query_IsActive(void)
+{
+    return s_active;
+}
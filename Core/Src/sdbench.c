@@ -0,0 +1,297 @@
+/*
+ * SD 卡读写测速模块实现
+ * - 先顺序写满测速区（单块写前半、多块写后半），再顺序读回校验，最后随机单块读写
+ * - 按测试项分步执行：SD_Bench_Poll 每次最多做 SD_BENCH_STEP_MS 毫秒，做完一项打印一项，
+ *   两次调用之间主循环照常采样、写日志。测速区是临时文件自己的簇，和日志文件互不重叠
+ * - 每个扇区的内容由扇区号生成，读回时只需检查首尾几个字节即可发现错位或数据损坏
+ * - 计时用 DWT->CYCCNT，72MHz 下 59 秒回绕一次，单次调用远小于此，差值不会出错
+ */
+
+#include "sdbench.h"
+
+#include "diskio.h"
+#include "fatfs.h"
+#include "sdcard.h"
+#include "user_diskio.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_SECTOR_SIZE   512U
+
+typedef enum
+{
+    SD_BENCH_IDLE = 0,
+    SD_BENCH_SEQ_W1,        /* 前半区顺序单块写 */
+    SD_BENCH_SEQ_WN,        /* 后半区顺序多块写 */
+    SD_BENCH_SEQ_R1,
+    SD_BENCH_SEQ_RN,
+    SD_BENCH_RND_R1,        /* 全区随机单块读 */
+    SD_BENCH_RND_W1,
+} SD_BenchPhase_t;
+
+/* 与 SD_BenchPhase_t 一一对应 */
+static const char *const s_phaseName[] =
+{
+    "", "SEQ_W1", "SEQ_WN", "SEQ_R1", "SEQ_RN", "RND_R1", "RND_W1",
+};
+
+typedef struct
+{
+    uint32_t ops;
+    uint32_t sectors;
+    uint32_t errors;
+    uint32_t max_us;
+    uint64_t total_cycles;
+    uint16_t hist[SD_BENCH_HIST_BINS];
+} SD_BenchStat_t;
+
+static uint8_t  s_buf[SD_BENCH_MULTI * BENCH_SECTOR_SIZE] __attribute__((aligned(4)));
+static SD_BenchStat_t s_stat;
+static uint32_t s_cyclesPerUs;
+static uint32_t s_rand;
+
+static SD_BenchPhase_t s_phase = SD_BENCH_IDLE;
+static uint32_t s_first;        /* 测速区第一个扇区（绝对扇区号） */
+static uint32_t s_count;
+static uint32_t s_half;
+static uint32_t s_pos;
+
+static void SD_Bench_TimerInit(void)
+{
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0U)
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+    s_cyclesPerUs = SystemCoreClock / 1000000U;
+}
+
+/* 线性同余伪随机数，固定种子便于不同卡之间对比 */
+static uint32_t SD_Bench_Rand(void)
+{
+    s_rand = s_rand * 1664525U + 1013904223U;
+    return s_rand >> 8;
+}
+
+static void SD_Bench_Fill(uint8_t *p, uint32_t sector)
+{
+    memset(p, (uint8_t)sector, BENCH_SECTOR_SIZE);
+    memcpy(p, &sector, sizeof(sector));
+    p[BENCH_SECTOR_SIZE - 1U] = (uint8_t)~sector;
+}
+
+static uint8_t SD_Bench_Check(const uint8_t *p, uint32_t sector)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return (v == sector && p[4] == (uint8_t)sector
+            && p[BENCH_SECTOR_SIZE - 1U] == (uint8_t)~sector) ? 1U : 0U;
+}
+
+static void SD_Bench_Record(uint32_t cycles, uint32_t sectors, DRESULT res)
+{
+    uint32_t us = cycles / s_cyclesPerUs;
+    uint8_t  bin = 0;
+
+    /* 第 0 档 < 64us，之后每档翻倍，最后一档 >= 512ms */
+    while (bin < SD_BENCH_HIST_BINS - 1U && us >= (64UL << bin))
+    {
+        bin++;
+    }
+
+    s_stat.ops++;
+    s_stat.sectors += sectors;
+    s_stat.total_cycles += cycles;
+    s_stat.hist[bin]++;
+    if (us > s_stat.max_us)
+    {
+        s_stat.max_us = us;
+    }
+    if (res != RES_OK)
+    {
+        s_stat.errors++;
+    }
+}
+
+static DRESULT SD_Bench_Write(uint32_t sector, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        SD_Bench_Fill(&s_buf[i * BENCH_SECTOR_SIZE], sector + i);
+    }
+
+    /* 驱动写完数据就返回，卡在后台编程；CTRL_SYNC 等编程结束，计时包含整个写入过程 */
+    uint32_t t0 = DWT->CYCCNT;
+    DRESULT res = disk_write(USERFatFS.drv, s_buf, sector, n);
+    if (res == RES_OK)
+    {
+        res = disk_ioctl(USERFatFS.drv, CTRL_SYNC, NULL);
+    }
+    SD_Bench_Record(DWT->CYCCNT - t0, n, res);
+    return res;
+}
+
+static DRESULT SD_Bench_Read(uint32_t sector, uint32_t n)
+{
+    memset(s_buf, 0, n * BENCH_SECTOR_SIZE);
+
+    uint32_t t0 = DWT->CYCCNT;
+    DRESULT res = disk_read(USERFatFS.drv, s_buf, sector, n);
+    SD_Bench_Record(DWT->CYCCNT - t0, n, res);
+
+    for (uint32_t i = 0; res == RES_OK && i < n; i++)
+    {
+        if (!SD_Bench_Check(&s_buf[i * BENCH_SECTOR_SIZE], sector + i))
+        {
+            s_stat.errors++;
+            break;
+        }
+    }
+    return res;
+}
+
+static void SD_Bench_Report(const char *name)
+{
+    uint32_t total_us = (uint32_t)(s_stat.total_cycles / s_cyclesPerUs);
+    uint32_t kbps = (total_us != 0U)
+                    ? (uint32_t)((uint64_t)s_stat.sectors * BENCH_SECTOR_SIZE * 1000000ULL
+                                 / 1024U / total_us)
+                    : 0U;
+    uint32_t avg = (s_stat.ops != 0U) ? total_us / s_stat.ops : 0U;
+
+    printf("#BENCH %s ops=%lu kbps=%lu avg=%lu max=%lu err=%lu\r\n", name,
+           (unsigned long)s_stat.ops, (unsigned long)kbps, (unsigned long)avg,
+           (unsigned long)s_stat.max_us, (unsigned long)s_stat.errors);
+
+    printf("#HIST %s ", name);
+    for (uint8_t i = 0; i < SD_BENCH_HIST_BINS; i++)
+    {
+        printf(i == 0U ? "%u" : ",%u", s_stat.hist[i]);
+    }
+    printf("\r\n");
+
+    memset(&s_stat, 0, sizeof(s_stat));
+}
+
+/* 进入下一项测试，s_pos 为该项第一个扇区（相对测速区起点）或已做的次数 */
+static void SD_Bench_Next(SD_BenchPhase_t phase)
+{
+    s_phase = phase;
+    s_pos = (phase == SD_BENCH_SEQ_WN || phase == SD_BENCH_SEQ_RN) ? s_half : 0U;
+}
+
+/* 当前测试项做一次读写，返回 1 表示这一项做完了 */
+static uint8_t SD_Bench_Step(void)
+{
+    switch (s_phase)
+    {
+        case SD_BENCH_SEQ_W1:
+            SD_Bench_Write(s_first + s_pos, 1U);
+            s_pos++;
+            return (s_pos >= s_half) ? 1U : 0U;
+
+        case SD_BENCH_SEQ_WN:
+            SD_Bench_Write(s_first + s_pos, SD_BENCH_MULTI);
+            s_pos += SD_BENCH_MULTI;
+            return (s_pos >= s_count) ? 1U : 0U;
+
+        case SD_BENCH_SEQ_R1:
+            SD_Bench_Read(s_first + s_pos, 1U);
+            s_pos++;
+            return (s_pos >= s_half) ? 1U : 0U;
+
+        case SD_BENCH_SEQ_RN:
+            SD_Bench_Read(s_first + s_pos, SD_BENCH_MULTI);
+            s_pos += SD_BENCH_MULTI;
+            return (s_pos >= s_count) ? 1U : 0U;
+
+        case SD_BENCH_RND_R1:
+            SD_Bench_Read(s_first + SD_Bench_Rand() % s_count, 1U);
+            s_pos++;
+            return (s_pos >= SD_BENCH_RANDOM_OPS) ? 1U : 0U;
+
+        case SD_BENCH_RND_W1:
+            SD_Bench_Write(s_first + SD_Bench_Rand() % s_count, 1U);
+            s_pos++;
+            return (s_pos >= SD_BENCH_RANDOM_OPS) ? 1U : 0U;
+
+        default:
+            return 1U;
+    }
+}
+
+int SD_Bench_Start(void)
+{
+    uint32_t first, count;
+    int ret;
+
+    if (s_phase != SD_BENCH_IDLE)
+    {
+        printf("#ERR BENCH BUSY\r\n");
+        return -1;
+    }
+
+    ret = SD_Card_ScratchOpen(SD_BENCH_AREA_SECTORS, &first, &count);
+    if (ret != 0)
+    {
+        printf("#ERR BENCH %d\r\n", ret);
+        return ret;
+    }
+
+    /* 区域按多块大小对齐，前后两半分别给单块、多块顺序测试 */
+    count -= count % (SD_BENCH_MULTI * 2U);
+    if (count == 0U)
+    {
+        SD_Card_ScratchClose();
+        printf("#ERR BENCH area\r\n");
+        return -1;
+    }
+
+    SD_Bench_TimerInit();
+    memset(&s_stat, 0, sizeof(s_stat));
+    s_rand = 12345U;
+    s_first = first;
+    s_count = count;
+    s_half = count / 2U;
+    printf("#BENCH BEGIN %lu %lu\r\n", (unsigned long)first, (unsigned long)count);
+
+    SD_Bench_Next(SD_BENCH_SEQ_W1);
+    return 0;
+}
+
+void SD_Bench_Poll(void)
+{
+    uint32_t tickStart = HAL_GetTick();
+
+    /* 卡还在编程日志刚写的扇区：等它结束再测，不把这段时间算进测速 */
+    if (s_phase == SD_BENCH_IDLE || USER_IsBusy())
+    {
+        return;
+    }
+
+    while (s_phase != SD_BENCH_IDLE)
+    {
+        if (SD_Bench_Step())
+        {
+            SD_Bench_Report(s_phaseName[s_phase]);
+            if (s_phase == SD_BENCH_RND_W1)
+            {
+                SD_Card_ScratchClose();
+                printf("#BENCH END\r\n");
+                s_phase = SD_BENCH_IDLE;
+                return;
+            }
+            SD_Bench_Next((SD_BenchPhase_t)(s_phase + 1));
+        }
+        if ((HAL_GetTick() - tickStart) >= SD_BENCH_STEP_MS)
+        {
+            return;
+        }
+    }
+}
+
+uint8_t SD_Bench_Active(void)
+{
+    return (s_phase != SD_BENCH_IDLE) ? 1U : 0U;
+}
@@ -0,0 +1,237 @@
+/*
+ * SD 卡元数据扇区写回缓存实现
+ * - 槽位很少，查找、淘汰、排序都直接线性扫描
+ * - s_tick 每次访问加一，槽位记录最近一次访问的值，最小的就是最久没用的
+ */
+
+#include "sdcache.h"
+
+#include "fatfs.h"
+#include <string.h>
+
+#define SD_CACHE_SECTOR_SIZE    512U
+
+typedef struct
+{
+    DWORD    sector;
+    uint32_t used;          /* 最近一次访问时的 s_tick */
+    uint8_t  valid;
+    uint8_t  dirty;
+    uint8_t  data[SD_CACHE_SECTOR_SIZE] __attribute__((aligned(4)));
+} SD_CacheSlot_t;
+
+static SD_CacheSlot_t  s_slots[SD_CACHE_SLOTS];
+static SD_CacheRead_t  s_read = NULL;
+static SD_CacheWrite_t s_write = NULL;
+static uint32_t        s_tick = 0;
+static uint8_t         s_hold = 0;
+static SD_CacheStats_t s_stats;
+
+/* FAT 和目录扇区只经卷窗口读写，见 sdcache.h */
+static uint8_t SD_Cache_IsMeta(const BYTE *buff, UINT count)
+{
+    return (count == 1U && buff == USERFatFS.win.d8) ? 1U : 0U;
+}
+
+static SD_CacheSlot_t *SD_Cache_Find(DWORD sector)
+{
+    for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++)
+    {
+        if (s_slots[i].valid && s_slots[i].sector == sector)
+        {
+            return &s_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static DRESULT SD_Cache_WriteBack(SD_CacheSlot_t *slot)
+{
+    if (!slot->dirty)
+    {
+        return RES_OK;
+    }
+
+    DRESULT res = s_write(slot->data, slot->sector, 1U);
+    if (res == RES_OK)
+    {
+        slot->dirty = 0;
+        s_stats.written++;
+    }
+    return res;
+}
+
+/* 取一个空槽，没有空槽时淘汰最久没用的（脏的先写卡，写失败返回 NULL） */
+static SD_CacheSlot_t *SD_Cache_Alloc(DWORD sector)
+{
+    SD_CacheSlot_t *victim = &s_slots[0];
+
+    for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++)
+    {
+        if (!s_slots[i].valid)
+        {
+            victim = &s_slots[i];
+            break;
+        }
+        if (s_slots[i].used < victim->used)
+        {
+            victim = &s_slots[i];
+        }
+    }
+
+    if (victim->valid && SD_Cache_WriteBack(victim) != RES_OK)
+    {
+        return NULL;
+    }
+
+    victim->sector = sector;
+    victim->valid = 1;
+    victim->dirty = 0;
+    return victim;
+}
+
+void SD_Cache_Init(SD_CacheRead_t read, SD_CacheWrite_t write)
+{
+    /* 重新初始化一般是换了卡，旧卡的脏扇区不能写到新卡上 */
+    memset(s_slots, 0, sizeof(s_slots));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_read = read;
+    s_write = write;
+    s_tick = 0;
+    s_hold = 0;
+}
+
+DRESULT SD_Cache_Read(BYTE *buff, DWORD sector, UINT count)
+{
+    SD_CacheSlot_t *slot;
+    DRESULT res;
+
+    if (SD_Cache_IsMeta(buff, count))
+    {
+        slot = SD_Cache_Find(sector);
+        if (slot != NULL)
+        {
+            s_stats.hits++;
+        }
+        else
+        {
+            s_stats.misses++;
+            res = s_read(buff, sector, 1U);
+            if (res != RES_OK)
+            {
+                return res;
+            }
+            slot = SD_Cache_Alloc(sector);
+            if (slot == NULL)
+            {
+                return RES_OK;
+            }
+            memcpy(slot->data, buff, SD_CACHE_SECTOR_SIZE);
+        }
+        slot->used = ++s_tick;
+        memcpy(buff, slot->data, SD_CACHE_SECTOR_SIZE);
+        return RES_OK;
+    }
+
+    res = s_read(buff, sector, count);
+    if (res != RES_OK)
+    {
+        return res;
+    }
+
+    /* 读的范围里有缓存中还没写卡的扇区时，用缓存内容覆盖 */
+    for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++)
+    {
+        if (s_slots[i].dirty && s_slots[i].sector >= sector && s_slots[i].sector - sector < count)
+        {
+            memcpy(buff + (s_slots[i].sector - sector) * SD_CACHE_SECTOR_SIZE,
+                   s_slots[i].data, SD_CACHE_SECTOR_SIZE);
+        }
+    }
+    return RES_OK;
+}
+
+DRESULT SD_Cache_Write(const BYTE *buff, DWORD sector, UINT count)
+{
+    SD_CacheSlot_t *slot;
+
+    if (SD_Cache_IsMeta(buff, count))
+    {
+        slot = SD_Cache_Find(sector);
+        if (slot == NULL)
+        {
+            slot = SD_Cache_Alloc(sector);
+            if (slot == NULL)
+            {
+                return s_write(buff, sector, 1U);
+            }
+        }
+        memcpy(slot->data, buff, SD_CACHE_SECTOR_SIZE);
+        slot->dirty = 1;
+        slot->used = ++s_tick;
+        s_stats.absorbed++;
+        return RES_OK;
+    }
+
+    DRESULT res = s_write(buff, sector, count);
+    if (res != RES_OK)
+    {
+        return res;
+    }
+
+    /* 缓存中的扇区被直接写过：更新为卡上的新内容 */
+    for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++)
+    {
+        if (s_slots[i].valid && s_slots[i].sector >= sector && s_slots[i].sector - sector < count)
+        {
+            memcpy(s_slots[i].data, buff + (s_slots[i].sector - sector) * SD_CACHE_SECTOR_SIZE,
+                   SD_CACHE_SECTOR_SIZE);
+            s_slots[i].dirty = 0;
+        }
+    }
+    return RES_OK;
+}
+
+DRESULT SD_Cache_Sync(void)
+{
+    return s_hold ? RES_OK : SD_Cache_Flush();
+}
+
+void SD_Cache_Hold(void)
+{
+    s_hold = 1;
+}
+
+DRESULT SD_Cache_Flush(void)
+{
+    s_hold = 0;
+
+    /* 按扇区号从小到大写出：FAT 区在目录之前，中途掉电时不会出现目录指向未分配的簇 */
+    for (;;)
+    {
+        SD_CacheSlot_t *next = NULL;
+
+        for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++)
+        {
+            if (s_slots[i].dirty && (next == NULL || s_slots[i].sector < next->sector))
+            {
+                next = &s_slots[i];
+            }
+        }
+        if (next == NULL)
+        {
+            return RES_OK;
+        }
+
+        DRESULT res = SD_Cache_WriteBack(next);
+        if (res != RES_OK)
+        {
+            return res;
+        }
+    }
+}
+
+void SD_Cache_GetStats(SD_CacheStats_t *stats)
+{
+    *stats = s_stats;
+}
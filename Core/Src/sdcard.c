@@ -7,6 +7,63 @@
  *        - FATFS/Target/user_diskio.c
  *   2. main.c 里在 MX_FATFS_Init() 之后调用 SD_Card_Init()
  *   3. 每次采集到传感器数据后调用 SD_Card_Log() 追加记录
+ *   4. 主循环空闲时调用 SD_Card_Poll()，按同步策略刷盘
+ *
+ * 文件格式：
+ *   - LOG/YYMMDDNN.BIN，格式定义见 logrec.h，上位机用 log_decoder.py 解码成 CSV。
+ *   - 每条记录是 16 字节的定点 LogRecord_t，写卡前按扇区压缩（logblock.h）：
+ *     每扇区一块，块内只存相邻记录的差值，一条通常只占 1~4 字节。
+ *
+ * 写入方式：
+ *   - 采集和写卡分开：SD_Card_Log 只在 RAM 里生成记录放进队列（生产者），
+ *     SD_Card_Poll 在主循环空闲时取出记录写卡（消费者），每次最多写一个扇区。
+ *     写完一个扇区后卡内部编程期间 SD_Card_Poll 直接返回（USER_IsBusy），
+ *     不占用 CPU，也不影响采样周期。
+ *   - 记录编码进 RAM 里的块（暂存区），块满才 f_write 一次整扇区，
+ *     FatFs 直接写卡，不经过 FIL 内部缓冲。
+ *   - f_sync（会改写 FAT 和目录项）只在满足同步策略时执行：
+ *     每写满 N 个扇区、距上次同步超过 T 毫秒，或 PVD 检测到供电跌落。
+ *   - 同步时没写满的块也整扇区写出，但之后继续往这块里加记录，
+ *     下次写出时原地覆盖，所以同步频繁也不会浪费扇区、降低压缩率。
+ *   - FAT 和目录扇区经 sdcache.c 写回缓存，一次同步里数据文件和索引文件的
+ *     两次 f_sync 改的是同一个目录扇区，只写卡一次。
+ *
+ * 预分配：
+ *   - 文件按 SD_PREALLOC_BYTES（向上取整到擦除块）一次性扩展，簇链一次分配，
+ *     卡上空闲区连续时就是一段连续区域；扩展后立即 f_sync 固化 FAT 和文件大小。
+ *   - 扩展后建立簇链映射表（CLMT，_USE_FASTSEEK），之后追加写和随机读
+ *     都直接查表，不再沿 FAT 链查找，也不再逐簇分配。
+ *   - 因为文件大小是预分配大小，有效数据的末尾记在文件头 data_end 里，
+ *     每次同步时更新；上电时从 data_end 往后扫描 CRC 正确、序号接续的块，
+ *     把最后一次同步之后写入的数据也找回来，并接着往最后一块里追加。
+ *   - 预分配的簇里可能是旧数据，写块前先把后面 SD_CLEAN_AHEAD 个扇区清零（s_cleanEnd），
+ *     扫描遇到清过的扇区就停下，不会把旧日志里的块接到新数据后面。
+ *   - 关闭文件（轮转或 SD_Card_Deinit）时截掉未用的预分配空间。
+ *
+ * 轮转与索引：
+ *   - 每天一组文件，文件名为日期 + 两位分段号（LOG/25101800.BIN），
+ *     日期变化或单个文件超过 SD_ROTATE_BYTES 时换下一个文件。
+ *     时钟未校准时日期从 1970-01-01 算起。
+ *   - 每个数据文件旁有同名 .IDX 索引，每块存一项 {块首条时间戳, 块偏移}。
+ *     SD_Card_Locate 先按日期定位文件，再在索引里二分查找，最后在块内顺序解码。
+ *
+ * 裸分区模式（SD_LOG_RAW）：
+ *   - 压缩块不写文件，由 sdraw.c 按块序号写进裸分区的环形区，块尾带序号和格式化代号；
+ *     记录的编码、队列、分步同步和文件模式完全相同，只是同步只需写出块，没有文件头和 FAT。
+ *   - 查询按块序号二分查找，游标的 offset 为块序号，day / part 不用。
+ *
+ * 片内 Flash 后备（SD_FLASH_FALLBACK，flashlog.h）：
+ *   - 卡初始化失败或写卡出错时转入离线：队列里的记录改存进片内 Flash，
+ *     暂存块里还没写上卡的记录也一起转过去，之后每隔 SD_RETRY_MS 重新初始化卡。
+ *   - 卡恢复后 SD_Card_Poll 先把 Flash 里的块逐块转存到卡上（每块追加完立即同步，
+ *     同步成功才在 Flash 里作废），转存完才接着写队列，卡上的记录仍按时间排列。
+ *
+ * 复位保护（SD_JOURNAL，sdjournal.h）：
+ *   - 写上卡的块即使没有 f_sync，上电时也能由 FindEnd（裸分区为 SD_Raw_Open）找回；
+ *     复位会丢的只有队列和暂存块里还没写出的记录。SD_Card_Log 把每条记录同时记进
+ *     .noinit 段的日志，暂存块每次写上卡（或记录转进 Flash）后日志只留队列里的记录。
+ *   - 日志放满时 SD_Card_Poll 把没写满的块原地写一次，不做 f_sync。
+ *   - 第一次 SD_Card_Init 打开日志后重放日志里的记录并同步；离线或 Flash 里有积压时存进 Flash。
  *
  * 注意：
  *   - 这里仅负责文件层（FatFs），底层扇区读写需要你在
@@ -15,105 +72,2063 @@
 
 #include "sdcard.h"
 
+#include "crc16.h"
 #include "fatfs.h"
+#include "flashlog.h"
+#include "logblock.h"
+#include "logchan.h"
+#include "logrec.h"
+#include "sdcache.h"
+#include "sdjournal.h"
+#include "sdraw.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
-/* 日志文件句柄和状态标志 */
+#define SD_SECTOR_SIZE  512U
+#define SD_SEC_PER_DAY  86400UL
+#define SD_PART_MAX     99U
+#define SD_SCRATCH_PATH SD_LOG_DIR "/BENCH.TMP"
+
+/* 用大簇格式化时至少要有的簇数：FAT32 要求 65526 簇以上，再留出 FAT 和对齐占用的余量 */
+#define SD_FORMAT_MIN_CLUSTERS  70000UL
+
+/* 日志文件、索引文件句柄和状态标志（只读查询借用 fatfs.c 里的 USERFile） */
 static FIL   s_logFile;
+static FIL   s_idxFile;
 static uint8_t s_logOpened = 0;
 
-int SD_Card_Init(void)
+/* 当前文件的路径、日期（自 1970-01-01 起的天数）和分段号 */
+static char     s_logPath[SD_LOG_PATH_LEN];
+static char     s_idxPath[SD_LOG_PATH_LEN];
+static uint32_t s_fileDay = 0;
+static uint8_t  s_filePart = 0;
+
+/* USERFile 当前打开的只读文件，顺序读同一个文件时不必反复打开和沿 FAT 链定位 */
+static char     s_readPath[SD_LOG_PATH_LEN];
+static uint8_t  s_readOpened = 0;
+
+/* 卡的真实几何参数（由 user_diskio.c 从 CSD / SD Status 读出） */
+static uint32_t s_cardSectors = 0;
+static uint32_t s_eraseBlock = 1;
+
+/* 正在编码的压缩块，s_blockOfs 为它在文件中的偏移，s_enc.count 为 0 表示还没有开始 */
+static uint8_t  s_stage[SD_SECTOR_SIZE] __attribute__((aligned(4)));
+static LogBlock_t s_enc;
+static DWORD    s_blockOfs = LOG_HEADER_SIZE;
+static DWORD    s_dataEnd = LOG_HEADER_SIZE;    /* 卡上已写出的块的末尾 */
+static DWORD    s_cleanEnd = LOG_HEADER_SIZE;   /* 数据末尾之后到这里的扇区已清零 */
+static uint8_t  s_stageDirty = 0;               /* 块里有还没写卡的记录 */
+static uint16_t s_encWritten = 0;               /* 块里已经写上卡的记录条数 */
+
+/* 读块缓冲：查询时缓存最近读的一块（拼文件头时也借用，借用后缓存作废） */
+static uint8_t  s_readBlk[SD_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint32_t s_readBlkDay = 0;
+static uint8_t  s_readBlkPart = 0;
+static DWORD    s_readBlkOfs = 0;
+static uint8_t  s_readBlkValid = 0;
+
+/* 同步策略与统计 */
+static uint16_t s_syncEverySectors = SD_SYNC_EVERY_SECTORS;
+static uint32_t s_syncIntervalMs   = SD_SYNC_INTERVAL_MS;
+static uint16_t s_sectorsSinceSync = 0;
+static uint32_t s_lastSyncTick = 0;
+static volatile uint8_t s_powerFail = 0;
+
+/* SD_Card_Poll 里分步同步的进度，0 表示没有进行中的同步 */
+typedef enum
 {
-    FRESULT res;
+    SD_COMMIT_IDLE = 0,
+    SD_COMMIT_BLOCK,        /* 写出没写满的块 */
+    SD_COMMIT_HEADER,       /* 更新文件头 data_end */
+    SD_COMMIT_LOG,          /* f_sync 数据文件 */
+    SD_COMMIT_INDEX,        /* f_sync 索引文件 */
+} SD_CommitStep_t;
 
-    /* 挂载文件系统（逻辑盘路径由 CubeMX 在 fatfs.c 里生成） */
-    res = f_mount(&USERFatFS, USERPath, 1);
+static SD_CommitStep_t s_commitStep = SD_COMMIT_IDLE;
+
+/* 软件时钟：板上没有 RTC，由上位机校时后按 SysTick 走时 */
+static uint32_t s_clockSec = 0;
+static uint32_t s_clockMs = 0;
+static uint32_t s_clockLastTick = 0;
+static uint8_t  s_clockSet = 0;
+
+static uint8_t  s_recSeq = 0;
+
+_Static_assert((SD_QUEUE_RECORDS & (SD_QUEUE_RECORDS - 1U)) == 0U,
+               "SD_QUEUE_RECORDS must be a power of two");
+
+/* 采集端和写入端之间的记录队列，头尾为自由增长的计数，取模得到槽位 */
+static LogRecord_t s_queue[SD_QUEUE_RECORDS];
+static uint16_t s_queueHead = 0;
+static uint16_t s_queueTail = 0;
+static uint16_t s_queuePeak = 0;
+static uint32_t s_queueDropped = 0;
+
+/* 片内 Flash 后备日志（SD_FLASH_FALLBACK）：已扫描过 Flash，上次尝试初始化卡的时刻 */
+static uint8_t  s_flashReady = 0;
+static uint32_t s_retryTick = 0;
+
+/* 复位保护日志（SD_JOURNAL）已经重放过 */
+static uint8_t  s_journalReplayed = 0;
+
+/* 文件头里不变的字段，更新 data_end 时重新生成整个文件头 */
+static uint32_t s_hdrCreated = 0;
+static uint8_t  s_hdrFlags = 0;
+
+/* 簇链映射表：s_clmt[0] 为表长，之后每段连续簇占两项，最多 (SD_CLMT_ITEMS-2)/2 段 */
+static DWORD s_clmt[SD_CLMT_ITEMS];
+
+/* 为文件建立簇链映射表，表不够大（碎片太多）时退回普通模式 */
+static void SD_Card_MapClusters(void)
+{
+    s_clmt[0] = SD_CLMT_ITEMS;
+    s_logFile.cltbl = s_clmt;
+
+    FRESULT res = f_lseek(&s_logFile, CREATE_LINKMAP);
     if (res != FR_OK)
     {
-        printf("SD init: f_mount error=%d\r\n", res);
-        return res;
+        s_logFile.cltbl = NULL;
+        printf("SD log: fast seek off, res=%d, fragments=%lu\r\n",
+               res, (unsigned long)((s_clmt[0] - 2U) / 2U));
+    }
+    else if (s_clmt[0] > 4U)
+    {
+        printf("SD log: %s has %lu fragments\r\n",
+               s_logPath, (unsigned long)((s_clmt[0] - 2U) / 2U));
+    }
+}
+
+/*
+ * 把 s_cleanEnd 到 upto（不超过文件大小）之间的扇区清零，读块缓冲借来当零扇区。
+ * 文件指针不变
+ */
+static int SD_Card_Clean(DWORD upto)
+{
+    UINT bw = 0;
+    DWORD pos = f_tell(&s_logFile);
+    FRESULT res = FR_OK;
+
+    if (upto > f_size(&s_logFile))
+    {
+        upto = f_size(&s_logFile);
+    }
+    if (s_cleanEnd >= upto)
+    {
+        return 0;
     }
 
-    /* 打开/创建日志文件 data.csv（根目录） */
-    res = f_open(&s_logFile, "data.csv", FA_OPEN_ALWAYS | FA_WRITE);
+    memset(s_readBlk, 0, sizeof(s_readBlk));
+    s_readBlkValid = 0;
+    res = f_lseek(&s_logFile, s_cleanEnd);
+    while (res == FR_OK && s_cleanEnd < upto)
+    {
+        res = f_write(&s_logFile, s_readBlk, SD_SECTOR_SIZE, &bw);
+        if (res == FR_OK && bw != (UINT)SD_SECTOR_SIZE)
+        {
+            res = FR_DENIED;
+        }
+        if (res == FR_OK)
+        {
+            s_cleanEnd += SD_SECTOR_SIZE;
+        }
+    }
     if (res != FR_OK)
     {
-        printf("SD init: f_open error=%d\r\n", res);
-        return res;
+        printf("SD log: clean %lu error=%d\r\n", (unsigned long)s_cleanEnd, res);
+    }
+    FRESULT r = f_lseek(&s_logFile, pos);
+    return (res != FR_OK) ? (int)res : (int)r;
+}
+
+/* 保证文件已分配到 need 字节，不够时按预分配块整块扩展 */
+static int SD_Card_Extend(DWORD need)
+{
+    if (need <= f_size(&s_logFile))
+    {
+        return 0;
     }
 
-    /* 移到文件末尾，准备追加写入 */
-    res = f_lseek(&s_logFile, f_size(&s_logFile));
+    DWORD chunk = SD_PREALLOC_BYTES;
+    DWORD eb = s_eraseBlock * SD_SECTOR_SIZE;
+    if (eb > SD_SECTOR_SIZE && eb <= 0x1000000UL)
+    {
+        chunk = (chunk + eb - 1U) / eb * eb;
+    }
+    DWORD target = (need + chunk - 1U) / chunk * chunk;
+    if (target > SD_ROTATE_BYTES && need <= SD_ROTATE_BYTES)
+    {
+        target = SD_ROTATE_BYTES;   /* 文件到这个大小就轮转，不用多分配 */
+    }
+    DWORD pos = f_tell(&s_logFile);
+    DWORD old = f_size(&s_logFile);
+
+    /* 快速查找模式下 f_lseek 不能扩展文件，先关掉，扩展完再重建映射表 */
+    s_logFile.cltbl = NULL;
+    FRESULT res = f_lseek(&s_logFile, target);
+    if (res == FR_OK && f_size(&s_logFile) < need)
+    {
+        res = FR_DENIED;        /* 卡满 */
+    }
+    /* 数据写到了原来的文件末尾：新文件大小固化之前先清掉紧接着的几个扇区 */
+    if (res == FR_OK && s_cleanEnd >= old &&
+        SD_Card_Clean(s_cleanEnd + SD_CLEAN_AHEAD * SD_SECTOR_SIZE) != 0)
+    {
+        res = FR_DISK_ERR;
+    }
+    if (res == FR_OK)
+    {
+        res = f_sync(&s_logFile);
+    }
     if (res != FR_OK)
     {
-        f_close(&s_logFile);
-        printf("SD init: f_lseek error=%d\r\n", res);
+        printf("SD log: preallocate %lu error=%d\r\n", (unsigned long)target, res);
+        f_lseek(&s_logFile, pos);
         return res;
     }
 
-    s_logOpened = 1;
+    SD_Card_MapClusters();
+    return f_lseek(&s_logFile, pos);
+}
+
+/* 暂存块里的记录都已写上卡（或存进 Flash）：复位保护日志只留队列里还没取出的记录 */
+static void SD_Card_JournalRebase(void)
+{
+    if (!SD_JOURNAL)
+    {
+        return;
+    }
+
+    SD_Journal_Clear();
+    for (uint16_t i = s_queueTail; i != s_queueHead; i++)
+    {
+        SD_Journal_Add(&s_queue[i % SD_QUEUE_RECORDS]);
+    }
+}
+
+/*
+ * 把当前块写到 s_blockOfs 处。
+ * full 为 1 表示块已写满，之后换到下一个扇区开始新块；
+ * 否则（同步时块还没满）写完退回块起点，之后继续往块里加记录，下次同步原地重写。
+ */
+static int SD_Card_WriteBlock(uint8_t full)
+{
+    UINT bw = 0;
 
-    /* 如果是新建文件，可以写一行表头，方便后续在 Excel / Python 里分析 */
-    if (f_size(&s_logFile) == 0)
+    /* 裸分区：块尾写上序号，写满的块攒够一批再写卡（sdraw.h） */
+    if (SD_LOG_RAW)
     {
-        static const char header[] = "PH,TDS,TEMP,TURB\r\n";
-        UINT bw = 0;
-        res = f_write(&s_logFile, header, sizeof(header) - 1U, &bw);
-        if (res != FR_OK || bw != (UINT)(sizeof(header) - 1U))
+        SD_Raw_Stamp(s_stage);
+        LogBlock_Finish(&s_enc);
+        int ret = SD_Raw_Write(s_stage, full);
+        if (ret != 0)
         {
-            f_close(&s_logFile);
-            s_logOpened = 0;
-            printf("SD init: write header error=%d, bw=%u\r\n", res, bw);
-            return res ? res : -1;
+            return ret;
+        }
+        s_stageDirty = 0;
+        s_readBlkValid = 0;
+        s_encWritten = s_enc.count;
+        if (full)
+        {
+            s_sectorsSinceSync++;
+            s_enc.count = 0;
+            s_encWritten = 0;
+        }
+        if (SD_Raw_Batched() == 0U)
+        {
+            SD_Card_JournalRebase();
         }
-        f_sync(&s_logFile);
+        return 0;
     }
 
-    return 0;
+    int err = SD_Card_Extend(s_blockOfs + SD_SECTOR_SIZE);
+    if (err == 0 && s_cleanEnd < s_blockOfs + 2U * SD_SECTOR_SIZE)
+    {
+        /* 先清后面的扇区再写块，中途复位时这块之后也不会是旧数据 */
+        err = SD_Card_Clean(s_blockOfs + (1U + SD_CLEAN_AHEAD) * SD_SECTOR_SIZE);
+    }
+    if (err != 0)
+    {
+        return err;
+    }
+
+    LogBlock_Finish(&s_enc);
+    FRESULT res = f_write(&s_logFile, s_stage, SD_SECTOR_SIZE, &bw);
+    if (res != FR_OK || bw != (UINT)SD_SECTOR_SIZE)
+    {
+        printf("SD log: f_write error=%d, bw=%u\r\n", res, bw);
+        f_lseek(&s_logFile, s_blockOfs);
+        return res ? (int)res : -3;
+    }
+
+    s_stageDirty = 0;
+    s_readBlkValid = 0;
+    s_encWritten = s_enc.count;
+    SD_Card_JournalRebase();
+    if (s_blockOfs + SD_SECTOR_SIZE > s_dataEnd)
+    {
+        s_dataEnd = s_blockOfs + SD_SECTOR_SIZE;
+    }
+
+    if (full)
+    {
+        s_sectorsSinceSync++;
+        s_blockOfs += SD_SECTOR_SIZE;
+        s_enc.count = 0;
+        s_encWritten = 0;
+        return 0;
+    }
+    return f_lseek(&s_logFile, s_blockOfs);
 }
 
-int SD_Card_Log(float ph, float tds, float temp, float turb)
+/* 供电跌落检测：VDD 低于 2.9V 时 PVD 中断置位标志，由 SD_Card_Poll 尽快刷盘 */
+static void SD_Card_PowerFailInit(void)
 {
-    if (!s_logOpened)
+    PWR_PVDTypeDef pvd = {0};
+
+    pvd.PVDLevel = PWR_PVDLEVEL_7;
+    pvd.Mode = PWR_PVD_MODE_IT_RISING;   /* VDD 下降时 PVDO 由 0 变 1 */
+    HAL_PWR_ConfigPVD(&pvd);
+    HAL_PWR_EnablePVD();
+
+    HAL_NVIC_SetPriority(PVD_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(PVD_IRQn);
+}
+
+void HAL_PWR_PVDCallback(void)
+{
+    s_powerFail = 1;
+}
+
+/* 拼装文件头（data_end 为有效数据末尾） */
+static void SD_Card_MakeHeader(LogHeader_t *hdr, DWORD data_end)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic[0] = LOG_MAGIC0;
+    hdr->magic[1] = LOG_MAGIC1;
+    hdr->magic[2] = LOG_MAGIC2;
+    hdr->magic[3] = LOG_MAGIC3;
+    hdr->version = LOG_VERSION;
+    hdr->header_size = LOG_HEADER_SIZE;
+    hdr->record_size = LOG_RECORD_SIZE;
+    hdr->chan_count = LOG_CHANNELS;
+    hdr->flags = s_hdrFlags;
+    hdr->created = s_hdrCreated;
+    hdr->period_ms = SD_LOG_PERIOD_MS;
+    hdr->data_end = data_end;
+    for (uint8_t i = 0; i < LOG_CHANNELS; i++)
     {
-        printf("SD log: file not opened\r\n");
-        return -1;
+        hdr->chan[i] = g_logChannels[i].desc;
     }
+    hdr->crc = CRC16_Calc(hdr, LOG_HEADER_SIZE - 2U);
+}
 
-    char buf[64];
+/* 写文件头，借用读块缓冲拼装 */
+static int SD_Card_PutHeader(DWORD data_end)
+{
+    LogHeader_t *hdr = (LogHeader_t *)s_readBlk;
     UINT bw = 0;
 
-    int len = snprintf(buf, sizeof(buf),
-                       "%.2f,%.0f,%.2f,%.2f\r\n",
-                       ph, tds, temp, turb);
-    if (len <= 0 || len >= (int)sizeof(buf))
+    s_readBlkValid = 0;
+    SD_Card_MakeHeader(hdr, data_end);
+
+    DWORD pos = f_tell(&s_logFile);
+    FRESULT res = f_lseek(&s_logFile, 0);
+    if (res == FR_OK)
     {
-        return -2;
+        res = f_write(&s_logFile, hdr, LOG_HEADER_SIZE, &bw);
+    }
+    if (res != FR_OK || bw != (UINT)LOG_HEADER_SIZE)
+    {
+        printf("SD log: write header error=%d, bw=%u\r\n", res, bw);
+        return res ? (int)res : -1;
     }
 
-    FRESULT res = f_write(&s_logFile, buf, (UINT)len, &bw);
-    if (res != FR_OK || bw != (UINT)len)
+    return f_lseek(&s_logFile, (pos > LOG_HEADER_SIZE) ? pos : LOG_HEADER_SIZE);
+}
+
+/* 打开已有文件时校验文件头，格式不符时拒绝追加，避免把两种格式混在一个文件里 */
+static int SD_Card_CheckHeader(DWORD *data_end)
+{
+    LogHeader_t *hdr = (LogHeader_t *)s_readBlk;
+    UINT br = 0;
+
+    s_readBlkValid = 0;
+    FRESULT res = f_read(&s_logFile, hdr, LOG_HEADER_SIZE, &br);
+    if (res != FR_OK || br != (UINT)LOG_HEADER_SIZE)
     {
-        printf("SD log: f_write error=%d, bw=%u, len=%d\r\n", res, bw, len);
-        return res ? res : -3;
+        printf("SD init: read header error=%d, br=%u\r\n", res, br);
+        return res ? (int)res : -1;
     }
 
-    /* 为避免掉电丢数据，这里每次写入后都强制刷盘。
-     * 若更关注寿命/速度，可以改成定期 f_sync。 */
-    f_sync(&s_logFile);
+    if (hdr->magic[0] != LOG_MAGIC0 || hdr->magic[1] != LOG_MAGIC1 ||
+        hdr->magic[2] != LOG_MAGIC2 || hdr->magic[3] != LOG_MAGIC3 ||
+        hdr->crc != CRC16_Calc(hdr, LOG_HEADER_SIZE - 2U) ||
+        hdr->version != LOG_VERSION || hdr->record_size != LOG_RECORD_SIZE)
+    {
+        printf("SD init: %s header invalid (ver=%u)\r\n", s_logPath, hdr->version);
+        return -4;
+    }
+
+    s_hdrCreated = hdr->created;
+    s_hdrFlags = hdr->flags;
+
+    /* data_end 为 0 表示文件头还没更新过，文件大小就是数据末尾 */
+    *data_end = hdr->data_end;
+    if (*data_end == 0U || *data_end > f_size(&s_logFile))
+    {
+        *data_end = f_size(&s_logFile) / SD_SECTOR_SIZE * SD_SECTOR_SIZE;
+    }
 
     return 0;
 }
 
-void SD_Card_Deinit(void)
+/* 读 fp 中 ofs 处 len 字节，读完恢复原来的文件指针（正在写的文件也能安全读取） */
+static int SD_Card_PRead(FIL *fp, DWORD ofs, void *buf, UINT len)
 {
-    if (s_logOpened)
+    UINT br = 0;
+    DWORD pos = f_tell(fp);
+
+    FRESULT res = f_lseek(fp, ofs);
+    if (res == FR_OK)
     {
-        f_sync(&s_logFile);
-        f_close(&s_logFile);
-        s_logOpened = 0;
+        res = f_read(fp, buf, len, &br);
+    }
+    f_lseek(fp, pos);
+
+    if (res != FR_OK)
+    {
+        return res;
+    }
+    return (br == len) ? 0 : -1;
+}
+
+/* 队列或 Flash 里还有没写上卡的记录：它们已经编好序号，打开文件时序号不能重置 */
+static uint8_t SD_Card_Backlog(void)
+{
+    return (s_queueHead != s_queueTail || (s_flashReady && FlashLog_Pending() != 0U)) ? 1U : 0U;
+}
+
+/*
+ * 从 end 往后找出最后一次同步之后写入、CRC 正确且序号接续的块，返回真正的数据末尾。
+ * 最后一块读进 s_stage 并恢复编码状态，之后的记录接着往这块里加。
+ */
+static DWORD SD_Card_FindEnd(DWORD end)
+{
+    LogRecord_t first;
+    int last = -1;
+
+    s_enc.count = 0;
+    if (end > LOG_HEADER_SIZE &&
+        SD_Card_PRead(&s_logFile, end - SD_SECTOR_SIZE, s_stage, SD_SECTOR_SIZE) == 0 &&
+        LogBlock_Resume(&s_enc, s_stage) == 0)
+    {
+        last = s_enc.prev.seq;
+    }
+
+    while (end + SD_SECTOR_SIZE <= f_size(&s_logFile))
+    {
+        LogBlock_t blk;
+        if (SD_Card_PRead(&s_logFile, end, s_readBlk, SD_SECTOR_SIZE) != 0 ||
+            LogBlock_Open(&blk, s_readBlk) < 0)
+        {
+            break;
+        }
+        memcpy(&first, s_readBlk, LOG_RECORD_SIZE);
+        if (last >= 0 && first.seq != (uint8_t)(last + 1))
+        {
+            break;
+        }
+        memcpy(s_stage, s_readBlk, SD_SECTOR_SIZE);
+        if (LogBlock_Resume(&s_enc, s_stage) != 0)
+        {
+            break;
+        }
+        last = s_enc.prev.seq;
+        end += SD_SECTOR_SIZE;
+    }
+    s_readBlkValid = 0;
+    s_cleanEnd = end;   /* 之后的扇区不知道是什么，写块前再清 */
+
+    /* 轮转时队列里的记录已经编好号，序号接着往下编，不随新文件重置 */
+    if (!SD_Card_Backlog())
+    {
+        s_recSeq = (uint8_t)(last + 1);
+    }
+
+    s_dataEnd = end;
+    s_blockOfs = (s_enc.count != 0U) ? end - SD_SECTOR_SIZE : end;
+    return end;
+}
+
+/* 自 1970-01-01 起的天数转公历日期 */
+static void SD_Card_CivilDate(uint32_t day, uint16_t *y, uint8_t *m, uint8_t *d)
+{
+    uint32_t z = day + 719468UL;
+    uint32_t era = z / 146097UL;
+    uint32_t doe = z - era * 146097UL;
+    uint32_t yoe = (doe - doe / 1460U + doe / 36524U - doe / 146096U) / 365U;
+    uint32_t doy = doe - (365U * yoe + yoe / 4U - yoe / 100U);
+    uint32_t mp = (5U * doy + 2U) / 153U;
+
+    *d = (uint8_t)(doy - (153U * mp + 2U) / 5U + 1U);
+    *m = (uint8_t)((mp < 10U) ? (mp + 3U) : (mp - 9U));
+    *y = (uint16_t)(yoe + era * 400U + ((*m <= 2U) ? 1U : 0U));
+}
+
+/* 生成 LOG/YYMMDDNN.ext */
+static void SD_Card_MakePath(char *buf, uint32_t day, uint8_t part, const char *ext)
+{
+    uint16_t y;
+    uint8_t m, d;
+
+    SD_Card_CivilDate(day, &y, &m, &d);
+    snprintf(buf, SD_LOG_PATH_LEN, "%s/%02u%02u%02u%02u.%s",
+             SD_LOG_DIR, (unsigned)(y % 100U), m, d, part, ext);
+}
+
+static void SD_Card_ReleaseRead(void)
+{
+    if (s_readOpened)
+    {
+        f_close(&USERFile);
+        s_readOpened = 0;
+    }
+}
+
+/*
+ * 只读打开：当前正在写的文件直接复用写句柄（_FS_LOCK 不允许同一文件再打开一次），
+ * 其它文件用 USERFile 打开并保持到下次换文件
+ */
+static FIL *SD_Card_OpenRead(const char *path)
+{
+    if (s_logOpened && strcmp(path, s_logPath) == 0)
+    {
+        return &s_logFile;
+    }
+    if (s_logOpened && strcmp(path, s_idxPath) == 0)
+    {
+        return &s_idxFile;
+    }
+    if (s_readOpened && strcmp(path, s_readPath) == 0)
+    {
+        return &USERFile;
+    }
+
+    SD_Card_ReleaseRead();
+    if (f_open(&USERFile, path, FA_READ) != FR_OK)
+    {
+        return NULL;
+    }
+    strncpy(s_readPath, path, sizeof(s_readPath) - 1U);
+    s_readOpened = 1;
+    return &USERFile;
+}
+
+/* 文件中有效数据的末尾：正在写的文件取已写出的位置，其它文件取文件头 data_end */
+static DWORD SD_Card_DataEnd(FIL *fp)
+{
+    uint8_t head[offsetof(LogHeader_t, gen)];
+    uint16_t version;
+    uint32_t end;
+
+    if (fp == &s_logFile)
+    {
+        return s_dataEnd;
+    }
+
+    /* 其它版本的文件（升级前留下的）设备端不读，当作空文件 */
+    if (SD_Card_PRead(fp, 0, head, sizeof(head)) != 0)
+    {
+        return LOG_HEADER_SIZE;
+    }
+    memcpy(&version, &head[offsetof(LogHeader_t, version)], sizeof(version));
+    memcpy(&end, &head[offsetof(LogHeader_t, data_end)], sizeof(end));
+    if (version != LOG_VERSION)
+    {
+        return LOG_HEADER_SIZE;
+    }
+    if (end == 0U || end > f_size(fp))
+    {
+        end = f_size(fp);
+    }
+    return end;
+}
+
+/* 追加一项索引，写进 FIL 缓冲，同步时随数据一起落盘 */
+static void SD_Card_AddIndex(uint32_t ts, DWORD offset)
+{
+    LogIndex_t e;
+    UINT bw = 0;
+
+    e.ts = ts;
+    e.offset = offset;
+    FRESULT res = f_write(&s_idxFile, &e, sizeof(e), &bw);
+    if (res != FR_OK || bw != (UINT)sizeof(e))
+    {
+        printf("SD log: index write error=%d\r\n", res);
+    }
+}
+
+/*
+ * 打开当前数据文件的索引并与数据对齐：
+ *   - 去掉指向 end 之后（掉电未同步）的索引项
+ *   - 补上上次同步之后、上电恢复出来的记录对应的索引项
+ */
+static int SD_Card_OpenIndex(DWORD end)
+{
+    const DWORD step = SD_SECTOR_SIZE;
+    LogIndex_t e;
+    DWORD next = LOG_HEADER_SIZE;
+    DWORD n;
+
+    FRESULT res = f_open(&s_idxFile, s_idxPath, FA_OPEN_ALWAYS | FA_READ | FA_WRITE);
+    if (res != FR_OK)
+    {
+        printf("SD init: open %s error=%d\r\n", s_idxPath, res);
+        return res;
+    }
+
+    n = f_size(&s_idxFile) / sizeof(LogIndex_t);
+    while (n > 0U)
+    {
+        if (SD_Card_PRead(&s_idxFile, (n - 1U) * sizeof(LogIndex_t), &e, sizeof(e)) != 0)
+        {
+            n = 0;
+            break;
+        }
+        if (e.offset < end)
+        {
+            next = e.offset + step;
+            break;
+        }
+        n--;
+    }
+
+    res = f_lseek(&s_idxFile, n * sizeof(LogIndex_t));
+    if (res == FR_OK)
+    {
+        res = f_truncate(&s_idxFile);
+    }
+    if (res != FR_OK)
+    {
+        f_close(&s_idxFile);
+        return res;
+    }
+
+    for (; next < end; next += step)
+    {
+        uint32_t ts;
+        if (SD_Card_PRead(&s_logFile, next, &ts, sizeof(ts)) != 0)
+        {
+            break;
+        }
+        SD_Card_AddIndex(ts, next);
+    }
+
+    return f_sync(&s_idxFile);
+}
+
+/*
+ * 打开 now 所在日期的日志文件并定位到数据末尾。
+ * part < 0 时接着写当天最后一个分段，否则打开指定分段。
+ */
+static int SD_Card_OpenLog(uint32_t now, int part)
+{
+    FRESULT res;
+    FILINFO fno;
+
+    SD_Card_ReleaseRead();
+    s_fileDay = now / SD_SEC_PER_DAY;
+    if (part < 0)
+    {
+        part = 0;
+        while (part < (int)SD_PART_MAX)
+        {
+            SD_Card_MakePath(s_logPath, s_fileDay, (uint8_t)(part + 1), "BIN");
+            if (f_stat(s_logPath, &fno) != FR_OK)
+            {
+                break;
+            }
+            part++;
+        }
+    }
+    else if (part > (int)SD_PART_MAX)
+    {
+        printf("SD log: too many parts, appending to part %u\r\n", SD_PART_MAX);
+        part = SD_PART_MAX;
+    }
+    s_filePart = (uint8_t)part;
+    SD_Card_MakePath(s_logPath, s_fileDay, s_filePart, "BIN");
+    SD_Card_MakePath(s_idxPath, s_fileDay, s_filePart, "IDX");
+
+    res = f_open(&s_logFile, s_logPath, FA_OPEN_ALWAYS | FA_READ | FA_WRITE);
+    if (res != FR_OK)
+    {
+        printf("SD log: open %s error=%d\r\n", s_logPath, res);
+        return res;
+    }
+
+    /* 新建文件（或上次建文件时掉电、文件头不完整）先预分配再写文件头 */
+    int err;
+    DWORD end = LOG_HEADER_SIZE;
+    s_enc.count = 0;
+    s_stageDirty = 0;
+    s_blockOfs = LOG_HEADER_SIZE;
+    s_dataEnd = LOG_HEADER_SIZE;
+    s_cleanEnd = LOG_HEADER_SIZE;
+    if (f_size(&s_logFile) < LOG_HEADER_SIZE)
+    {
+        s_hdrCreated = now;
+        s_hdrFlags = s_clockSet ? 0U : LOG_FLAG_TIME_UNSET;
+        if (!SD_Card_Backlog())
+        {
+            s_recSeq = 0;
+        }
+        err = (f_truncate(&s_logFile) == FR_OK) ? SD_Card_Extend(LOG_HEADER_SIZE) : -1;
+        if (err == 0)
+        {
+            err = SD_Card_PutHeader(end);
+        }
+        if (err == 0)
+        {
+            err = f_sync(&s_logFile);
+        }
+    }
+    else
+    {
+        err = SD_Card_CheckHeader(&end);
+        if (err == 0)
+        {
+            end = SD_Card_FindEnd(end);
+            SD_Card_MapClusters();
+        }
+        else if (err == -4 && part < (int)SD_PART_MAX)
+        {
+            /* 旧版本格式的文件不往里追加，换下一个分段 */
+            f_close(&s_logFile);
+            return SD_Card_OpenLog(now, part + 1);
+        }
+    }
+    if (err == 0)
+    {
+        err = SD_Card_OpenIndex(end);
+    }
+    if (err != 0)
+    {
+        f_close(&s_logFile);
+        return err;
+    }
+
+    /* 移到最后一块的起点，准备接着往块里追加 */
+    res = f_lseek(&s_logFile, s_blockOfs);
+    if (res != FR_OK)
+    {
+        f_close(&s_idxFile);
+        f_close(&s_logFile);
+        printf("SD log: f_lseek error=%d\r\n", res);
+        return res;
+    }
+
+    s_logOpened = 1;
+    s_encWritten = s_enc.count;
+    s_sectorsSinceSync = 0;
+    s_lastSyncTick = HAL_GetTick();
+
+    printf("SD log: %s, %lu blocks\r\n", s_logPath,
+           (unsigned long)((end - LOG_HEADER_SIZE) / SD_SECTOR_SIZE));
+    return 0;
+}
+
+/* 执行同步的一步并前进到下一步，全部完成后回到 SD_COMMIT_IDLE。
+ * 每一步至多写几个扇区，SD_Card_Poll 每次调用只做一步，两步之间卡在后台编程 */
+static int SD_Card_CommitStep(void)
+{
+    int err = 0;
+    FRESULT res;
+
+    switch (s_commitStep)
+    {
+        case SD_COMMIT_BLOCK:
+            if (SD_LOG_RAW)
+            {
+                /* 裸分区没有文件头和目录项：攒着的块连同没写满的块写出就同步完了 */
+                err = s_stageDirty ? SD_Card_WriteBlock(0) : SD_Raw_Sync();
+                s_commitStep = SD_COMMIT_IDLE;
+                if (err == 0)
+                {
+                    s_sectorsSinceSync = 0;
+                    s_lastSyncTick = HAL_GetTick();
+                    SD_Card_JournalRebase();
+                }
+                break;
+            }
+            err = s_stageDirty ? SD_Card_WriteBlock(0) : 0;
+            s_commitStep = SD_COMMIT_HEADER;
+            break;
+
+        case SD_COMMIT_HEADER:
+            err = SD_Card_PutHeader(s_dataEnd);
+            s_commitStep = SD_COMMIT_LOG;
+            break;
+
+        case SD_COMMIT_LOG:
+        case SD_COMMIT_INDEX:
+            /* 两个文件的目录项通常在同一个目录扇区：两次 f_sync 都只改缓存，
+             * 最后一次写卡（sdcache.h） */
+            if (s_commitStep == SD_COMMIT_LOG)
+            {
+                SD_Cache_Hold();
+            }
+            res = f_sync((s_commitStep == SD_COMMIT_LOG) ? &s_logFile : &s_idxFile);
+            if (res == FR_OK && s_commitStep == SD_COMMIT_INDEX && SD_Cache_Flush() != RES_OK)
+            {
+                res = FR_DISK_ERR;
+            }
+            if (res != FR_OK)
+            {
+                printf("SD log: f_sync error=%d\r\n", res);
+                SD_Cache_Flush();
+                err = res;
+            }
+            else if (s_commitStep == SD_COMMIT_LOG)
+            {
+                s_commitStep = SD_COMMIT_INDEX;
+            }
+            else
+            {
+                s_commitStep = SD_COMMIT_IDLE;
+                s_sectorsSinceSync = 0;
+                s_lastSyncTick = HAL_GetTick();
+            }
+            break;
+
+        default:
+            s_commitStep = SD_COMMIT_IDLE;
+            break;
+    }
+
+    if (err != 0)
+    {
+        s_commitStep = SD_COMMIT_IDLE;
+    }
+    return err;
+}
+
+/* 一次做完全部同步步骤（也接着做完 SD_Card_Poll 里没做完的同步） */
+static int SD_Card_Commit(void)
+{
+    if (!s_logOpened)
+    {
+        return -1;
+    }
+
+    int err = 0;
+    s_commitStep = SD_COMMIT_BLOCK;
+    while (err == 0 && s_commitStep != SD_COMMIT_IDLE)
+    {
+        err = SD_Card_CommitStep();
+    }
+    return err;
+}
+
+/* 同步并关闭当前文件，截掉未用的预分配空间，文件大小与 data_end 一致 */
+static void SD_Card_CloseLog(void)
+{
+    if (!s_logOpened)
+    {
+        return;
+    }
+
+    if (SD_LOG_RAW)
+    {
+        SD_Card_Commit();
+        SD_Raw_Close();
+        s_logOpened = 0;
+        return;
+    }
+
+    if (SD_Card_Commit() == 0 && f_lseek(&s_logFile, s_dataEnd) == FR_OK)
+    {
+        f_truncate(&s_logFile);
+    }
+    f_close(&s_idxFile);
+    f_close(&s_logFile);
+    s_logOpened = 0;
+}
+
+/*
+ * 裸分区模式：找到分区并恢复写入位置，最后一块读进暂存区接着往里加记录。
+ * 分区头只在新建分区时写入，创建时间和标志取此刻的时钟。
+ */
+static int SD_Card_OpenRaw(void)
+{
+    LogHeader_t *hdr = (LogHeader_t *)s_readBlk;
+
+    s_hdrCreated = SD_Card_GetTime();
+    s_hdrFlags = s_clockSet ? 0U : LOG_FLAG_TIME_UNSET;
+    s_readBlkValid = 0;
+    SD_Card_MakeHeader(hdr, 0);
+
+    int ret = SD_Raw_Open(hdr, s_stage);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    if (ret == 1 && LogBlock_Resume(&s_enc, s_stage) == 0)
+    {
+        LogBlock_Reserve(&s_enc, LOG_RAW_TRAILER);
+        if (!SD_Card_Backlog())
+        {
+            s_recSeq = (uint8_t)(s_enc.prev.seq + 1U);
+        }
+    }
+    else
+    {
+        s_enc.count = 0;
+    }
+
+    s_stageDirty = 0;
+    s_logOpened = 1;
+    s_encWritten = s_enc.count;
+    s_sectorsSinceSync = 0;
+    s_lastSyncTick = HAL_GetTick();
+    return 0;
+}
+
+/* 卡上没有 FAT 卷时看是不是 exFAT（64GB 以上的卡出厂都是），本工程的 FatFs R0.11 不支持，提示重新格式化 */
+static void SD_Card_CheckExFat(void)
+{
+    static const char sig[8] = { 'E', 'X', 'F', 'A', 'T', ' ', ' ', ' ' };
+    DWORD sect;
+
+    s_readBlkValid = 0;
+    if (disk_read(USERFatFS.drv, s_readBlk, 0, 1U) != RES_OK)
+    {
+        return;
+    }
+    if (memcmp(&s_readBlk[3], sig, sizeof(sig)) != 0)
+    {
+        /* 有 MBR 时看第一个分区：类型 0x07（exFAT / NTFS）再读它的引导扇区 */
+        if (s_readBlk[446U + 4U] != 0x07U)
+        {
+            return;
+        }
+        memcpy(&sect, &s_readBlk[446U + 8U], sizeof(sect));
+        if (disk_read(USERFatFS.drv, s_readBlk, sect, 1U) != RES_OK ||
+            memcmp(&s_readBlk[3], sig, sizeof(sig)) != 0)
+        {
+            return;
+        }
+    }
+    printf("SD init: exFAT is not supported, send \"#FORMAT YES\" to reformat as FAT32\r\n");
+}
+
+/* 挂载卡并打开日志 */
+static int SD_Card_Open(void)
+{
+    FRESULT res;
+
+    /* 挂载文件系统（逻辑盘路径由 CubeMX 在 fatfs.c 里生成）。
+     * 裸分区模式下卡上可以没有 FAT 分区，挂载时驱动已经初始化，照样往下走 */
+    res = f_mount(&USERFatFS, USERPath, 1);
+    if (res != FR_OK && (!SD_LOG_RAW || res != FR_NO_FILESYSTEM))
+    {
+        printf("SD init: f_mount error=%d\r\n", res);
+        if (res == FR_NO_FILESYSTEM)
+        {
+            SD_Card_CheckExFat();
+        }
+        return res;
+    }
+
+    /* 读取容量和擦除块（AU）大小，后续按擦除块对齐写入 */
+    DWORD val = 0;
+    s_cardSectors = (disk_ioctl(USERFatFS.drv, GET_SECTOR_COUNT, &val) == RES_OK) ? val : 0U;
+    val = 1;
+    s_eraseBlock = (disk_ioctl(USERFatFS.drv, GET_BLOCK_SIZE, &val) == RES_OK && val != 0U) ? val : 1U;
+    printf("SD init: %lu sectors (%lu MB), erase block %lu sectors\r\n",
+           (unsigned long)s_cardSectors, (unsigned long)(s_cardSectors / 2048U), (unsigned long)s_eraseBlock);
+
+    /* 日志目录，已存在时返回 FR_EXIST */
+    res = SD_LOG_RAW ? FR_OK : f_mkdir(SD_LOG_DIR);
+    if (res != FR_OK && res != FR_EXIST)
+    {
+        printf("SD init: f_mkdir error=%d\r\n", res);
+        return res;
+    }
+
+    return SD_LOG_RAW ? SD_Card_OpenRaw() : SD_Card_OpenLog(SD_Card_GetTime(), -1);
+}
+
+/* 轮转到 part 分段（part < 0 为新日期的最后一个分段） */
+static int SD_Card_Rotate(uint32_t ts, int part)
+{
+    SD_Card_CloseLog();
+    return SD_Card_OpenLog(ts, part);
+}
+
+/* 把一条记录编码进当前块：块满时整扇区写出再开新块，日期变化或文件写满时轮转 */
+static int SD_Card_Append(const LogRecord_t *rec)
+{
+    int err;
+
+    if (!SD_LOG_RAW && rec->ts / SD_SEC_PER_DAY != s_fileDay)
+    {
+        err = SD_Card_Rotate(rec->ts, -1);
+        if (err != 0)
+        {
+            return err;
+        }
+    }
+
+    if (s_enc.count != 0U)
+    {
+        if (LogBlock_Add(&s_enc, rec) == 0)
+        {
+            s_stageDirty = 1;
+            return 0;
+        }
+        err = SD_Card_WriteBlock(1);
+        if (err != 0)
+        {
+            return err;
+        }
+    }
+
+    if (!SD_LOG_RAW && s_blockOfs + SD_SECTOR_SIZE > SD_ROTATE_BYTES)
+    {
+        err = SD_Card_Rotate(rec->ts, (int)s_filePart + 1);
+        if (err != 0)
+        {
+            return err;
+        }
+        /* 新分段是上次写到一半的文件时，先试着接着写它的最后一块 */
+        if (s_enc.count != 0U && LogBlock_Add(&s_enc, rec) == 0)
+        {
+            s_stageDirty = 1;
+            return 0;
+        }
+        if (s_enc.count != 0U && (err = SD_Card_WriteBlock(1)) != 0)
+        {
+            return err;
+        }
+    }
+
+    /* 每块第一条记录写一项索引（裸分区按块序号二分查找，不需要索引，块尾留给序号） */
+    LogBlock_Start(&s_enc, s_stage, rec);
+    s_stageDirty = 1;
+    if (SD_LOG_RAW)
+    {
+        LogBlock_Reserve(&s_enc, LOG_RAW_TRAILER);
+    }
+    else
+    {
+        SD_Card_AddIndex(rec->ts, s_blockOfs);
+    }
+    return 0;
+}
+
+/*
+ * 写入端：把队列里的记录交给 SD_Card_Append。
+ * all == 0 时每次最多写出一个扇区就返回，让主循环在两次写卡之间照常运行。
+ */
+static int SD_Card_Drain(uint8_t all)
+{
+    while (s_queueTail != s_queueHead)
+    {
+        uint16_t sectors = s_sectorsSinceSync;
+        int err = SD_Card_Append(&s_queue[s_queueTail % SD_QUEUE_RECORDS]);
+
+        /* 写失败的记录也出队，否则卡坏了会一直卡在同一条上；
+         * 有 Flash 后备时留在队列里，转入离线后存进 Flash */
+        if (err != 0 && s_flashReady)
+        {
+            return err;
+        }
+        s_queueTail++;
+        if (err != 0)
+        {
+            return err;
+        }
+        if (!all && s_sectorsSinceSync != sectors)
+        {
+            break;
+        }
+    }
+    return 0;
+}
+
+/* 队列里的记录全部存进片内 Flash */
+static void SD_Card_QueueToFlash(void)
+{
+    while (s_queueTail != s_queueHead)
+    {
+        FlashLog_Add(&s_queue[s_queueTail % SD_QUEUE_RECORDS]);
+        s_queueTail++;
+    }
+    SD_Card_JournalRebase();
+}
+
+/*
+ * 卡拔出或写卡出错：不再访问卡，之后的记录存进片内 Flash，隔 SD_RETRY_MS 重新初始化卡。
+ * rescue 为 1 时还没写上卡的记录也存进 Flash：复位保护日志没放满时取日志里除队列以外的记录
+ * （裸分区攒着的块也在内），否则取暂存块里 s_encWritten 之后的记录；
+ * 转存 Flash 积压时出错不用：暂存块里其余的记录都还在 Flash 里没作废。
+ */
+static void SD_Card_Offline(uint8_t rescue)
+{
+    LogBlock_t dec;
+    LogRecord_t rec;
+
+    printf("SD log: card failed, logging to internal flash\r\n");
+    if (rescue && SD_JOURNAL && !SD_Journal_Full())
+    {
+        uint16_t n = SD_Journal_Open();
+        uint16_t queued = (uint16_t)(s_queueHead - s_queueTail);
+        for (uint16_t i = 0; SD_Journal_Next(&rec); i++)
+        {
+            if (i + queued < n)
+            {
+                FlashLog_Add(&rec);
+            }
+        }
+    }
+    else if (rescue && s_enc.count > s_encWritten)
+    {
+        LogBlock_Finish(&s_enc);
+        if (LogBlock_Open(&dec, s_stage) > 0)
+        {
+            for (uint16_t i = 0; LogBlock_Next(&dec, &rec); i++)
+            {
+                if (i >= s_encWritten)
+                {
+                    FlashLog_Add(&rec);
+                }
+            }
+        }
+    }
+
+    /* 文件不关闭（关闭要写卡），直接卸载，重新挂载时 FatFs 从卡上重新读取 */
+    f_mount(NULL, USERPath, 0);
+    s_logOpened = 0;
+    s_readOpened = 0;
+    s_readBlkValid = 0;
+    s_commitStep = SD_COMMIT_IDLE;
+    s_enc.count = 0;
+    s_encWritten = 0;
+    s_stageDirty = 0;
+    s_retryTick = HAL_GetTick();
+    SD_Card_JournalRebase();
+}
+
+/*
+ * 卡恢复后把 Flash 里积压的最旧一块转存到卡上：记录追加完并同步成功才作废 Flash 里的这一块，
+ * 中途出错时这一块留到下次再转（已经写上卡的几条会重复一次）
+ */
+static int SD_Card_DrainFlash(void)
+{
+    const uint8_t *blk = FlashLog_Oldest();
+    LogBlock_t dec;
+    LogRecord_t rec;
+    int err = 0;
+
+    if (blk == NULL)
+    {
+        /* 还有待转存的块却拿不到：上一块的作废标记补写失败 */
+        return (FlashLog_Pending() != 0U) ? -1 : 0;
+    }
+
+    if (LogBlock_Open(&dec, (uint8_t *)blk) > 0)
+    {
+        while (err == 0 && LogBlock_Next(&dec, &rec))
+        {
+            err = SD_Card_Append(&rec);
+        }
+    }
+    if (err == 0)
+    {
+        err = SD_Card_Commit();
+    }
+    if (err == 0)
+    {
+        err = FlashLog_Release();
+    }
+    return err;
+}
+
+/* 离线时的 SD_Card_Poll：记录存进 Flash，提前擦好下一页，到时间重新初始化卡 */
+static void SD_Card_PollOffline(void)
+{
+    SD_Card_QueueToFlash();
+
+    if (s_powerFail)
+    {
+        s_powerFail = 0;
+        FlashLog_Flush();
+        return;
+    }
+
+    FlashLog_Poll();
+
+    if ((HAL_GetTick() - s_retryTick) >= SD_RETRY_MS)
+    {
+        SD_Card_Init();
+    }
+}
+
+/*
+ * 重放复位前留在 .noinit 日志里的记录：卡打开了就追加到卡上并同步；离线或 Flash 里有积压
+ * （积压的记录更早）时存进 Flash。上次重放到一半又复位时卡上已经有前一部分，
+ * 卡上最后一条及之前的跳过
+ */
+static void SD_Card_Replay(void)
+{
+    LogRecord_t rec;
+    uint16_t n = SD_Journal_Open();
+    uint16_t i, skip = 0;
+    int err = 0;
+    uint8_t toCard = (s_logOpened && !(s_flashReady && FlashLog_Pending() != 0U)) ? 1U : 0U;
+
+    if (n == 0U)
+    {
+        return;
+    }
+    if (!toCard && !s_flashReady)
+    {
+        printf("SD log: %u records from before reset kept for next boot\r\n", (unsigned)n);
+        return;
+    }
+
+    if (toCard && s_enc.count != 0U)
+    {
+        for (i = 1; SD_Journal_Next(&rec); i++)
+        {
+            if (memcmp(&rec, &s_enc.prev, sizeof(rec)) == 0)
+            {
+                skip = i;
+            }
+        }
+        SD_Journal_Open();
+    }
+
+    for (i = 0; SD_Journal_Next(&rec); i++)
+    {
+        s_recSeq = (uint8_t)(rec.seq + 1U);
+        if (i < skip)
+        {
+            continue;
+        }
+        if (!toCard)
+        {
+            FlashLog_Add(&rec);
+        }
+        else if (err == 0)
+        {
+            err = SD_Card_Append(&rec);
+        }
+    }
+    if (toCard && err == 0)
+    {
+        err = SD_Card_Commit();
+    }
+    printf("SD log: replayed %u records from before reset\r\n", (unsigned)(n - skip));
+
+    /* 写卡出错：整个日志改存进 Flash（已经写上卡的几条会重复），再转入离线 */
+    if (toCard && err != 0 && s_flashReady)
+    {
+        SD_Journal_Open();
+        for (i = 0; SD_Journal_Next(&rec); i++)
+        {
+            if (i >= skip)
+            {
+                FlashLog_Add(&rec);
+            }
+        }
+        SD_Card_Offline(0);
+    }
+    SD_Card_JournalRebase();
+}
+
+int SD_Card_Init(void)
+{
+    /* 第一次初始化时扫描片内 Flash，之后卡不在也照样记录；有积压时序号接着最新的一条往下编 */
+    if (SD_FLASH_FALLBACK && !s_flashReady)
+    {
+        LogRecord_t rec;
+        FlashLog_Init();
+        s_flashReady = 1;
+        if (FlashLog_Newest(&rec) == 0)
+        {
+            s_recSeq = (uint8_t)(rec.seq + 1U);
+        }
+    }
+
+    /* 离线时供电跌落也要把记录写进 Flash，所以不管卡在不在都开 */
+    SD_Card_PowerFailInit();
+
+    int err = SD_Card_Open();
+    if (err != 0)
+    {
+        s_retryTick = HAL_GetTick();
+    }
+
+    /* 第一次初始化时把复位前没写上卡的记录补上，之后的新记录接着编号 */
+    if (SD_JOURNAL && !s_journalReplayed)
+    {
+        s_journalReplayed = 1;
+        SD_Card_Replay();
+    }
+    return err;
+}
+
+/* 采集端：只在 RAM 里生成记录并入队，不碰 SD 卡 */
+int SD_Card_Log(float ph, float tds, float temp, float turb)
+{
+    if (!s_logOpened && !s_flashReady)
+    {
+        printf("SD log: file not opened\r\n");
+        return -1;
+    }
+
+    uint16_t pending = (uint16_t)(s_queueHead - s_queueTail);
+    if (pending >= SD_QUEUE_RECORDS)
+    {
+        s_queueDropped++;
+        printf("SD log: queue full, dropped=%lu\r\n", (unsigned long)s_queueDropped);
+        return -2;
+    }
+
+    LogRecord_t *rec = &s_queue[s_queueHead % SD_QUEUE_RECORDS];
+    uint8_t flags = s_clockSet ? 0U : LOG_FLAG_TIME_UNSET;
+
+    rec->ts = SD_Card_GetTime();
+    rec->ph = (int16_t)LogChan_Fixed(LOG_CH_PH, ph, &flags);
+    rec->temp = (int16_t)LogChan_Fixed(LOG_CH_TEMP, temp, &flags);
+    rec->tds = (uint16_t)LogChan_Fixed(LOG_CH_TDS, tds, &flags);
+    rec->turb = (uint16_t)LogChan_Fixed(LOG_CH_TURB, turb, &flags);
+    rec->flags = flags;
+    rec->seq = s_recSeq++;
+    rec->crc = CRC16_Calc(rec, LOG_RECORD_SIZE - 2U);
+    if (SD_JOURNAL)
+    {
+        SD_Journal_Add(rec);
+    }
+
+    s_queueHead++;
+    if (++pending > s_queuePeak)
+    {
+        s_queuePeak = pending;
+    }
+    return 0;
+}
+
+int SD_Card_Sync(void)
+{
+    int err = 0;
+
+    if (!s_logOpened)
+    {
+        if (!s_flashReady)
+        {
+            return -1;
+        }
+        SD_Card_QueueToFlash();
+        FlashLog_Flush();
+        return 0;
+    }
+
+    /* Flash 里积压的记录比队列里的早，先转存 */
+    while (err == 0 && s_flashReady && FlashLog_Pending() != 0U)
+    {
+        err = SD_Card_DrainFlash();
+    }
+    if (err == 0)
+    {
+        err = SD_Card_Drain(1);
+    }
+    int res = SD_Card_Commit();
+    return (err != 0) ? err : res;
+}
+
+void SD_Card_Poll(void)
+{
+    if (!s_logOpened)
+    {
+        if (s_flashReady)
+        {
+            SD_Card_PollOffline();
+        }
+        return;
+    }
+
+    if (s_powerFail)
+    {
+        s_powerFail = 0;
+        SD_Card_Sync();
+        return;
+    }
+
+    /* 卡还在编程上一个扇区：这次不访问卡，先回主循环做别的事 */
+    if (USER_IsBusy())
+    {
+        return;
+    }
+
+    /* 同步分步进行，没做完之前不写新数据 */
+    if (s_commitStep != SD_COMMIT_IDLE)
+    {
+        if (SD_Card_CommitStep() != 0 && s_flashReady)
+        {
+            SD_Card_Offline(1);
+        }
+        return;
+    }
+
+    /* 卡恢复后先转存 Flash 里积压的记录（每次一块），队列里更新的记录等转存完再写 */
+    if (s_flashReady && FlashLog_Pending() != 0U)
+    {
+        if (SD_Card_DrainFlash() != 0)
+        {
+            SD_Card_Offline(0);
+        }
+        return;
+    }
+
+    /* 写入端：每次调用最多写一个扇区 */
+    if (SD_Card_Drain(0) != 0 && s_flashReady)
+    {
+        SD_Card_Offline(1);
+        return;
+    }
+
+    /* 复位保护日志放满了：没写满的块原地写一次卡，复位后能从卡上找回，不用等到同步 */
+    if (SD_JOURNAL && SD_Journal_Full() && s_stageDirty)
+    {
+        if (SD_Card_WriteBlock(0) != 0 && s_flashReady)
+        {
+            SD_Card_Offline(1);
+        }
+        return;
+    }
+
+    if ((s_syncEverySectors != 0U && s_sectorsSinceSync >= s_syncEverySectors) ||
+        (s_syncIntervalMs != 0U &&
+         (HAL_GetTick() - s_lastSyncTick) >= s_syncIntervalMs &&
+         (s_stageDirty || s_sectorsSinceSync != 0U)))
+    {
+        s_commitStep = SD_COMMIT_BLOCK;
+    }
+}
+
+void SD_Card_SetSyncPolicy(uint16_t every_sectors, uint32_t interval_ms)
+{
+    s_syncEverySectors = every_sectors;
+    s_syncIntervalMs = interval_ms;
+}
+
+void SD_Card_GetSyncPolicy(uint16_t *every_sectors, uint32_t *interval_ms)
+{
+    *every_sectors = s_syncEverySectors;
+    *interval_ms = s_syncIntervalMs;
+}
+
+void SD_Card_SetTime(uint32_t unix_time)
+{
+    s_clockSec = unix_time;
+    s_clockMs = 0;
+    s_clockLastTick = HAL_GetTick();
+    s_clockSet = 1;
+}
+
+uint32_t SD_Card_GetTime(void)
+{
+    /* 按差值累加，SysTick 计数 49 天回绕也不影响 */
+    uint32_t now = HAL_GetTick();
+    s_clockMs += now - s_clockLastTick;
+    s_clockLastTick = now;
+
+    s_clockSec += s_clockMs / 1000U;
+    s_clockMs %= 1000U;
+    return s_clockSec;
+}
+
+uint8_t SD_Card_IsOnline(void)
+{
+    return s_logOpened;
+}
+
+uint8_t SD_Card_TimeSet(void)
+{
+    return s_clockSet;
+}
+
+uint32_t SD_Card_FatTime(void)
+{
+    uint16_t y;
+    uint8_t m, d;
+
+    if (!s_clockSet)
+    {
+        return ((uint32_t)(_NORTC_YEAR - 1980) << 25 | (uint32_t)_NORTC_MON << 21 |
+                (uint32_t)_NORTC_MDAY << 16);
+    }
+
+    uint32_t t = SD_Card_GetTime();
+    uint32_t s = t % SD_SEC_PER_DAY;
+    SD_Card_CivilDate(t / SD_SEC_PER_DAY, &y, &m, &d);
+
+    return ((uint32_t)(y - 1980U) << 25) | ((uint32_t)m << 21) | ((uint32_t)d << 16) |
+           ((s / 3600U) << 11) | ((s / 60U % 60U) << 5) | (s % 60U / 2U);
+}
+
+/*
+ * 读游标所在的块到 s_readBlk 并准备解码，同一块连续读时不重复读卡。
+ * 裸分区模式下 fp 不用，cur->offset 为块序号。
+ * 返回 0 成功，1 块无效（CRC 错误、裸分区里已被覆盖等，应跳过），负数为读错误。
+ */
+static int SD_Card_LoadBlock(FIL *fp, const SD_LogCursor_t *cur, LogBlock_t *blk)
+{
+    if (!s_readBlkValid || s_readBlkDay != cur->day || s_readBlkPart != cur->part ||
+        s_readBlkOfs != cur->offset)
+    {
+        int err = SD_LOG_RAW ? SD_Raw_Read(cur->offset, s_readBlk)
+                             : SD_Card_PRead(fp, cur->offset, s_readBlk, SD_SECTOR_SIZE);
+        if (err != 0)
+        {
+            s_readBlkValid = 0;
+            if (SD_LOG_RAW && err < 0)
+            {
+                return 1;
+            }
+            return (err > 0) ? -err : err;
+        }
+        s_readBlkDay = cur->day;
+        s_readBlkPart = cur->part;
+        s_readBlkOfs = cur->offset;
+        s_readBlkValid = 1;
+    }
+
+    return (LogBlock_Open(blk, s_readBlk) < 0) ? 1 : 0;
+}
+
+/*
+ * 从游标所在块起顺序解码，找第一条时间不早于 t 的记录；整块都早于 t 时换下一块。
+ * step 为相邻两块的游标差（文件中为扇区大小，裸分区为 1），end 为最后一块之后的游标。
+ */
+static void SD_Card_SkipBefore(FIL *fp, SD_LogCursor_t *cur, uint32_t t, DWORD end, uint32_t step)
+{
+    LogBlock_t blk;
+    LogRecord_t rec;
+
+    while (cur->offset < end && SD_Card_LoadBlock(fp, cur, &blk) == 0)
+    {
+        while (LogBlock_Next(&blk, &rec) && rec.ts < t)
+        {
+            cur->skip++;
+        }
+        if (cur->skip < blk.count)
+        {
+            break;
+        }
+        cur->offset += step;
+        cur->skip = 0;
+    }
+}
+
+/*
+ * 从游标所在块取出最多 len 字节的记录，块读完或是坏块时游标前进 step 到下一块。
+ * 返回取出的字节数，负数为读错误。
+ */
+static int SD_Card_ReadBlock(FIL *fp, SD_LogCursor_t *cur, uint8_t *out, uint32_t len, uint32_t step)
+{
+    LogBlock_t blk;
+    LogRecord_t rec;
+    uint32_t n = 0;
+    uint16_t i = 0;
+    int got = 1;
+
+    int err = SD_Card_LoadBlock(fp, cur, &blk);
+    if (err < 0)
+    {
+        return err;
+    }
+
+    /* 块内解码到游标处，再取出最多 len 字节的记录；坏块整块跳过 */
+    while (err == 0 && n < len && (got = LogBlock_Next(&blk, &rec)) != 0)
+    {
+        if (i++ >= cur->skip)
+        {
+            memcpy(&out[n], &rec, LOG_RECORD_SIZE);
+            n += LOG_RECORD_SIZE;
+        }
+    }
+    cur->skip = (uint16_t)(cur->skip + n / LOG_RECORD_SIZE);
+    if (err != 0 || !got || cur->skip >= blk.count)
+    {
+        cur->offset += step;
+        cur->skip = 0;
+    }
+    return (int)n;
+}
+
+/* 打开游标所在的文件并更新 cur->end：正在写的文件每次重新取末尾，其它文件第一次读时从文件头取 */
+static FIL *SD_Card_CursorFile(SD_LogCursor_t *cur)
+{
+    char path[SD_LOG_PATH_LEN];
+
+    SD_Card_MakePath(path, cur->day, cur->part, "BIN");
+    FIL *fp = SD_Card_OpenRead(path);
+    if (fp != NULL && (fp == &s_logFile || cur->end == 0U))
+    {
+        cur->end = SD_Card_DataEnd(fp);
+    }
+    return fp;
+}
+
+/* 游标移到下一个存在的日志文件：同一天的下一分段，或之后最早有文件的日期 */
+static int SD_Card_NextFile(SD_LogCursor_t *cur)
+{
+    const uint32_t today = SD_Card_GetTime() / SD_SEC_PER_DAY;
+    char path[SD_LOG_PATH_LEN];
+    FILINFO fno;
+    uint32_t day = cur->day;
+    uint8_t part = (uint8_t)(cur->part + 1U);
+
+    for (; day <= today; day++, part = 0)
+    {
+        if (part > SD_PART_MAX)
+        {
+            continue;
+        }
+        SD_Card_MakePath(path, day, part, "BIN");
+        if (f_stat(path, &fno) == FR_OK)
+        {
+            cur->day = day;
+            cur->part = part;
+            cur->offset = LOG_HEADER_SIZE;
+            cur->skip = 0;
+            cur->end = 0;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/* 裸分区：块的首条时间随序号递增，直接在现存的块序号上二分查找，不需要索引 */
+static int SD_Card_LocateRaw(uint32_t t, SD_LogCursor_t *cur)
+{
+    uint32_t lo = SD_Raw_First();
+    uint32_t hi = SD_Raw_Head() + 1U;
+    uint32_t ts;
+
+    memset(cur, 0, sizeof(*cur));
+    cur->offset = lo;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2U;
+
+        /* 读不出的块（还没写出的当前块）当作晚于 t */
+        s_readBlkValid = 0;
+        if (SD_Raw_Read(mid, s_readBlk) != 0)
+        {
+            hi = mid;
+            continue;
+        }
+        memcpy(&ts, s_readBlk, sizeof(ts));
+        if (ts <= t)
+        {
+            cur->offset = mid;
+            lo = mid + 1U;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    SD_Card_SkipBefore(NULL, cur, t, SD_Raw_Head() + 1U, 1U);
+    return 0;
+}
+
+int SD_Card_Locate(uint32_t t, SD_LogCursor_t *cur)
+{
+    const uint32_t today = SD_Card_GetTime() / SD_SEC_PER_DAY;
+    char path[SD_LOG_PATH_LEN];
+    LogIndex_t e;
+    FIL *fp;
+    int found = -1;
+
+    if (!s_logOpened)
+    {
+        return -1;
+    }
+    if (SD_LOG_RAW)
+    {
+        return SD_Card_LocateRaw(t, cur);
+    }
+
+    /* 1. 找 t 所在的文件：从 t 当天往后找第一个有文件的日期，
+     *    同一天里取首条索引时间不晚于 t 的最后一个分段 */
+    for (uint32_t day = t / SD_SEC_PER_DAY; day <= today && found < 0; day++)
+    {
+        for (uint8_t part = 0; part <= SD_PART_MAX; part++)
+        {
+            SD_Card_MakePath(path, day, part, "IDX");
+            fp = SD_Card_OpenRead(path);
+            if (fp == NULL || SD_Card_PRead(fp, 0, &e, sizeof(e)) != 0 ||
+                (found >= 0 && e.ts > t))
+            {
+                break;
+            }
+            found = part;
+        }
+        if (found >= 0)
+        {
+            cur->day = day;
+            cur->part = (uint8_t)found;
+        }
+    }
+    if (found < 0)
+    {
+        return -1;
+    }
+
+    /* 2. 在索引里二分查找最后一个时间不晚于 t 的块 */
+    cur->offset = LOG_HEADER_SIZE;
+    cur->skip = 0;
+    cur->end = 0;
+    SD_Card_MakePath(path, cur->day, cur->part, "IDX");
+    fp = SD_Card_OpenRead(path);
+    if (fp != NULL)
+    {
+        uint32_t lo = 0;
+        uint32_t hi = f_size(fp) / sizeof(LogIndex_t);
+        while (lo < hi)
+        {
+            uint32_t mid = lo + (hi - lo) / 2U;
+            if (SD_Card_PRead(fp, mid * sizeof(LogIndex_t), &e, sizeof(e)) != 0)
+            {
+                break;
+            }
+            if (e.ts <= t)
+            {
+                cur->offset = e.offset;
+                lo = mid + 1U;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+    }
+
+    /* 3. 在块里顺序解码，找第一条时间不早于 t 的记录 */
+    SD_Card_MakePath(path, cur->day, cur->part, "BIN");
+    fp = SD_Card_OpenRead(path);
+    if (fp != NULL)
+    {
+        SD_Card_SkipBefore(fp, cur, t, SD_Card_DataEnd(fp), SD_SECTOR_SIZE);
+    }
+
+    return 0;
+}
+
+/* 裸分区：按块序号往后读到正在编码的块为止 */
+static int SD_Card_ReadNextRaw(SD_LogCursor_t *cur, uint8_t *out, uint32_t len)
+{
+    /* 游标处的块已被环形覆盖时从现存最旧的块接着读 */
+    if (cur->offset < SD_Raw_First())
+    {
+        cur->offset = SD_Raw_First();
+        cur->skip = 0;
+    }
+
+    while (cur->offset <= SD_Raw_Head())
+    {
+        int n = SD_Card_ReadBlock(NULL, cur, out, len, 1U);
+        if (n != 0)
+        {
+            return n;
+        }
+    }
+    return 0;
+}
+
+int SD_Card_ReadNext(SD_LogCursor_t *cur, void *buf, uint32_t len)
+{
+    uint8_t *out = (uint8_t *)buf;
+
+    if (!s_logOpened)
+    {
+        return -1;
+    }
+
+    len -= len % LOG_RECORD_SIZE;
+    if (SD_LOG_RAW)
+    {
+        return SD_Card_ReadNextRaw(cur, out, len);
+    }
+
+    for (;;)
+    {
+        FIL *fp = SD_Card_CursorFile(cur);
+        if (fp != NULL)
+        {
+            while (cur->offset < cur->end)
+            {
+                int n = SD_Card_ReadBlock(fp, cur, out, len, SD_SECTOR_SIZE);
+                if (n != 0)
+                {
+                    return n;
+                }
+            }
+            /* 正在写的文件读到末尾就是全部日志的末尾 */
+            if (fp == &s_logFile)
+            {
+                return 0;
+            }
+        }
+
+        if (SD_Card_NextFile(cur) != 0)
+        {
+            return 0;
+        }
+    }
+}
+
+void SD_Card_GetHeader(void *hdr)
+{
+    SD_Card_MakeHeader((LogHeader_t *)hdr, 0);
+}
+
+uint32_t SD_Card_SeekBlock(const SD_LogCursor_t *base, uint32_t index, SD_LogCursor_t *cur)
+{
+    uint32_t n = index;
+
+    *cur = *base;
+    cur->skip = 0;
+    if (SD_LOG_RAW)
+    {
+        if (s_logOpened && index < SD_Raw_First())
+        {
+            index = SD_Raw_First();
+        }
+        else if (s_logOpened && index > SD_Raw_Head() + 1U)
+        {
+            index = SD_Raw_Head() + 1U;
+        }
+        cur->offset = index;
+        return index;
+    }
+
+    /* 逐个文件按有效数据长度扣掉块数，不读块内容 */
+    while (s_logOpened)
+    {
+        FIL *fp = SD_Card_CursorFile(cur);
+        if (fp != NULL)
+        {
+            uint32_t avail = (cur->end > cur->offset) ? (cur->end - cur->offset) / SD_SECTOR_SIZE : 0U;
+            if (n <= avail)
+            {
+                cur->offset += n * SD_SECTOR_SIZE;
+                return index;
+            }
+            n -= avail;
+            cur->offset = cur->end;
+            if (fp == &s_logFile)
+            {
+                break;
+            }
+        }
+        if (SD_Card_NextFile(cur) != 0)
+        {
+            break;
+        }
+    }
+    return index - n;
+}
+
+int SD_Card_ReadRawBlock(SD_LogCursor_t *cur, void *blk)
+{
+    if (!s_logOpened)
+    {
+        return -1;
+    }
+
+    cur->skip = 0;
+    if (SD_LOG_RAW)
+    {
+        if (cur->offset > SD_Raw_Head())
+        {
+            return 0;
+        }
+        int err = SD_Raw_Read(cur->offset++, blk);
+        if (err > 0)
+        {
+            return -err;
+        }
+        return (err == 0) ? 1 : 2;
+    }
+
+    for (;;)
+    {
+        FIL *fp = SD_Card_CursorFile(cur);
+        if (fp != NULL)
+        {
+            if (cur->offset < cur->end)
+            {
+                int err = SD_Card_PRead(fp, cur->offset, blk, SD_SECTOR_SIZE);
+                if (err != 0)
+                {
+                    return (err > 0) ? -err : err;
+                }
+                cur->offset += SD_SECTOR_SIZE;
+                return 1;
+            }
+            if (fp == &s_logFile)
+            {
+                return 0;
+            }
+        }
+
+        if (SD_Card_NextFile(cur) != 0)
+        {
+            return 0;
+        }
+    }
+}
+
+/*
+ * 测速区：在 LOG 目录建临时文件并一次性扩展，取其第一段连续簇作为裸扇区读写区域，
+ * 测速时只改写这个文件自己的数据簇，不会破坏文件系统和日志。
+ */
+int SD_Card_ScratchOpen(uint32_t sectors, uint32_t *first, uint32_t *count)
+{
+    DWORD tbl[4];
+    FRESULT res;
+
+    if (!s_logOpened || first == NULL || count == NULL)
+    {
+        return -1;
+    }
+
+    SD_Card_Sync();
+    SD_Card_ReleaseRead();
+
+    res = f_open(&USERFile, SD_SCRATCH_PATH, FA_CREATE_ALWAYS | FA_READ | FA_WRITE);
+    if (res != FR_OK)
+    {
+        return res;
+    }
+
+    res = f_lseek(&USERFile, (DWORD)sectors * SD_SECTOR_SIZE);
+    if (res == FR_OK && f_tell(&USERFile) != (DWORD)sectors * SD_SECTOR_SIZE)
+    {
+        res = FR_DENIED;    /* 卡满 */
+    }
+    if (res == FR_OK)
+    {
+        res = f_sync(&USERFile);
+    }
+
+    /* 表只有 4 项：碎片多于一段时返回 FR_NOT_ENOUGH_CORE，但第一段已经填好 */
+    if (res == FR_OK)
+    {
+        tbl[0] = 4U;
+        USERFile.cltbl = tbl;
+        res = f_lseek(&USERFile, CREATE_LINKMAP);
+        USERFile.cltbl = NULL;
+        if (res == FR_NOT_ENOUGH_CORE)
+        {
+            res = FR_OK;
+        }
+    }
+
+    f_close(&USERFile);
+    if (res != FR_OK)
+    {
+        f_unlink(SD_SCRATCH_PATH);
+        return res;
+    }
+
+    *first = USERFatFS.database + (tbl[2] - 2U) * USERFatFS.csize;
+    *count = tbl[1] * USERFatFS.csize;
+    if (*count > sectors)
+    {
+        *count = sectors;
+    }
+    return 0;
+}
+
+void SD_Card_ScratchClose(void)
+{
+    f_unlink(SD_SCRATCH_PATH);
+}
+
+void SD_Card_GetGeometry(uint32_t *sectors, uint32_t *erase_block)
+{
+    if (sectors != NULL)     *sectors = s_cardSectors;
+    if (erase_block != NULL) *erase_block = s_eraseBlock;
+}
+
+void SD_Card_GetQueueStats(uint16_t *pending, uint16_t *peak, uint32_t *dropped)
+{
+    if (pending != NULL) *pending = (uint16_t)(s_queueHead - s_queueTail);
+    if (peak != NULL)    *peak = s_queuePeak;
+    if (dropped != NULL) *dropped = s_queueDropped;
+}
+
+int SD_Card_Format(void)
+{
+    BYTE pdrv = (BYTE)(USERPath[0] - '0');     /* 单分区配置下逻辑盘号就是物理盘号 */
+    DWORD sectors = 0;
+    UINT au = 0;
+
+    if (SD_LOG_RAW)
+    {
+        return -1;
+    }
+
+    SD_Card_Deinit();
+
+    /* 簇数够 FAT32 才用大簇，否则（4GB 以下的卡）交给 FatFs 按容量自动选择 */
+    if (!(disk_initialize(pdrv) & STA_NOINIT) &&
+        disk_ioctl(pdrv, GET_SECTOR_COUNT, &sectors) == RES_OK &&
+        sectors / (SD_FORMAT_CLUSTER / SD_SECTOR_SIZE) >= SD_FORMAT_MIN_CLUSTERS)
+    {
+        au = SD_FORMAT_CLUSTER;
+    }
+    printf("SD format: %lu sectors, cluster %lu bytes\r\n", (unsigned long)sectors, (unsigned long)au);
+
+    f_mount(&USERFatFS, USERPath, 0);
+    FRESULT res = f_mkfs(USERPath, 0, au);
+    f_mount(NULL, USERPath, 0);
+    if (res != FR_OK)
+    {
+        printf("SD format: f_mkfs error=%d\r\n", res);
+        return res;
+    }
+
+    return SD_Card_Init();
+}
+
+void SD_Card_Deinit(void)
+{
+    if (s_logOpened)
+    {
+        SD_Card_Drain(1);
+    }
+    if (s_flashReady)
+    {
+        /* 离线或写卡出错时剩下的记录留在 Flash 里，下次上电再转存 */
+        SD_Card_QueueToFlash();
+        FlashLog_Flush();
     }
+    SD_Card_CloseLog();
+    SD_Card_ReleaseRead();
 
     /* 卸载文件系统 */
     f_mount(NULL, USERPath, 1);
@@ -0,0 +1,100 @@
+/*
+ * SD 日志的复位保护日志实现
+ * - s_jrnl 在 .noinit 段（链接脚本 STM32F103XX_FLASH.ld），编码状态 s_enc 在 .bss，
+ *   上电时由 SD_Journal_Open 从块里恢复
+ * - 魔数最后写、最先清，清空和开新块之间复位不会留下半个块
+ */
+
+#include "sdjournal.h"
+
+#include "logblock.h"
+#include "main.h"
+
+#define SD_JOURNAL_MAGIC    0x4C4E524AUL    /* "JRNL" */
+
+typedef struct
+{
+    uint32_t magic;
+    uint8_t  blk[LOG_BLOCK_SIZE];
+} SD_Journal_t;
+
+static SD_Journal_t s_jrnl NOINIT_RAM __attribute__((aligned(4)));
+static LogBlock_t   s_enc;              /* count 为 0 表示日志为空 */
+static uint8_t      s_replay = 0;       /* 正在取出复位前留下的记录 */
+static uint8_t      s_full = 0;
+
+uint16_t SD_Journal_Open(void)
+{
+    s_replay = 0;
+    s_full = 0;
+    if (s_jrnl.magic != SD_JOURNAL_MAGIC || LogBlock_Open(&s_enc, s_jrnl.blk) < 0)
+    {
+        SD_Journal_Clear();
+        return 0;
+    }
+
+    s_replay = 1;
+    return s_enc.count;
+}
+
+int SD_Journal_Next(LogRecord_t *rec)
+{
+    if (!s_replay)
+    {
+        return 0;
+    }
+    if (LogBlock_Next(&s_enc, rec))
+    {
+        return 1;
+    }
+
+    /* 全部取完后编码状态和 LogBlock_Resume 之后一样，新记录接着往里加；
+     * 中途解码出错时后面的位流接不上，只能清空 */
+    s_replay = 0;
+    if (s_enc.index != s_enc.count)
+    {
+        SD_Journal_Clear();
+    }
+    return 0;
+}
+
+int SD_Journal_Add(const LogRecord_t *rec)
+{
+    if (s_replay)
+    {
+        return 0;
+    }
+    if (s_full)
+    {
+        return -1;
+    }
+
+    if (s_enc.count == 0U)
+    {
+        LogBlock_Start(&s_enc, s_jrnl.blk, rec);
+    }
+    else if (LogBlock_Add(&s_enc, rec) != 0)
+    {
+        s_full = 1;
+        return -1;
+    }
+    LogBlock_Finish(&s_enc);
+    s_jrnl.magic = SD_JOURNAL_MAGIC;
+    return 0;
+}
+
+void SD_Journal_Clear(void)
+{
+    if (s_replay)
+    {
+        return;
+    }
+    s_jrnl.magic = 0;
+    s_enc.count = 0;
+    s_full = 0;
+}
+
+uint8_t SD_Journal_Full(void)
+{
+    return s_full;
+}
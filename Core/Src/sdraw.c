@@ -0,0 +1,297 @@
+/*
+ * SD 卡裸分区日志存储实现
+ * - 分区内扇区 0 为分区头，环形区从扇区 1 开始，共 s_blocks 块，序号 seq 的块在第 seq % s_blocks 块
+ * - s_batch 里攒着序号 [s_head - s_batchLen, s_head) 的写满的块，s_head 为正在编码的块
+ * - 读写都经 disk_read / disk_write，和 FatFs 共用驱动；缓冲区不是卷窗口，不经过元数据缓存
+ */
+
+#include "sdraw.h"
+
+#include "crc16.h"
+#include "fatfs.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SD_RAW_SECTOR_SIZE  512U
+#define SD_RAW_TRAILER_OFS  (LOG_BLOCK_SIZE - 2U - LOG_RAW_TRAILER)
+#define SD_RAW_PROBE        (SD_RAW_BATCH * 2U)     /* 开头连续检查的块数，覆盖掉电时没写完的一批 */
+
+/* MBR 分区表 */
+#define SD_MBR_TABLE        446U
+#define SD_MBR_ENTRY_SIZE   16U
+#define SD_MBR_ENTRIES      4U
+#define SD_MBR_SIG          510U
+
+static DWORD    s_base = 0;         /* 分区起始扇区（分区头） */
+static uint32_t s_blocks = 0;       /* 环形区块数 */
+static uint32_t s_gen = 0;
+static uint32_t s_head = 0;
+
+static uint8_t  s_batch[SD_RAW_BATCH][SD_RAW_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint8_t  s_batchLen = 0;
+
+/* 在 MBR 里找裸分区，返回 0 找到，-1 没有，-2 读卡错误 */
+static int SD_Raw_FindPartition(uint8_t *buf)
+{
+    if (disk_read(USERFatFS.drv, buf, 0, 1U) != RES_OK)
+    {
+        return -2;
+    }
+    if (buf[SD_MBR_SIG] != 0x55U || buf[SD_MBR_SIG + 1U] != 0xAAU)
+    {
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < SD_MBR_ENTRIES; i++)
+    {
+        const uint8_t *pe = &buf[SD_MBR_TABLE + i * SD_MBR_ENTRY_SIZE];
+        uint32_t start, count;
+
+        memcpy(&start, &pe[8], sizeof(start));
+        memcpy(&count, &pe[12], sizeof(count));
+        if (pe[4] == LOG_RAW_PART_TYPE && start != 0U && count > 2U)
+        {
+            s_base = start;
+            s_blocks = count - 1U;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* 分区头有效时取出 gen，否则写入新分区头。返回 0 成功，-2 读写卡错误 */
+static int SD_Raw_CheckHeader(const LogHeader_t *hdr, uint8_t *buf)
+{
+    LogHeader_t *old = (LogHeader_t *)buf;
+
+    if (disk_read(USERFatFS.drv, buf, s_base, 1U) != RES_OK)
+    {
+        return -2;
+    }
+    if (old->magic[0] == LOG_MAGIC0 && old->magic[1] == LOG_MAGIC1 &&
+        old->magic[2] == LOG_MAGIC2 && old->magic[3] == LOG_MAGIC3 &&
+        old->version == LOG_VERSION && old->record_size == LOG_RECORD_SIZE &&
+        old->crc == CRC16_Calc(old, LOG_HEADER_SIZE - 2U))
+    {
+        s_gen = old->gen;
+        return 0;
+    }
+
+    /* 新代号：旧分区头里的 gen（分区头坏了也照样取）加一再混入创建时间；
+     * 分区头被清掉、时钟又没校准时可能和上次相同，再避开环形区开头旧块的 gen */
+    s_gen = old->gen + 1U + hdr->created;
+    for (uint32_t pos = 0; pos < SD_RAW_PROBE && pos < s_blocks; pos++)
+    {
+        LogRawTrailer_t tr;
+        if (disk_read(USERFatFS.drv, buf, s_base + 1U + pos, 1U) != RES_OK)
+        {
+            return -2;
+        }
+        memcpy(&tr, &buf[SD_RAW_TRAILER_OFS], sizeof(tr));
+        if (tr.gen == s_gen)
+        {
+            s_gen++;
+            pos = (uint32_t)-1;     /* 换了代号，从头再查一遍 */
+        }
+    }
+
+    memcpy(buf, hdr, LOG_HEADER_SIZE);
+    old->gen = s_gen;
+    old->crc = CRC16_Calc(old, LOG_HEADER_SIZE - 2U);
+    printf("SD raw: new partition header, gen=%08lX\r\n", (unsigned long)s_gen);
+    return (disk_write(USERFatFS.drv, buf, s_base, 1U) == RES_OK) ? 0 : -2;
+}
+
+/* 读环形区第 pos 块：是本次格式化写入的、位置正确的块时返回 0 并给出序号，-1 无效，-2 读卡错误 */
+static int SD_Raw_ReadAt(uint32_t pos, uint8_t *buf, uint32_t *seq)
+{
+    LogRawTrailer_t tr;
+    uint16_t crc;
+
+    if (disk_read(USERFatFS.drv, buf, s_base + 1U + pos, 1U) != RES_OK)
+    {
+        return -2;
+    }
+    memcpy(&crc, &buf[LOG_BLOCK_SIZE - 2U], sizeof(crc));
+    memcpy(&tr, &buf[SD_RAW_TRAILER_OFS], sizeof(tr));
+    if (crc != CRC16_Calc(buf, LOG_BLOCK_SIZE - 2U) || tr.gen != s_gen || tr.seq % s_blocks != pos)
+    {
+        return -1;
+    }
+    *seq = tr.seq;
+    return 0;
+}
+
+/* 二分查找最后写入的块，找到时读进 buf 返回 1，分区为空返回 0，-2 读卡错误 */
+static int SD_Raw_FindHead(uint8_t *buf)
+{
+    uint32_t probe = (s_blocks < SD_RAW_PROBE) ? s_blocks : SD_RAW_PROBE;
+    uint32_t lo, hi, seq = 0, first;
+    int ret = -1;
+
+    /* 开头几块可能是掉电时没写完的一批，取第一个有效块定出它那一圈的起始序号 */
+    for (lo = 0; lo < probe && (ret = SD_Raw_ReadAt(lo, buf, &seq)) == -1; lo++)
+    {
+    }
+    if (ret != 0)
+    {
+        s_head = 0;
+        return (ret == -2) ? -2 : 0;
+    }
+    first = seq - lo;
+
+    /* lo 处条件成立，找最后一个成立的位置（不成立的是上一圈的旧块或空白） */
+    hi = s_blocks - 1U;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo + 1U) / 2U;
+        ret = SD_Raw_ReadAt(mid, buf, &seq);
+        if (ret == -2)
+        {
+            return -2;
+        }
+        if (ret == 0 && seq == first + mid)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1U;
+        }
+    }
+
+    s_head = first + lo;
+    return (SD_Raw_ReadAt(lo, buf, &seq) == 0) ? 1 : -2;
+}
+
+/* 把批量缓冲的前 n 块写卡，写到分区末尾时分两次 */
+static int SD_Raw_WriteBatch(uint8_t n)
+{
+    uint32_t seq = s_head - s_batchLen;
+    uint8_t done = 0;
+
+    while (done < n)
+    {
+        uint32_t pos = (seq + done) % s_blocks;
+        uint32_t cnt = n - done;
+        if (cnt > s_blocks - pos)
+        {
+            cnt = s_blocks - pos;
+        }
+
+        DRESULT res = disk_write(USERFatFS.drv, s_batch[done], s_base + 1U + pos, (UINT)cnt);
+        if (res != RES_OK)
+        {
+            printf("SD raw: write block %lu error=%d\r\n", (unsigned long)(seq + done), res);
+            s_batchLen = 0;
+            return res;
+        }
+        done = (uint8_t)(done + cnt);
+    }
+
+    s_batchLen = 0;
+    return 0;
+}
+
+int SD_Raw_Open(const LogHeader_t *hdr, uint8_t *last)
+{
+    s_batchLen = 0;
+    s_head = 0;
+
+    int ret = SD_Raw_FindPartition(last);
+    if (ret == 0)
+    {
+        ret = SD_Raw_CheckHeader(hdr, last);
+    }
+    if (ret == 0)
+    {
+        ret = SD_Raw_FindHead(last);
+    }
+
+    if (ret == -1)
+    {
+        printf("SD raw: no partition of type 0x%02X\r\n", LOG_RAW_PART_TYPE);
+    }
+    else if (ret < 0)
+    {
+        printf("SD raw: disk error\r\n");
+    }
+    else
+    {
+        printf("SD raw: partition at %lu, %lu blocks, head %lu\r\n",
+               (unsigned long)s_base, (unsigned long)s_blocks, (unsigned long)s_head);
+    }
+    return ret;
+}
+
+uint32_t SD_Raw_Head(void)
+{
+    return s_head;
+}
+
+uint32_t SD_Raw_First(void)
+{
+    /* 正在编码的块原地写出时会覆盖 s_head - s_blocks */
+    return (s_head >= s_blocks) ? s_head - s_blocks + 1U : 0U;
+}
+
+void SD_Raw_Stamp(uint8_t *blk)
+{
+    LogRawTrailer_t tr;
+
+    tr.seq = s_head;
+    tr.gen = s_gen;
+    memcpy(&blk[SD_RAW_TRAILER_OFS], &tr, sizeof(tr));
+}
+
+int SD_Raw_Write(const uint8_t *blk, uint8_t full)
+{
+    /* 批量缓冲满了就立即写出，这里总还有一个空位 */
+    memcpy(s_batch[s_batchLen], blk, SD_RAW_SECTOR_SIZE);
+    if (!full)
+    {
+        return SD_Raw_WriteBatch((uint8_t)(s_batchLen + 1U));
+    }
+
+    s_batchLen++;
+    s_head++;
+    return (s_batchLen >= SD_RAW_BATCH) ? SD_Raw_WriteBatch(s_batchLen) : 0;
+}
+
+int SD_Raw_Sync(void)
+{
+    return (s_batchLen != 0U) ? SD_Raw_WriteBatch(s_batchLen) : 0;
+}
+
+uint8_t SD_Raw_Batched(void)
+{
+    return s_batchLen;
+}
+
+int SD_Raw_Read(uint32_t seq, uint8_t *buf)
+{
+    uint32_t got;
+
+    if (seq < SD_Raw_First() || seq > s_head)
+    {
+        return -1;
+    }
+    if (s_head - seq <= s_batchLen && seq != s_head)
+    {
+        memcpy(buf, s_batch[s_batchLen - (s_head - seq)], SD_RAW_SECTOR_SIZE);
+        return 0;
+    }
+
+    int ret = SD_Raw_ReadAt(seq % s_blocks, buf, &got);
+    if (ret == -2)
+    {
+        return RES_ERROR;
+    }
+    return (ret == 0 && got == seq) ? 0 : -1;
+}
+
+void SD_Raw_Close(void)
+{
+    SD_Raw_Sync();
+    disk_ioctl(USERFatFS.drv, CTRL_SYNC, NULL);
+}
@@ -29,6 +29,8 @@
 #include <time.h>
 #include <sys/time.h>
 #include <sys/times.h>
+#include "uarttx.h"
+#include "usbcdc.h"
 
 
 /* Variables */
@@ -77,15 +79,14 @@ __attribute__((weak)) int _read(int file, char *ptr, int len)
   return len;
 }
 
+/* printf 的输出整段放进 USART1 发送环形缓冲（uarttx.h），由 DMA 在后台发出，不等发完；
+   USB 虚拟串口打开时同时输出一份（usbcdc.h） */
 __attribute__((weak)) int _write(int file, char *ptr, int len)
 {
   (void)file;
-  int DataIdx;
 
-  for (DataIdx = 0; DataIdx < len; DataIdx++)
-  {
-    __io_putchar(*ptr++);
-  }
+  UartTx_Write((const uint8_t *)ptr, (uint16_t)len);
+  USB_CDC_Write((const uint8_t *)ptr, (uint16_t)len);
   return len;
 }
 
@@ -0,0 +1,178 @@
+/*
+ * 实时遥测实现
+ * - 采样帧和通道表帧都由 g_logChannels（logchan.c）生成，与 SD 卡日志共用一张表
+ * - 帧先拼在 s_raw 里算 CRC，再 COBS 编码进 s_frame，整帧一次写进 USART1 和 USB 的发送缓冲
+ * - 文字格式同样按表输出，定点值用整数格式化，小数位数由 scale 决定
+ */
+
+#include "telemetry.h"
+
+#include "logchan.h"
+#include "logrec.h"
+#include "crc16.h"
+#include "sdcard.h"
+#include "uarttx.h"
+#include "usbcdc.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TELEM_SCHEMA_ITEM   15U     /* 名称 8 + 单位 4 + 类型 1 + scale 2 */
+#define TELEM_RAW_MAX       (3U + TELEM_CHANNELS * TELEM_SCHEMA_ITEM + 2U)
+/* COBS 每 254 字节多一个码字节，再加前后两个 0x00 */
+#define TELEM_FRAME_MAX     (TELEM_RAW_MAX + TELEM_RAW_MAX / 254U + 1U + 2U)
+
+static uint8_t  s_raw[TELEM_RAW_MAX];
+static uint8_t  s_frame[TELEM_FRAME_MAX];
+static uint16_t s_seq = 0;
+static uint8_t  s_mode = TELEM_MODE_DEFAULT;
+
+/* 追加 CRC16，COBS 编码进 s_frame 并发出 */
+static void Telemetry_Emit(uint16_t len)
+{
+    uint16_t crc = CRC16_Calc(s_raw, len);
+    s_raw[len++] = (uint8_t)crc;
+    s_raw[len++] = (uint8_t)(crc >> 8);
+
+    uint16_t out = 0;
+    s_frame[out++] = 0x00U;
+
+    uint16_t codePos = out++;
+    uint8_t code = 1;
+    for (uint16_t i = 0; i < len; i++)
+    {
+        if (s_raw[i] == 0x00U)
+        {
+            s_frame[codePos] = code;
+            codePos = out++;
+            code = 1;
+            continue;
+        }
+        s_frame[out++] = s_raw[i];
+        code++;
+        if (code == 0xFFU)
+        {
+            s_frame[codePos] = code;
+            codePos = out++;
+            code = 1;
+        }
+    }
+    s_frame[codePos] = code;
+    s_frame[out++] = 0x00U;
+
+    UartTx_Write(s_frame, out);
+    USB_CDC_Write(s_frame, out);
+}
+
+static void Telemetry_SendText(const float *val)
+{
+    char line[80];
+    int n = 0;
+
+    for (uint8_t i = 0; i < TELEM_CHANNELS; i++)
+    {
+        const LogChannel_t *ch = &g_logChannels[i].desc;
+        uint8_t flags = 0;
+        int32_t r = LogChan_Fixed(i, val[i], &flags);
+        uint32_t a = (uint32_t)((r < 0) ? -r : r);
+        const char *sign = (r < 0) ? "-" : "";
+
+        n += snprintf(&line[n], sizeof(line) - (size_t)n, "%s%s=", (i != 0U) ? ";" : "", ch->name);
+        if (ch->scale >= 100U)
+        {
+            n += snprintf(&line[n], sizeof(line) - (size_t)n, "%s%lu.%02lu", sign,
+                          (unsigned long)(a / ch->scale), (unsigned long)(a % ch->scale));
+        }
+        else if (ch->scale >= 10U)
+        {
+            n += snprintf(&line[n], sizeof(line) - (size_t)n, "%s%lu.%lu", sign,
+                          (unsigned long)(a / ch->scale), (unsigned long)(a % ch->scale));
+        }
+        else
+        {
+            n += snprintf(&line[n], sizeof(line) - (size_t)n, "%s%lu", sign, (unsigned long)a);
+        }
+    }
+    n += snprintf(&line[n], sizeof(line) - (size_t)n, "\r\n");
+
+    UartTx_Write((const uint8_t *)line, (uint16_t)n);
+    USB_CDC_Write((const uint8_t *)line, (uint16_t)n);
+}
+
+void Telemetry_Init(void)
+{
+    if (s_mode == TELEM_MODE_BIN)
+    {
+        Telemetry_SendSchema();
+    }
+}
+
+void Telemetry_Send(const float *val)
+{
+    if (s_mode == TELEM_MODE_TEXT)
+    {
+        Telemetry_SendText(val);
+        return;
+    }
+
+    uint32_t ts = SD_Card_GetTime();
+    uint8_t flags = SD_Card_TimeSet() ? 0U : LOG_FLAG_TIME_UNSET;
+    uint16_t n = 0;
+
+    s_raw[n++] = TELEM_TYPE_SAMPLE;
+    s_raw[n++] = TELEM_VERSION;
+    s_raw[n++] = (uint8_t)s_seq;
+    s_raw[n++] = (uint8_t)(s_seq >> 8);
+    s_raw[n++] = (uint8_t)ts;
+    s_raw[n++] = (uint8_t)(ts >> 8);
+    s_raw[n++] = (uint8_t)(ts >> 16);
+    s_raw[n++] = (uint8_t)(ts >> 24);
+    uint16_t flagsPos = n++;
+    s_raw[n++] = TELEM_CHANNELS;
+    for (uint8_t i = 0; i < TELEM_CHANNELS; i++)
+    {
+        /* i16 和 u16 都按低 16 位存，上位机按类型解释 */
+        uint16_t r = (uint16_t)LogChan_Fixed(i, val[i], &flags);
+        s_raw[n++] = (uint8_t)r;
+        s_raw[n++] = (uint8_t)(r >> 8);
+    }
+    s_raw[flagsPos] = flags;
+    s_seq++;
+
+    Telemetry_Emit(n);
+}
+
+void Telemetry_SendSchema(void)
+{
+    uint16_t n = 0;
+
+    s_raw[n++] = TELEM_TYPE_SCHEMA;
+    s_raw[n++] = TELEM_VERSION;
+    s_raw[n++] = TELEM_CHANNELS;
+    for (uint8_t i = 0; i < TELEM_CHANNELS; i++)
+    {
+        const LogChannel_t *ch = &g_logChannels[i].desc;
+        memcpy(&s_raw[n], ch->name, sizeof(ch->name));
+        n += sizeof(ch->name);
+        memcpy(&s_raw[n], ch->unit, sizeof(ch->unit));
+        n += sizeof(ch->unit);
+        s_raw[n++] = ch->type;
+        s_raw[n++] = (uint8_t)ch->scale;
+        s_raw[n++] = (uint8_t)(ch->scale >> 8);
+    }
+
+    Telemetry_Emit(n);
+}
+
+void Telemetry_SetMode(uint8_t mode)
+{
+    s_mode = (mode == TELEM_MODE_TEXT) ? TELEM_MODE_TEXT : TELEM_MODE_BIN;
+    if (s_mode == TELEM_MODE_BIN)
+    {
+        Telemetry_SendSchema();
+    }
+}
+
+uint8_t Telemetry_GetMode(void)
+{
+    return s_mode;
+}
@@ -9,7 +9,7 @@
  *   1. 准备几种已知浊度的溶液（例如 0 NTU、50 NTU、100 NTU、200 NTU …）
  *   2. 在 25℃ 左右，记录每种溶液对应的电压 U (V25)
  *   3. 以 TU 为纵轴、U 为横轴做拟合，得到线性关系 TU = -865.68 * U + K
- *   4. 将拟合出来的 K 写入 main.c 中的 K 变量，或保存在 Flash 里
+ *   4. 将拟合出来的 K 用串口命令 "#CAL TURB <K>" 写入（main.c 的 g_turbK，默认值 APP_TURB_K），或保存在 Flash 里
  */
 
 #include "turbidity.h"
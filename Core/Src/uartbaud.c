@@ -0,0 +1,126 @@
+/*
+ * USART1 波特率协商实现
+ * - 切换只在发送空闲时进行（UartTx_Busy 为 0，最后一个字节已移出），
+ *   之前排队的回复和遥测都按旧波特率发完
+ * - 接收错误中断里只更新 s_errors，状态只在主循环（UartBaud_Poll、命令处理）里改
+ */
+
+#include "uartbaud.h"
+
+#include "uarttx.h"
+#include "usart.h"
+
+typedef enum
+{
+    UART_BAUD_IDLE = 0,     /* 默认波特率 */
+    UART_BAUD_SWITCH,       /* 等发送空闲后切到 s_target */
+    UART_BAUD_CONFIRM,      /* 已切换，等 #BAUD OK */
+    UART_BAUD_ACTIVE,       /* 已确认 */
+    UART_BAUD_FALLBACK,     /* 等发送空闲后退回默认波特率 */
+} UartBaud_State_t;
+
+static UartBaud_State_t s_state = UART_BAUD_IDLE;
+static uint32_t s_target = UART_BAUD_DEFAULT;
+static uint32_t s_switchTick = 0;
+static volatile uint32_t s_lastRx = 0;
+static volatile uint8_t  s_errors = 0;
+
+static void UartBaud_Set(uint32_t rate)
+{
+    huart1.Init.BaudRate = rate;
+    huart1.Instance->BRR = UART_BRR_SAMPLING16(HAL_RCC_GetPCLK2Freq(), rate);
+}
+
+int UartBaud_Request(uint32_t rate)
+{
+    uint32_t pclk = HAL_RCC_GetPCLK2Freq();
+
+    if (rate < 9600U || rate > UART_BAUD_MAX || rate > pclk / 16U)
+    {
+        return -1;
+    }
+    uint32_t brr = UART_BRR_SAMPLING16(pclk, rate);
+    uint64_t actual = (uint64_t)brr * rate;     /* 实际波特率 = pclk / brr */
+    uint64_t diff = (actual > pclk) ? (actual - pclk) : (pclk - actual);
+    if (diff * 1000U > (uint64_t)pclk * UART_BAUD_TOLERANCE)
+    {
+        return -1;
+    }
+
+    s_target = rate;
+    s_state = UART_BAUD_SWITCH;
+    return 0;
+}
+
+uint8_t UartBaud_Confirm(void)
+{
+    if (s_state != UART_BAUD_CONFIRM)
+    {
+        return 0;
+    }
+    s_state = UART_BAUD_ACTIVE;
+    return 1;
+}
+
+void UartBaud_Alive(void)
+{
+    s_lastRx = HAL_GetTick();
+    s_errors = 0;
+}
+
+void UartBaud_RxError(void)
+{
+    if (s_errors < 0xFFU)
+    {
+        s_errors++;
+    }
+}
+
+void UartBaud_Poll(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    switch (s_state)
+    {
+        case UART_BAUD_SWITCH:
+            if (!UartTx_Busy())
+            {
+                UartBaud_Set(s_target);
+                s_switchTick = now;
+                s_lastRx = now;
+                s_errors = 0;
+                s_state = (s_target == UART_BAUD_DEFAULT) ? UART_BAUD_IDLE : UART_BAUD_CONFIRM;
+            }
+            break;
+
+        case UART_BAUD_CONFIRM:
+            if ((now - s_switchTick) >= UART_BAUD_CONFIRM_MS || s_errors >= UART_BAUD_ERR_MAX)
+            {
+                s_state = UART_BAUD_FALLBACK;
+            }
+            break;
+
+        case UART_BAUD_ACTIVE:
+            if ((now - s_lastRx) >= UART_BAUD_IDLE_MS || s_errors >= UART_BAUD_ERR_MAX)
+            {
+                s_state = UART_BAUD_FALLBACK;
+            }
+            break;
+
+        case UART_BAUD_FALLBACK:
+            if (!UartTx_Busy())
+            {
+                UartBaud_Set(UART_BAUD_DEFAULT);
+                s_state = UART_BAUD_IDLE;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+uint32_t UartBaud_Get(void)
+{
+    return huart1.Init.BaudRate;
+}
@@ -0,0 +1,170 @@
+/*
+ * USART1 发送环形缓冲实现
+ * - s_head 只在主循环里前移（写入），s_tail 只在发送完成中断里前移（发完），
+ *   各改各的，不用关中断
+ * - DMA 由 s_busy 的持有者启动：主循环写完后、中断发完一段后都去抢这个标志
+ *   （LDREXB/STREXB），抢到的一方启动下一段，没抢到说明已经在发了
+ * - DMA 发完后 HAL 等 USART 的 TC 中断（最后一个字节移出）才回调，这时 gState 已回到
+ *   READY，可以直接启动下一段
+ * - 一段只发环形缓冲里连续的部分，绕回开头的数据下一段再发
+ * - DMA 发送出错时 HAL 中止发送、gState 回到 READY，不会再有发送完成回调；
+ *   UartTx_Error 把这一段当作发完（数据丢弃），放开 s_busy 接着发后面的
+ */
+
+#include "uarttx.h"
+
+#include "usart.h"
+#include <string.h>
+
+static uint8_t  s_ring[UART_TX_RING];
+static volatile uint16_t s_head = 0;    /* 自由计数，对 UART_TX_RING 取模得位置 */
+static volatile uint16_t s_tail = 0;
+static volatile uint8_t s_busy = 0;     /* 有一段正在发送，或正在启动 */
+static uint8_t  s_zeroCopy = 0;         /* 正在发的是 UartTx_Send 的缓冲 */
+static uint16_t s_txLen = 0;
+
+__weak void UartTx_TxCpltCallback(void)
+{
+}
+
+/* 抢发送权，返回 1 抢到 */
+static uint8_t UartTx_Claim(void)
+{
+    do
+    {
+        if (__LDREXB(&s_busy) != 0U)
+        {
+            __CLREX();
+            return 0;
+        }
+    } while (__STREXB(1U, &s_busy) != 0U);
+    return 1;
+}
+
+/* 有数据且没在发送时启动 DMA 发送环形缓冲里连续的一段 */
+static void UartTx_Kick(void)
+{
+    if (!UartTx_Claim())
+    {
+        return;
+    }
+
+    uint16_t used = (uint16_t)(s_head - s_tail);
+    if (used == 0U)
+    {
+        s_busy = 0;
+        return;
+    }
+    uint16_t pos = (uint16_t)(s_tail % UART_TX_RING);
+    uint16_t len = (uint16_t)(UART_TX_RING - pos);
+    if (len > used)
+    {
+        len = used;
+    }
+
+    s_zeroCopy = 0;
+    s_txLen = len;
+    if (HAL_UART_Transmit_DMA(&huart1, &s_ring[pos], len) != HAL_OK)
+    {
+        s_busy = 0;     /* 下次写入时再试 */
+    }
+}
+
+/* 一段结束（发完或出错中止）：释放这一段，启动下一段。中断里调用 */
+static void UartTx_Done(void)
+{
+    if (s_zeroCopy)
+    {
+        s_zeroCopy = 0;
+        s_busy = 0;
+        UartTx_TxCpltCallback();
+    }
+    else
+    {
+        s_tail = (uint16_t)(s_tail + s_txLen);
+        s_busy = 0;
+    }
+    UartTx_Kick();
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart != &huart1 || !s_busy)
+    {
+        return;
+    }
+    UartTx_Done();
+}
+
+void UartTx_Error(void)
+{
+    /* 接收出错也走同一个回调，只有发送 DMA 出错（gState 已回到 READY）才处理 */
+    if (!s_busy || huart1.gState != HAL_UART_STATE_READY ||
+        (huart1.ErrorCode & HAL_UART_ERROR_DMA) == 0U)
+    {
+        return;
+    }
+    UartTx_Done();
+}
+
+void UartTx_Write(const uint8_t *buf, uint16_t len)
+{
+    if (__get_IPSR() != 0U)
+    {
+        return;
+    }
+    uint8_t canWait = (UART_TX_OVERFLOW == UART_TX_BLOCK && __get_PRIMASK() == 0U) ? 1U : 0U;
+
+    while (len > 0U)
+    {
+        uint16_t space = (uint16_t)(UART_TX_RING - (uint16_t)(s_head - s_tail));
+        if (space == 0U)
+        {
+            if (!canWait)
+            {
+                return;
+            }
+            UartTx_Kick();
+            continue;
+        }
+
+        uint16_t pos = (uint16_t)(s_head % UART_TX_RING);
+        uint16_t n = (uint16_t)(UART_TX_RING - pos);
+        if (n > space)
+        {
+            n = space;
+        }
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(&s_ring[pos], buf, n);
+        __DMB();    /* 数据先写进缓冲，再移动 s_head */
+        s_head = (uint16_t)(s_head + n);
+        buf += n;
+        len -= n;
+    }
+    UartTx_Kick();
+}
+
+int UartTx_Send(const uint8_t *buf, uint16_t len)
+{
+    if (s_head != s_tail || !UartTx_Claim())
+    {
+        return -1;
+    }
+
+    s_zeroCopy = 1;
+    if (HAL_UART_Transmit_DMA(&huart1, buf, len) != HAL_OK)
+    {
+        s_zeroCopy = 0;
+        s_busy = 0;
+        return -1;
+    }
+    return 0;
+}
+
+uint8_t UartTx_Busy(void)
+{
+    return (s_busy || s_head != s_tail) ? 1U : 0U;
+}
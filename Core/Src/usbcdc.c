@@ -0,0 +1,614 @@
+/*
+ * USB 虚拟串口（CDC-ACM）实现
+ * - HAL_PCD_xxxCallback 在 USB 中断里调用，这里处理控制端点的标准请求和 CDC 类请求，
+ *   以及 0x81 / 0x01 两个批量端点
+ * - F1 的 HAL 对控制端点每发完一个包就回调一次，描述符超过 64 字节时在
+ *   HAL_PCD_DataInStageCallback 里接着发下一包；批量端点的多包传输由 HAL 在中断里完成
+ * - 一次批量发送的长度正好是 64 的整数倍时补发一个空包，主机才知道这次传输结束
+ * - 主循环和中断共用的发送状态，在主循环里改动时关掉 USB 中断
+ */
+
+#include "usbcdc.h"
+
+#include "usb.h"
+
+#define CDC_IN_EP           0x81U
+#define CDC_OUT_EP          0x01U
+#define CDC_CMD_EP          0x82U
+#define CDC_CMD_PACKET_SIZE 8U
+
+/* 端点缓冲区在 PMA（USB 专用 512 字节 RAM）里的位置，前 0x18 字节是 3 个端点的缓冲区描述表 */
+#define PMA_EP0_OUT         0x18U
+#define PMA_EP0_IN          0x58U
+#define PMA_CDC_IN          0x98U
+#define PMA_CDC_OUT         0xD8U
+#define PMA_CDC_CMD         0x118U
+
+/* 标准请求 */
+#define REQ_GET_STATUS          0x00U
+#define REQ_CLEAR_FEATURE       0x01U
+#define REQ_SET_FEATURE         0x03U
+#define REQ_SET_ADDRESS         0x05U
+#define REQ_GET_DESCRIPTOR      0x06U
+#define REQ_GET_CONFIGURATION   0x08U
+#define REQ_SET_CONFIGURATION   0x09U
+#define REQ_GET_INTERFACE       0x0AU
+#define REQ_SET_INTERFACE       0x0BU
+
+/* CDC 类请求 */
+#define CDC_SET_LINE_CODING         0x20U
+#define CDC_GET_LINE_CODING         0x21U
+#define CDC_SET_CONTROL_LINE_STATE  0x22U
+#define CDC_SEND_BREAK              0x23U
+
+#define DESC_DEVICE         0x01U
+#define DESC_CONFIG         0x02U
+#define DESC_STRING         0x03U
+
+/* 控制传输阶段 */
+#define EP0_IDLE            0U
+#define EP0_DATA_IN         1U      /* 正在发数据 */
+#define EP0_DATA_OUT        2U      /* 正在收数据（SET_LINE_CODING） */
+#define EP0_STATUS_IN       3U      /* 状态阶段，发空包 */
+#define EP0_STATUS_OUT      4U      /* 状态阶段，收空包 */
+
+#define CDC_CONFIG_DESC_SIZE    67U
+#define CDC_STRING_MAX          32U     /* 字符串描述符最多字符数 */
+
+static const uint8_t s_devDesc[18] =
+{
+    18, DESC_DEVICE,
+    0x00, 0x02,                 /* USB 2.0 */
+    0x02, 0x00, 0x00,           /* CDC 设备 */
+    64,                         /* EP0 包长 */
+    (uint8_t)(USB_CDC_VID & 0xFFU), (uint8_t)(USB_CDC_VID >> 8),
+    (uint8_t)(USB_CDC_PID & 0xFFU), (uint8_t)(USB_CDC_PID >> 8),
+    0x00, 0x02,                 /* 设备版本 2.00 */
+    1, 2, 3,                    /* 厂商、产品、序列号字符串 */
+    1                           /* 配置数 */
+};
+
+static const uint8_t s_cfgDesc[CDC_CONFIG_DESC_SIZE] =
+{
+    /* 配置 */
+    9, DESC_CONFIG, CDC_CONFIG_DESC_SIZE, 0x00, 2, 1, 0, 0x80, 50,     /* 总线供电 100mA */
+
+    /* 接口 0：通信类，带一个中断端点 */
+    9, 0x04, 0, 0, 1, 0x02, 0x02, 0x01, 0,
+    5, 0x24, 0x00, 0x10, 0x01,                  /* Header，CDC 1.10 */
+    5, 0x24, 0x01, 0x00, 1,                     /* Call Management，数据接口为 1 */
+    4, 0x24, 0x02, 0x02,                        /* ACM：支持线路设置和控制线状态 */
+    5, 0x24, 0x06, 0, 1,                        /* Union：主接口 0，从接口 1 */
+    7, 0x05, CDC_CMD_EP, 0x03, CDC_CMD_PACKET_SIZE, 0x00, 16,
+
+    /* 接口 1：数据类，两个批量端点 */
+    9, 0x04, 1, 0, 2, 0x0A, 0x00, 0x00, 0,
+    7, 0x05, CDC_OUT_EP, 0x02, USB_CDC_PACKET_SIZE, 0x00, 0,
+    7, 0x05, CDC_IN_EP, 0x02, USB_CDC_PACKET_SIZE, 0x00, 0
+};
+
+static const uint8_t s_langDesc[4] = { 4, DESC_STRING, 0x09, 0x04 };   /* 英语（美国） */
+
+static uint8_t  s_strDesc[2 + 2 * CDC_STRING_MAX];
+
+/* 控制传输 */
+static uint8_t  s_ep0State = EP0_IDLE;
+static const uint8_t *s_ep0Ptr;
+static uint16_t s_ep0Rem = 0;
+static uint8_t  s_ep0Zlp = 0;
+static uint8_t  s_ep0Buf[8] __attribute__((aligned(4)));
+
+/* 线路设置：波特率（u32）、停止位、校验、数据位，只保存给上位机回读 */
+static uint8_t  s_lineCoding[7] __attribute__((aligned(4))) = { 0x00, 0xC2, 0x01, 0x00, 0, 0, 8 };
+
+static volatile uint8_t s_config = 0;   /* 已配置 */
+static volatile uint8_t s_dtr = 0;      /* 上位机打开了端口 */
+
+/* 发送 */
+static uint8_t  s_ring[USB_CDC_TX_RING];
+static volatile uint16_t s_head = 0;    /* 主循环写入，自由计数 */
+static volatile uint16_t s_tail = 0;    /* 中断里发完后前移 */
+static volatile uint8_t s_txBusy = 0;
+static uint8_t  s_txZeroCopy = 0;       /* 正在发的是 USB_CDC_Send 的缓冲 */
+static uint8_t  s_txZlp = 0;            /* 发完后补一个空包 */
+static uint16_t s_txLen = 0;
+
+/* 接收 */
+static uint8_t  s_rxPkt[USB_CDC_PACKET_SIZE] __attribute__((aligned(4)));
+
+__weak void USB_CDC_TxCpltCallback(void)
+{
+}
+
+__weak void USB_CDC_RxCallback(const uint8_t *data, uint16_t len)
+{
+    (void)data;
+    (void)len;
+}
+
+/* ---------------- 控制端点 ---------------- */
+
+static void USB_CDC_Ep0Stall(void)
+{
+    HAL_PCD_EP_SetStall(&hpcd_USB_FS, 0x80U);
+    HAL_PCD_EP_SetStall(&hpcd_USB_FS, 0x00U);
+    s_ep0State = EP0_IDLE;
+}
+
+/* 状态阶段：回一个空包 */
+static void USB_CDC_Ep0Status(void)
+{
+    s_ep0State = EP0_STATUS_IN;
+    HAL_PCD_EP_Transmit(&hpcd_USB_FS, 0x80U, NULL, 0);
+}
+
+static void USB_CDC_Ep0Next(void)
+{
+    uint16_t n = (s_ep0Rem > 64U) ? 64U : s_ep0Rem;
+    HAL_PCD_EP_Transmit(&hpcd_USB_FS, 0x80U, (uint8_t *)s_ep0Ptr, n);
+    s_ep0Ptr += n;
+    s_ep0Rem -= n;
+}
+
+/* 数据阶段：发 len 字节，超过主机要的 wLength 截断；比 wLength 短且正好整包时补空包 */
+static void USB_CDC_Ep0Send(const uint8_t *data, uint16_t len, uint16_t wLength)
+{
+    if (len > wLength)
+    {
+        len = wLength;
+    }
+    s_ep0Ptr = data;
+    s_ep0Rem = len;
+    s_ep0Zlp = (len < wLength && (len % 64U) == 0U) ? 1U : 0U;
+    s_ep0State = EP0_DATA_IN;
+    USB_CDC_Ep0Next();
+}
+
+/* ASCII 字符串转成 UTF-16 字符串描述符 */
+static const uint8_t *USB_CDC_StringDesc(const char *s)
+{
+    uint8_t n = 0;
+    while (s[n] != '\0' && n < CDC_STRING_MAX)
+    {
+        s_strDesc[2U + 2U * n] = (uint8_t)s[n];
+        s_strDesc[3U + 2U * n] = 0;
+        n++;
+    }
+    s_strDesc[0] = (uint8_t)(2U + 2U * n);
+    s_strDesc[1] = DESC_STRING;
+    return s_strDesc;
+}
+
+/* 序列号用芯片 96 位唯一 ID，同时插几块板时上位机也能区分 */
+static const uint8_t *USB_CDC_SerialDesc(void)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char serial[25];
+    const uint8_t *uid = (const uint8_t *)UID_BASE;
+
+    for (uint8_t i = 0; i < 12U; i++)
+    {
+        serial[2U * i] = hex[uid[i] >> 4];
+        serial[2U * i + 1U] = hex[uid[i] & 0x0FU];
+    }
+    serial[24] = '\0';
+    return USB_CDC_StringDesc(serial);
+}
+
+static void USB_CDC_GetDescriptor(uint16_t wValue, uint16_t wLength)
+{
+    const uint8_t *desc = NULL;
+    uint16_t len = 0;
+
+    switch (wValue >> 8)
+    {
+        case DESC_DEVICE:
+            desc = s_devDesc;
+            len = sizeof(s_devDesc);
+            break;
+        case DESC_CONFIG:
+            desc = s_cfgDesc;
+            len = sizeof(s_cfgDesc);
+            break;
+        case DESC_STRING:
+            switch (wValue & 0xFFU)
+            {
+                case 0:
+                    desc = s_langDesc;
+                    break;
+                case 1:
+                    desc = USB_CDC_StringDesc("STMicroelectronics");
+                    break;
+                case 2:
+                    desc = USB_CDC_StringDesc("Water Quality Monitor");
+                    break;
+                case 3:
+                    desc = USB_CDC_SerialDesc();
+                    break;
+                default:
+                    break;
+            }
+            if (desc != NULL)
+            {
+                len = desc[0];
+            }
+            break;
+        default:
+            break;      /* 只支持全速，DEVICE_QUALIFIER 等一律 STALL */
+    }
+
+    if (desc == NULL)
+    {
+        USB_CDC_Ep0Stall();
+        return;
+    }
+    USB_CDC_Ep0Send(desc, len, wLength);
+}
+
+/* ---------------- 批量端点 ---------------- */
+
+/* 开始发送环形缓冲里的数据（在中断里或关中断后调用） */
+static void USB_CDC_TxKick(void)
+{
+    if (s_txBusy || !s_config)
+    {
+        return;
+    }
+
+    uint16_t used = (uint16_t)(s_head - s_tail);
+    if (used == 0U)
+    {
+        return;
+    }
+    uint16_t pos = (uint16_t)(s_tail % USB_CDC_TX_RING);
+    uint16_t len = (uint16_t)(USB_CDC_TX_RING - pos);
+    if (len > used)
+    {
+        len = used;
+    }
+
+    s_txBusy = 1;
+    s_txZeroCopy = 0;
+    s_txLen = len;
+    s_txZlp = ((len % USB_CDC_PACKET_SIZE) == 0U) ? 1U : 0U;
+    HAL_PCD_EP_Transmit(&hpcd_USB_FS, CDC_IN_EP, &s_ring[pos], len);
+}
+
+/* 丢弃没发出的数据；正在发的是 USB_CDC_Send 的缓冲时通知使用者。
+ * abort 为 0 时不动端点寄存器（总线复位后它们已清零，再写会把 0 号地址的端点打开） */
+static void USB_CDC_TxFlush(uint8_t abort)
+{
+    uint8_t zeroCopy = (s_txBusy && s_txZeroCopy) ? 1U : 0U;
+
+    if (s_txBusy && abort)
+    {
+        /* 端点设为 NAK；清掉 HAL 里剩余的长度，已发出的包的中断到来时不会再续发 */
+        hpcd_USB_FS.IN_ep[CDC_IN_EP & 0x7FU].xfer_len = 0;
+        HAL_PCD_EP_Abort(&hpcd_USB_FS, CDC_IN_EP);
+    }
+    s_txBusy = 0;
+    s_txZeroCopy = 0;
+    s_txZlp = 0;
+    s_tail = s_head;
+    if (zeroCopy)
+    {
+        USB_CDC_TxCpltCallback();
+    }
+}
+
+static void USB_CDC_Configure(uint8_t config)
+{
+    if (config == s_config)
+    {
+        return;
+    }
+
+    if (config)
+    {
+        HAL_PCD_EP_Open(&hpcd_USB_FS, CDC_IN_EP, USB_CDC_PACKET_SIZE, EP_TYPE_BULK);
+        HAL_PCD_EP_Open(&hpcd_USB_FS, CDC_OUT_EP, USB_CDC_PACKET_SIZE, EP_TYPE_BULK);
+        HAL_PCD_EP_Open(&hpcd_USB_FS, CDC_CMD_EP, CDC_CMD_PACKET_SIZE, EP_TYPE_INTR);
+        HAL_PCD_EP_Receive(&hpcd_USB_FS, CDC_OUT_EP, s_rxPkt, USB_CDC_PACKET_SIZE);
+        s_config = 1;
+    }
+    else
+    {
+        s_dtr = 0;
+        USB_CDC_TxFlush(1);
+        s_config = 0;
+        HAL_PCD_EP_Close(&hpcd_USB_FS, CDC_IN_EP);
+        HAL_PCD_EP_Close(&hpcd_USB_FS, CDC_OUT_EP);
+        HAL_PCD_EP_Close(&hpcd_USB_FS, CDC_CMD_EP);
+    }
+}
+
+/* ---------------- HAL 回调 ---------------- */
+
+void HAL_PCD_ResetCallback(PCD_HandleTypeDef *hpcd)
+{
+    /* 总线复位后端点寄存器都已清零，只需要丢掉软件里的状态 */
+    s_dtr = 0;
+    USB_CDC_TxFlush(0);
+    s_config = 0;
+    s_ep0State = EP0_IDLE;
+
+    HAL_PCD_EP_Open(hpcd, 0x00U, 64U, EP_TYPE_CTRL);
+    HAL_PCD_EP_Open(hpcd, 0x80U, 64U, EP_TYPE_CTRL);
+}
+
+void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd)
+{
+    const uint8_t *req = (const uint8_t *)hpcd->Setup;
+    uint8_t  type = req[0] & 0x60U;
+    uint8_t  request = req[1];
+    uint16_t wValue = (uint16_t)(req[2] | (req[3] << 8));
+    uint16_t wIndex = (uint16_t)(req[4] | (req[5] << 8));
+    uint16_t wLength = (uint16_t)(req[6] | (req[7] << 8));
+
+    s_ep0State = EP0_IDLE;
+
+    if (type == 0x20U)
+    {
+        /* CDC 类请求 */
+        switch (request)
+        {
+            case CDC_SET_LINE_CODING:
+                if (wLength != sizeof(s_lineCoding))
+                {
+                    USB_CDC_Ep0Stall();
+                    return;
+                }
+                s_ep0State = EP0_DATA_OUT;
+                HAL_PCD_EP_Receive(hpcd, 0x00U, s_lineCoding, sizeof(s_lineCoding));
+                return;
+            case CDC_GET_LINE_CODING:
+                USB_CDC_Ep0Send(s_lineCoding, sizeof(s_lineCoding), wLength);
+                return;
+            case CDC_SET_CONTROL_LINE_STATE:
+                s_dtr = (uint8_t)(wValue & 0x01U);
+                if (!s_dtr)
+                {
+                    USB_CDC_TxFlush(1);     /* 上位机关了端口，不会再来取数据 */
+                }
+                USB_CDC_Ep0Status();
+                return;
+            case CDC_SEND_BREAK:
+                USB_CDC_Ep0Status();
+                return;
+            default:
+                USB_CDC_Ep0Stall();
+                return;
+        }
+    }
+    if (type != 0x00U)
+    {
+        USB_CDC_Ep0Stall();
+        return;
+    }
+
+    switch (request)
+    {
+        case REQ_GET_STATUS:
+            s_ep0Buf[0] = 0;
+            s_ep0Buf[1] = 0;
+            if ((req[0] & 0x1FU) == 0x02U && (wIndex & 0x7FU) != 0U)
+            {
+                PCD_EPTypeDef *ep = (wIndex & 0x80U) ? &hpcd->IN_ep[wIndex & 0x7FU]
+                                                     : &hpcd->OUT_ep[wIndex & 0x7FU];
+                s_ep0Buf[0] = ep->is_stall;
+            }
+            USB_CDC_Ep0Send(s_ep0Buf, 2, wLength);
+            break;
+
+        case REQ_CLEAR_FEATURE:
+        case REQ_SET_FEATURE:
+            /* 只有端点 HALT 有意义，设备远程唤醒不支持，直接应答 */
+            if ((req[0] & 0x1FU) == 0x02U && wValue == 0U && (wIndex & 0x7FU) != 0U)
+            {
+                if (request == REQ_SET_FEATURE)
+                {
+                    HAL_PCD_EP_SetStall(hpcd, (uint8_t)wIndex);
+                }
+                else
+                {
+                    HAL_PCD_EP_ClrStall(hpcd, (uint8_t)wIndex);
+                }
+            }
+            USB_CDC_Ep0Status();
+            break;
+
+        case REQ_SET_ADDRESS:
+            /* HAL 先记下地址，状态阶段的空包发完后才写进 DADDR */
+            HAL_PCD_SetAddress(hpcd, (uint8_t)(wValue & 0x7FU));
+            USB_CDC_Ep0Status();
+            break;
+
+        case REQ_GET_DESCRIPTOR:
+            USB_CDC_GetDescriptor(wValue, wLength);
+            break;
+
+        case REQ_GET_CONFIGURATION:
+            s_ep0Buf[0] = s_config;
+            USB_CDC_Ep0Send(s_ep0Buf, 1, wLength);
+            break;
+
+        case REQ_SET_CONFIGURATION:
+            if (wValue > 1U)
+            {
+                USB_CDC_Ep0Stall();
+                break;
+            }
+            USB_CDC_Configure((uint8_t)wValue);
+            USB_CDC_Ep0Status();
+            break;
+
+        case REQ_GET_INTERFACE:
+            s_ep0Buf[0] = 0;
+            USB_CDC_Ep0Send(s_ep0Buf, 1, wLength);
+            break;
+
+        case REQ_SET_INTERFACE:
+            USB_CDC_Ep0Status();
+            break;
+
+        default:
+            USB_CDC_Ep0Stall();
+            break;
+    }
+}
+
+void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+    if (epnum == 0U)
+    {
+        if (s_ep0State != EP0_DATA_IN)
+        {
+            s_ep0State = EP0_IDLE;
+            return;
+        }
+        if (s_ep0Rem > 0U)
+        {
+            USB_CDC_Ep0Next();
+        }
+        else if (s_ep0Zlp)
+        {
+            s_ep0Zlp = 0;
+            HAL_PCD_EP_Transmit(hpcd, 0x80U, NULL, 0);
+        }
+        else
+        {
+            s_ep0State = EP0_STATUS_OUT;
+            HAL_PCD_EP_Receive(hpcd, 0x00U, NULL, 0);
+        }
+        return;
+    }
+
+    if (epnum != (CDC_IN_EP & 0x7FU) || !s_txBusy)
+    {
+        return;
+    }
+    if (s_txZlp)
+    {
+        s_txZlp = 0;
+        HAL_PCD_EP_Transmit(hpcd, CDC_IN_EP, NULL, 0);
+        return;
+    }
+
+    uint8_t zeroCopy = s_txZeroCopy;
+    if (!zeroCopy)
+    {
+        s_tail = (uint16_t)(s_tail + s_txLen);
+    }
+    s_txBusy = 0;
+    s_txZeroCopy = 0;
+    if (zeroCopy)
+    {
+        USB_CDC_TxCpltCallback();
+    }
+    USB_CDC_TxKick();
+}
+
+void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+    if (epnum == 0U)
+    {
+        /* SET_LINE_CODING 的 7 字节已收进 s_lineCoding */
+        if (s_ep0State == EP0_DATA_OUT)
+        {
+            USB_CDC_Ep0Status();
+        }
+        return;
+    }
+
+    if (epnum == CDC_OUT_EP)
+    {
+        uint16_t len = (uint16_t)HAL_PCD_EP_GetRxCount(hpcd, CDC_OUT_EP);
+        if (len > 0U)
+        {
+            USB_CDC_RxCallback(s_rxPkt, len);
+        }
+        HAL_PCD_EP_Receive(hpcd, CDC_OUT_EP, s_rxPkt, USB_CDC_PACKET_SIZE);
+    }
+}
+
+/* ---------------- 对外接口 ---------------- */
+
+void USB_CDC_Init(void)
+{
+    HAL_PCDEx_PMAConfig(&hpcd_USB_FS, 0x00U, PCD_SNG_BUF, PMA_EP0_OUT);
+    HAL_PCDEx_PMAConfig(&hpcd_USB_FS, 0x80U, PCD_SNG_BUF, PMA_EP0_IN);
+    HAL_PCDEx_PMAConfig(&hpcd_USB_FS, CDC_IN_EP, PCD_SNG_BUF, PMA_CDC_IN);
+    HAL_PCDEx_PMAConfig(&hpcd_USB_FS, CDC_OUT_EP, PCD_SNG_BUF, PMA_CDC_OUT);
+    HAL_PCDEx_PMAConfig(&hpcd_USB_FS, CDC_CMD_EP, PCD_SNG_BUF, PMA_CDC_CMD);
+    HAL_PCD_Start(&hpcd_USB_FS);
+}
+
+uint8_t USB_CDC_IsOpen(void)
+{
+    return (s_config && s_dtr) ? 1U : 0U;
+}
+
+void USB_CDC_Write(const uint8_t *buf, uint16_t len)
+{
+    /* 同 UartTx_Write：中断里的输出直接丢弃（环形缓冲只有主循环一个写入方）；
+     * 关中断时 SysTick 不走、USB 中断也取不走数据，缓冲满就丢弃，不等 */
+    if (__get_IPSR() != 0U)
+    {
+        return;
+    }
+    uint8_t canWait = (__get_PRIMASK() == 0U) ? 1U : 0U;
+    uint32_t tickStart = HAL_GetTick();
+
+    while (len > 0U && USB_CDC_IsOpen())
+    {
+        uint16_t used = (uint16_t)(s_head - s_tail);
+        if (used >= USB_CDC_TX_RING)
+        {
+            if (!canWait || (HAL_GetTick() - tickStart) > USB_CDC_WRITE_TIMEOUT_MS)
+            {
+                return;     /* 上位机不来取，丢弃 */
+            }
+            continue;
+        }
+
+        uint16_t n = (uint16_t)(USB_CDC_TX_RING - used);
+        if (n > len)
+        {
+            n = len;
+        }
+        for (uint16_t i = 0; i < n; i++)
+        {
+            s_ring[(uint16_t)(s_head + i) % USB_CDC_TX_RING] = buf[i];
+        }
+        s_head = (uint16_t)(s_head + n);
+        buf += n;
+        len -= n;
+
+        HAL_NVIC_DisableIRQ(USB_LP_CAN1_RX0_IRQn);
+        USB_CDC_TxKick();
+        HAL_NVIC_EnableIRQ(USB_LP_CAN1_RX0_IRQn);
+    }
+}
+
+int USB_CDC_Send(const uint8_t *buf, uint16_t len)
+{
+    int ret = -1;
+
+    HAL_NVIC_DisableIRQ(USB_LP_CAN1_RX0_IRQn);
+    if (USB_CDC_IsOpen() && !s_txBusy && s_head == s_tail)
+    {
+        s_txBusy = 1;
+        s_txZeroCopy = 1;
+        s_txLen = len;
+        s_txZlp = ((len % USB_CDC_PACKET_SIZE) == 0U) ? 1U : 0U;
+        HAL_PCD_EP_Transmit(&hpcd_USB_FS, CDC_IN_EP, (uint8_t *)buf, len);
+        ret = 0;
+    }
+    HAL_NVIC_EnableIRQ(USB_LP_CAN1_RX0_IRQn);
+    return ret;
+}
+
+uint8_t USB_CDC_TxBusy(void)
+{
+    return (s_txBusy || s_head != s_tail) ? 1U : 0U;
+}
@@ -38,6 +38,7 @@
 #include "ff_gen_drv.h"
 #include "spi.h"
 #include "main.h"
+#include "sdcache.h"
 
 /* Disk status */
 static volatile DSTATUS Stat = STA_NOINIT;
@@ -45,9 +46,36 @@ static volatile DSTATUS Stat = STA_NOINIT;
 /* SD 卡类型标志 */
 static BYTE CardType = 0;
 
+/* 卡的真实几何参数，初始化时从 CSD / SD Status 读出 */
+static BYTE  CardCsd[16];
+static DWORD CardSectorCount = 0;   /* 总扇区数（512 字节） */
+static DWORD CardEraseBlock = 1;    /* 擦除块（SD 卡即 AU）大小，单位扇区 */
+
 /* SPI 传输超时时间 */
 #define SD_SPI_TIMEOUT 1000U
 
+/* 卡忙超时（毫秒）：规范规定 SDHC 写编程最长 250ms、读访问最长 100ms，留一倍余量 */
+#define SD_WRITE_TIMEOUT_MS 500U
+#define SD_READ_TIMEOUT_MS  200U
+
+/* 忙等待时先连续查询这么多字节（18MHz 下约 50us），多块写的块间忙通常在此之内结束；
+ * 超过后每查询一次就 WFI 休眠到下一个中断（至少每 1ms 一次 SysTick） */
+#define SD_BUSY_SPIN    64U
+
+/* 写完数据块后卡还要内部编程几百微秒到几十毫秒：不在这里等，
+ * 释放片选后置忙标志直接返回，由 SysTick 每 1ms 调用 USER_DiskTick() 查询是否就绪。
+ * 置忙期间主循环不访问 SPI，下一次读写开始前才在 SD_WaitIdle 里等（一般早已就绪） */
+static volatile uint8_t s_cardBusy = 0;
+static uint32_t s_busySince = 0;
+
+/* 数据块长度达到该值时走 DMA，命令/响应等短传输仍逐字节收发 */
+#define SD_DMA_MIN_LEN 16U
+
+extern DMA_HandleTypeDef hdma_spi1_tx;
+
+/* DMA 读数据块时的发送源：TX 通道关闭内存递增，反复发送这一个 0xFF */
+static const BYTE s_dummyFF = 0xFFU;
+
 /* 一些命令定义（仅用到的部分） */
 #define CMD0    (0U)        /* GO_IDLE_STATE */
 #define CMD1    (1U)        /* SEND_OP_COND (MMC) */
@@ -56,11 +84,23 @@ static BYTE CardType = 0;
 #define CMD12   (12U)       /* STOP_TRANSMISSION */
 #define CMD16   (16U)       /* SET_BLOCKLEN */
 #define CMD17   (17U)       /* READ_SINGLE_BLOCK */
+#define CMD18   (18U)       /* READ_MULTIPLE_BLOCK */
 #define CMD24   (24U)       /* WRITE_BLOCK */
+#define CMD25   (25U)       /* WRITE_MULTIPLE_BLOCK */
 #define CMD55   (55U)       /* APP_CMD */
 #define CMD58   (58U)       /* READ_OCR */
+#define ACMD13  (0x80U+13U) /* SD_STATUS (ACMD) */
+#define ACMD23  (0x80U+23U) /* SET_WR_BLK_ERASE_COUNT (ACMD) */
 #define ACMD41  (0x80U+41U) /* SD_SEND_OP_COND (ACMD) */
 
+/* 数据令牌 */
+#define TOKEN_SINGLE_BLOCK  0xFEU  /* CMD17/18/24 的数据起始令牌 */
+#define TOKEN_MULTI_WRITE   0xFCU  /* CMD25 每个数据块的起始令牌 */
+#define TOKEN_STOP_TRAN     0xFDU  /* CMD25 结束令牌 */
+
+/* 单个扇区写失败时的重试次数 */
+#define SD_WRITE_RETRY  3U
+
 /* 卡类型标志 */
 #define CT_MMC    0x01U
 #define CT_SD1    0x02U
@@ -68,6 +108,68 @@ static BYTE CardType = 0;
 #define CT_SDC    (CT_SD1 | CT_SD2)
 #define CT_BLOCK  0x08U
 
+/* 单字节收发：直接读写 SPI 寄存器，省掉 HAL 每次调用的加锁、状态切换和超时判断 */
+static BYTE SD_SPI_TxRx(BYTE data)
+{
+  SPI_TypeDef *spi = hspi1.Instance;
+
+  if ((spi->CR1 & SPI_CR1_SPE) == 0U)
+  {
+    __HAL_SPI_ENABLE(&hspi1);
+  }
+
+  while ((spi->SR & SPI_SR_TXE) == 0U)
+  {
+  }
+  *(__IO uint8_t *)&spi->DR = data;
+  while ((spi->SR & SPI_SR_RXNE) == 0U)
+  {
+  }
+  return (BYTE)spi->DR;
+}
+
+/* 等待 SPI DMA 传输结束（状态由 DMA 完成中断切回 READY） */
+static int SD_SPI_WaitDma(void)
+{
+  uint32_t start = HAL_GetTick();
+
+  while (HAL_SPI_GetState(&hspi1) != HAL_SPI_STATE_READY)
+  {
+    if ((HAL_GetTick() - start) > SD_SPI_TIMEOUT)
+    {
+      HAL_SPI_Abort(&hspi1);
+      return 0;
+    }
+  }
+  return (HAL_SPI_GetError(&hspi1) == HAL_SPI_ERROR_NONE);
+}
+
+/* DMA 接收一个数据块，发送端固定输出 0xFF */
+static int SD_SPI_RecvBlock(BYTE *buff, UINT len)
+{
+  int ok;
+
+  __HAL_DMA_DISABLE(&hdma_spi1_tx);
+  CLEAR_BIT(hdma_spi1_tx.Instance->CCR, DMA_CCR_MINC);
+
+  ok = (HAL_SPI_TransmitReceive_DMA(&hspi1, (uint8_t *)&s_dummyFF, buff, (uint16_t)len) == HAL_OK)
+       && SD_SPI_WaitDma();
+
+  __HAL_DMA_DISABLE(&hdma_spi1_tx);
+  SET_BIT(hdma_spi1_tx.Instance->CCR, DMA_CCR_MINC);
+  return ok;
+}
+
+/* DMA 发送一个数据块，接收到的字节丢弃（HAL 在完成时清除溢出标志） */
+static int SD_SPI_XmitBlock(const BYTE *buff, UINT len)
+{
+  if (HAL_SPI_Transmit_DMA(&hspi1, (uint8_t *)buff, (uint16_t)len) != HAL_OK)
+  {
+    return 0;
+  }
+  return SD_SPI_WaitDma();
+}
+
 static void SD_Select(void)
 {
   HAL_GPIO_WritePin(SD_CS_GPIO_Port, SD_CS_Pin, GPIO_PIN_RESET);
@@ -76,17 +178,7 @@ static void SD_Select(void)
 static void SD_Deselect(void)
 {
   HAL_GPIO_WritePin(SD_CS_GPIO_Port, SD_CS_Pin, GPIO_PIN_SET);
-  uint8_t dummy = 0xFF;
-  uint8_t rx;
-  HAL_SPI_TransmitReceive(&hspi1, &dummy, &rx, 1, SD_SPI_TIMEOUT);
-}
-
-static BYTE SD_SPI_TxRx(BYTE data)
-{
-  uint8_t tx = data;
-  uint8_t rx = 0xFF;
-  HAL_SPI_TransmitReceive(&hspi1, &tx, &rx, 1, SD_SPI_TIMEOUT);
-  return rx;
+  SD_SPI_TxRx(0xFF);
 }
 
 static void SD_SendDummyClocks(UINT count)
@@ -97,15 +189,50 @@ static void SD_SendDummyClocks(UINT count)
   }
 }
 
-static int SD_WaitReady(void)
+/* 片选有效时等待卡就绪（DO 回到 0xFF），超时按毫秒计 */
+static int SD_WaitReady(uint32_t timeout_ms)
 {
-  uint8_t resp;
-  UINT timeout = 50000U;
-  do
+  uint32_t start = HAL_GetTick();
+  UINT spin = SD_BUSY_SPIN;
+
+  while (SD_SPI_TxRx(0xFF) != 0xFFU)
   {
-    resp = SD_SPI_TxRx(0xFF);
-  } while (resp != 0xFF && --timeout);
-  return (resp == 0xFF);
+    if ((HAL_GetTick() - start) > timeout_ms)
+    {
+      return 0;
+    }
+    if (spin != 0U)
+    {
+      spin--;
+    }
+    else
+    {
+      __WFI();
+    }
+  }
+  return 1;
+}
+
+/* 片选释放后卡开始（或继续）编程：交给 SysTick 查询 */
+static void SD_SetBusy(void)
+{
+  s_busySince = HAL_GetTick();
+  s_cardBusy = 1U;
+}
+
+/* 开始一次新的访问前等上一次写入编程结束，等待期间休眠 */
+static int SD_WaitIdle(void)
+{
+  while (s_cardBusy)
+  {
+    if ((HAL_GetTick() - s_busySince) > SD_WRITE_TIMEOUT_MS)
+    {
+      s_cardBusy = 0U;
+      return 0;
+    }
+    __WFI();
+  }
+  return 1;
 }
 
 static BYTE SD_SendCmdInternal(BYTE cmd, DWORD arg)
@@ -132,6 +259,12 @@ static BYTE SD_SendCmdInternal(BYTE cmd, DWORD arg)
   SD_SPI_TxRx((BYTE)(arg));
   SD_SPI_TxRx(crc);
 
+  /* CMD12 之后卡还会多送出一个填充字节，需要丢掉 */
+  if (cmd == CMD12)
+  {
+    SD_SPI_TxRx(0xFF);
+  }
+
   n = 10U;
   do
   {
@@ -168,21 +301,44 @@ static BYTE SD_SendCmd(BYTE cmd, DWORD arg)
 static int SD_RecvData(BYTE *buff, UINT len)
 {
   BYTE token;
-  UINT timeout = 20000U;
+  uint32_t start = HAL_GetTick();
+  UINT spin = SD_BUSY_SPIN;
 
-  do
+  /* 等数据起始令牌，做法同 SD_WaitReady */
+  while ((token = SD_SPI_TxRx(0xFF)) == 0xFFU)
   {
-    token = SD_SPI_TxRx(0xFF);
-  } while (token == 0xFFU && --timeout);
+    if ((HAL_GetTick() - start) > SD_READ_TIMEOUT_MS)
+    {
+      return 0;
+    }
+    if (spin != 0U)
+    {
+      spin--;
+    }
+    else
+    {
+      __WFI();
+    }
+  }
 
-  if (token != 0xFEU)
+  if (token != TOKEN_SINGLE_BLOCK)
   {
     return 0;
   }
 
-  while (len--)
+  if (len >= SD_DMA_MIN_LEN)
+  {
+    if (!SD_SPI_RecvBlock(buff, len))
+    {
+      return 0;
+    }
+  }
+  else
   {
-    *buff++ = SD_SPI_TxRx(0xFF);
+    while (len--)
+    {
+      *buff++ = SD_SPI_TxRx(0xFF);
+    }
   }
 
   SD_SPI_TxRx(0xFF);
@@ -195,19 +351,19 @@ static int SD_XmitData(const BYTE *buff, BYTE token)
 {
   BYTE resp;
 
-  if (!SD_WaitReady())
+  /* 多块写时等上一块编程结束 */
+  if (!SD_WaitReady(SD_WRITE_TIMEOUT_MS))
   {
     return 0;
   }
 
   SD_SPI_TxRx(token);
 
-  if (token != 0xFDU)
+  if (token != TOKEN_STOP_TRAN)
   {
-    UINT len = 512U;
-    while (len--)
+    if (!SD_SPI_XmitBlock(buff, 512U))
     {
-      SD_SPI_TxRx(*buff++);
+      return 0;
     }
 
     SD_SPI_TxRx(0xFF);
@@ -216,19 +372,242 @@ static int SD_XmitData(const BYTE *buff, BYTE token)
     resp = SD_SPI_TxRx(0xFF);
     if ((resp & 0x1FU) != 0x05U)
     {
+      /* 出错后等卡空闲再让调用者重试 */
+      SD_WaitReady(SD_WRITE_TIMEOUT_MS);
       return 0;
     }
 
-    /* 等待内部编程完成（忙期间 DO 会拉低） */
-    if (!SD_WaitReady())
-    {
-      return 0;
-    }
+    /* 内部编程（忙期间 DO 拉低）不在这里等：下一块写之前或 SD_WaitIdle 里再等 */
   }
 
   return 1;
 }
 
+/* SD Status 的 AU_SIZE 编码对应的 AU 大小（单位 16KB）：到 0xA（8MB）为 2 的幂，SDXC 的 0xB~0xF 不是 */
+static const WORD SD_AuSize16K[16] =
+{
+  0U, 1U, 2U, 4U, 8U, 16U, 32U, 64U, 128U, 256U, 512U, 768U, 1024U, 1536U, 2048U, 4096U
+};
+
+/* 读 CSD 并计算容量与擦除块大小，SDv2 再用 ACMD13 读 AU 大小 */
+static int SD_ReadGeometry(void)
+{
+  BYTE sd_status[64];
+  BYTE n;
+  DWORD csize;
+
+  SD_Select();
+  if (SD_SendCmd(CMD9, 0) != 0U || !SD_RecvData(CardCsd, 16U))
+  {
+    SD_Deselect();
+    return 0;
+  }
+
+  /* 容量 */
+  if ((CardCsd[0] >> 6) > 1U)
+  {
+    /* CSD v3.0（SDUC，2TB 以上）：扇区号超出 32 位，SPI 模式也不支持，按不可用处理 */
+    SD_Deselect();
+    return 0;
+  }
+  if ((CardCsd[0] >> 6) == 1U)
+  {
+    /* CSD v2.0（SDHC/SDXC）：容量 = (C_SIZE + 1) * 512KB，C_SIZE 为 22 位，
+     * 最大 2TB 的扇区数仍在 DWORD 范围内，64GB/128GB 的 SDXC 卡按真实容量计算 */
+    csize = (DWORD)CardCsd[9] + ((DWORD)CardCsd[8] << 8) + ((DWORD)(CardCsd[7] & 0x3FU) << 16) + 1U;
+    CardSectorCount = csize << 10;
+  }
+  else
+  {
+    /* CSD v1.0（SDSC / MMC）：容量 = (C_SIZE + 1) * 2^(C_SIZE_MULT + 2) * 2^READ_BL_LEN */
+    n = (BYTE)((CardCsd[5] & 0x0FU) + ((CardCsd[10] & 0x80U) >> 7) + ((CardCsd[9] & 0x03U) << 1) + 2U);
+    csize = (DWORD)(CardCsd[8] >> 6) + ((DWORD)CardCsd[7] << 2) + ((DWORD)(CardCsd[6] & 0x03U) << 10) + 1U;
+    CardSectorCount = csize << (n - 9U);
+  }
+
+  /* 擦除块 */
+  CardEraseBlock = 1U;
+  if (CardType & CT_SD2)
+  {
+    /* ACMD13 返回 R2（R1 + 1 字节）和 64 字节 SD Status，AU_SIZE 在第 10 字节高 4 位 */
+    if (SD_SendCmd(ACMD13, 0) == 0U)
+    {
+      SD_SPI_TxRx(0xFF);
+      if (SD_RecvData(sd_status, sizeof(sd_status)))
+      {
+        CardEraseBlock = (DWORD)SD_AuSize16K[sd_status[10] >> 4] * 32U;
+        if (CardEraseBlock == 0U)
+        {
+          CardEraseBlock = 1U;
+        }
+      }
+    }
+  }
+  else if (CardType & CT_SD1)
+  {
+    /* SDv1：(SECTOR_SIZE + 1) * 2^(WRITE_BL_LEN - 9) */
+    CardEraseBlock = (((DWORD)(CardCsd[10] & 0x3FU) << 1) + ((DWORD)(CardCsd[11] & 0x80U) >> 7) + 1U)
+                     << ((CardCsd[13] >> 6) - 1U);
+  }
+  else
+  {
+    /* MMC：(ERASE_GRP_SIZE + 1) * (ERASE_GRP_MULT + 1) */
+    CardEraseBlock = ((DWORD)((CardCsd[10] & 0x7CU) >> 2) + 1U)
+                     * ((DWORD)((CardCsd[11] & 0x03U) << 3) + ((CardCsd[11] & 0xE0U) >> 5) + 1U);
+  }
+
+  SD_Deselect();
+  return 1;
+}
+
+/* 不经过缓存的扇区读，sdcache.c 未命中时调用 */
+static DRESULT SD_ReadSectors(BYTE *buff, DWORD sector, UINT count)
+{
+  if (!(CardType & CT_BLOCK))
+  {
+    sector *= 512U;
+  }
+
+  if (!SD_WaitIdle())
+  {
+    return RES_ERROR;
+  }
+  SD_Select();
+
+  DRESULT res = RES_OK;
+
+  if (count == 1U)
+  {
+    /* 单扇区：CMD17 */
+    if (SD_SendCmd(CMD17, sector) != 0U || !SD_RecvData(buff, 512U))
+    {
+      res = RES_ERROR;
+    }
+  }
+  else
+  {
+    /* 多扇区：CMD18 连续读，卡内部自动递增地址，最后用 CMD12 停止 */
+    if (SD_SendCmd(CMD18, sector) == 0U)
+    {
+      do
+      {
+        if (!SD_RecvData(buff, 512U))
+        {
+          break;
+        }
+        buff += 512U;
+      } while (--count);
+
+      /* CMD12 必须在同一次片选内发出（SD_SendCmd 会先翻转 CS 打断读操作）；
+       * R1b 响应后卡拉低 DO 表示忙，等它结束再释放片选。
+       * 读到卡末尾时部分卡会在 R1 里报越界，只要求有响应 */
+      if ((SD_SendCmdInternal(CMD12, 0) & 0x80U) != 0U ||
+          !SD_WaitReady(SD_READ_TIMEOUT_MS) || count)
+      {
+        res = RES_ERROR;
+      }
+    }
+    else
+    {
+      res = RES_ERROR;
+    }
+  }
+
+  SD_Deselect();
+
+  return res;
+}
+
+/* 不经过缓存的扇区写，数据扇区和缓存写回时调用 */
+static DRESULT SD_WriteSectors(const BYTE *buff, DWORD sector, UINT count)
+{
+  if (!(CardType & CT_BLOCK))
+  {
+    sector *= 512U;
+  }
+
+  if (!SD_WaitIdle())
+  {
+    return RES_ERROR;
+  }
+  SD_Select();
+
+  DRESULT res = RES_ERROR;
+
+  if (count == 1U)
+  {
+    /* 单扇区：CMD24，偶发错误最多重试 SD_WRITE_RETRY 次 */
+    for (uint8_t retry = 0; retry < SD_WRITE_RETRY; retry++)
+    {
+      if (SD_SendCmd(CMD24, sector) == 0U && SD_XmitData(buff, TOKEN_SINGLE_BLOCK))
+      {
+        res = RES_OK;
+        break;
+      }
+    }
+  }
+  else
+  {
+    /* 多扇区：SD 卡先用 ACMD23 告知块数，让卡预擦除；
+     * 然后 CMD25 连续写，每块以 0xFC 起始，最后发 stop-tran 令牌 */
+    for (uint8_t retry = 0; retry < SD_WRITE_RETRY && res != RES_OK; retry++)
+    {
+      const BYTE *p = buff;
+      UINT n = count;
+
+      if (CardType & CT_SDC)
+      {
+        SD_SendCmd(ACMD23, count);
+      }
+
+      if (SD_SendCmd(CMD25, sector) == 0U)
+      {
+        do
+        {
+          if (!SD_XmitData(p, TOKEN_MULTI_WRITE))
+          {
+            break;
+          }
+          p += 512U;
+        } while (--n);
+
+        /* 无论是否全部写完都要发结束令牌；之后的编程忙交给 SysTick 查询 */
+        if (SD_XmitData(NULL, TOKEN_STOP_TRAN) && n == 0U)
+        {
+          res = RES_OK;
+        }
+      }
+    }
+  }
+
+  SD_Deselect();
+  SD_SetBusy();
+
+  return res;
+}
+
+uint8_t USER_IsBusy(void)
+{
+  return s_cardBusy;
+}
+
+/* SysTick 中断里每 1ms 调用：卡忙时选中卡读一个字节，回到 0xFF 即编程结束。
+ * 置忙期间主循环不会访问 SPI，这里不会和正在进行的传输冲突 */
+void USER_DiskTick(void)
+{
+  if (!s_cardBusy)
+  {
+    return;
+  }
+
+  SD_Select();
+  if (SD_SPI_TxRx(0xFF) == 0xFFU)
+  {
+    s_cardBusy = 0U;
+  }
+  SD_Deselect();
+}
+
 /* USER CODE END DECL */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -276,6 +655,13 @@ DSTATUS USER_initialize (
     return STA_NOINIT;
   }
 
+  /* 重新初始化前等上一次写入编程结束，再清掉忙标志，免得 SysTick 在识别过程中插入查询 */
+  SD_WaitIdle();
+  s_cardBusy = 0U;
+
+  /* 识别阶段 SPI 时钟必须 <= 400kHz */
+  MX_SPI1_SetBaudRatePrescaler(SPI1_PRESCALER_SD_INIT);
+
   SD_Deselect();
   SD_SendDummyClocks(10U);
 
@@ -348,7 +734,16 @@ DSTATUS USER_initialize (
 
   if (ty)
   {
+    /* 初始化完成，切到 18MHz 数据传输时钟 */
+    MX_SPI1_SetBaudRatePrescaler(SPI1_PRESCALER_SD_FAST);
     Stat &= ~STA_NOINIT;
+    SD_Cache_Init(SD_ReadSectors, SD_WriteSectors);
+
+    if (!SD_ReadGeometry())
+    {
+      CardSectorCount = 0;
+      CardEraseBlock = 1;
+    }
   }
   else
   {
@@ -356,7 +751,8 @@ DSTATUS USER_initialize (
   }
 
   /* 调试输出：可以看到卡类型 */
-  printf("SD USER_initialize: type=0x%02X, Stat=0x%02X\r\n", CardType, Stat);
+  printf("SD USER_initialize: type=0x%02X, Stat=0x%02X, sectors=%lu, erase=%lu\r\n",
+         CardType, Stat, (unsigned long)CardSectorCount, (unsigned long)CardEraseBlock);
 
   return Stat;
   /* USER CODE END INIT */
@@ -405,29 +801,7 @@ DRESULT USER_read (
     return RES_NOTRDY;
   }
 
-  if (!(CardType & CT_BLOCK))
-  {
-    sector *= 512U;
-  }
-
-  SD_Select();
-
-  DRESULT res = RES_OK;
-
-  while (count--)
-  {
-    if (SD_SendCmd(CMD17, sector) != 0U || !SD_RecvData(buff, 512U))
-    {
-      res = RES_ERROR;
-      break;
-    }
-    sector++;
-    buff += 512U;
-  }
-
-  SD_Deselect();
-
-  return res;
+  return SD_Cache_Read(buff, sector, count);
   /* USER CODE END READ */
 }
 
@@ -462,40 +836,7 @@ DRESULT USER_write (
     return RES_WRPRT;
   }
 
-  if (!(CardType & CT_BLOCK))
-  {
-    sector *= 512U;
-  }
-
-  SD_Select();
-
-  DRESULT res = RES_OK;
-
-  while (count--)
-  {
-    /* 每个扇区最多重试 3 次，避免偶发错误导致整个写失败 */
-    uint8_t retry = 3U;
-    while (retry--)
-    {
-      if (SD_SendCmd(CMD24, sector) == 0U && SD_XmitData(buff, 0xFEU))
-      {
-        break;
-      }
-    }
-
-    if ((int8_t)retry < 0)
-    {
-      res = RES_ERROR;
-      break;
-    }
-
-    sector++;
-    buff += 512U;
-  }
-
-  SD_Deselect();
-
-  return res;
+  return SD_Cache_Write(buff, sector, count);
   /* USER CODE END WRITE */
 }
 #endif /* _USE_WRITE == 1 */
@@ -530,12 +871,12 @@ DRESULT USER_ioctl (
   switch (cmd)
   {
     case CTRL_SYNC:
-      SD_Select();
-      if (SD_WaitReady())
+      /* 写出缓存里的 FAT / 目录扇区，再等最后一次写入编程结束，之后掉电也不会丢数据 */
+      res = SD_Cache_Sync();
+      if (res == RES_OK && !SD_WaitIdle())
       {
-        res = RES_OK;
+        res = RES_ERROR;
       }
-      SD_Deselect();
       break;
 
     case GET_SECTOR_SIZE:
@@ -544,14 +885,33 @@ DRESULT USER_ioctl (
       break;
 
     case GET_BLOCK_SIZE:
-      *(DWORD *)buff = 1U;
+      /* 擦除块（AU）大小，f_mkfs 用它把数据区对齐到擦除块边界。
+       * f_mkfs 要求 2 的幂且不超过 32768 扇区：12MB/24MB 的 AU 报告其中 2 的幂因子，
+       * 32MB/64MB 的 AU 按 16MB 报告，数据区仍对齐到 16MB 边界 */
+      *(DWORD *)buff = CardEraseBlock & (~CardEraseBlock + 1U);
+      if (*(DWORD *)buff > 32768U)
+      {
+        *(DWORD *)buff = 32768U;
+      }
       res = RES_OK;
       break;
 
     case GET_SECTOR_COUNT:
-      /* 这里只返回一个“看上去像”的大小值（例如 4GB 卡约等于 8M 扇区），
-       * 实际不影响正常读写，只是避免某些情况下 f_mkfs 直接报错。 */
-      *(DWORD *)buff = 8UL * 1024UL * 1024UL; /* 约 8M 扇区（4GB） */
+      /* 初始化时从 CSD 读出的真实容量，读取失败则报错而不是猜一个值 */
+      if (CardSectorCount != 0U)
+      {
+        *(DWORD *)buff = CardSectorCount;
+        res = RES_OK;
+      }
+      break;
+
+    case MMC_GET_TYPE:
+      *(BYTE *)buff = CardType;
+      res = RES_OK;
+      break;
+
+    case MMC_GET_CSD:
+      memcpy(buff, CardCsd, sizeof(CardCsd));
       res = RES_OK;
       break;
 
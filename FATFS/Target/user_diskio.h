@@ -34,6 +34,11 @@
 /* Exported functions ------------------------------------------------------- */
 extern Diskio_drvTypeDef  USER_Driver;
 
+/* 写入后卡仍在内部编程时返回 1，此时发起读写会先等编程结束 */
+uint8_t USER_IsBusy(void);
+/* 在 SysTick 中断里每 1ms 调用一次，查询卡是否编程结束 */
+void USER_DiskTick(void);
+
 /* USER CODE END 0 */
 
 #ifdef __cplusplus
@@ -0,0 +1,470 @@
+# -*- coding: utf-8 -*-
+"""SD 卡二进制日志 (LOG/*.BIN) 解码工具，格式定义见 Core/Inc/logrec.h 和 logblock.h。
+版本 1 为定长记录，版本 2 为每扇区一块的差值压缩块，两种都能解码。
+裸分区模式（SD_LOG_RAW）的环形日志用 --raw 导出，见 sdraw.h。
+
+用法:
+    python log_decoder.py LOG/25101800.BIN    # CSV 输出到屏幕
+    python log_decoder.py LOG -o out.csv      # 目录：按文件名顺序合并所有 .BIN
+    sudo python log_decoder.py --raw /dev/sdb -o out.csv      # 整卡（查 MBR 找 0xDA 分区）
+    sudo python log_decoder.py --raw /dev/sdb2 -b raw.BIN     # 分区本身，另存为版本 2 的 .BIN
+"""
+import argparse
+import binascii
+import csv
+import os
+import struct
+import sys
+from datetime import datetime, timezone
+
+LOG_MAGIC = b"WQLG"
+LOG_VERSION = 2
+LOG_VERSIONS = (1, 2)
+LOG_HEADER_SIZE = 512
+LOG_RECORD_SIZE = 16
+
+# 压缩块（版本 2），与 logrec.h / logblock.c 一致
+LOG_BLOCK_SIZE = 512
+LOG_BLOCK_HDR = LOG_RECORD_SIZE + 2
+LOG_BLOCK_BITS = (LOG_BLOCK_SIZE - LOG_BLOCK_HDR - 2) * 8
+BUCKET_BITS = (0, 4, 8, 16, 32)
+# 参与差值编码的通道：(在记录中的偏移, struct 格式)，对应 logblock.c 的 s_fields
+BLOCK_FIELDS = ((4, "h"), (6, "h"), (8, "H"), (10, "H"))
+
+# 裸分区，与 logrec.h / sdraw.c 一致：块尾 [502..509] 为 {块序号, 格式化代号}
+LOG_RAW_PART_TYPE = 0xDA
+LOG_RAW_TRAILER = 8
+LOG_RAW_TRAILER_OFS = LOG_BLOCK_SIZE - 2 - LOG_RAW_TRAILER
+LOG_RAW_BITS = LOG_BLOCK_BITS - LOG_RAW_TRAILER * 8
+MBR_TABLE = 446
+RAW_SCAN_BLOCKS = 2048      # 扫描时每次读的块数
+
+FLAG_PH_RANGE = 0x01
+FLAG_TEMP_FAULT = 0x02
+FLAG_TDS_RANGE = 0x04
+FLAG_TURB_RANGE = 0x08
+FLAG_TIME_UNSET = 0x80
+
+HEADER_FMT = "<4sHHHBBIIII"
+CHANNEL_FMT = "<8s4sBBH"
+RECORD_FMT = "<IhhHHBBH"
+TYPE_CODES = {1: "h", 2: "H"}
+
+
+# 固件 g_logChannels（logchan.c）的默认通道表（版本 1），串口回传的记录不带文件头时使用
+DEFAULT_CHANNELS = [
+    {"name": "PH", "unit": "", "code": "h", "offset": 4, "scale": 100},
+    {"name": "TEMP", "unit": "C", "code": "h", "offset": 6, "scale": 100},
+    {"name": "TDS", "unit": "ppm", "code": "H", "offset": 8, "scale": 1},
+    {"name": "TURB", "unit": "TU", "code": "H", "offset": 10, "scale": 10},
+]
+
+
+class LogFormatError(Exception):
+    pass
+
+
+def default_header():
+    return {
+        "version": LOG_VERSION,
+        "header_size": LOG_HEADER_SIZE,
+        "flags": 0,
+        "created": 0,
+        "period_ms": 0,
+        "data_end": 0,
+        "gen": 0,
+        "channels": DEFAULT_CHANNELS,
+    }
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE，与 Core/Src/crc16.c 一致（binascii.crc_hqx 是同一个多项式，C 实现）。"""
+    return binascii.crc_hqx(data, crc)
+
+
+def parse_header(raw):
+    if len(raw) < LOG_HEADER_SIZE:
+        raise LogFormatError("文件头不完整")
+    magic, version, header_size, record_size, chan_count, flags, created, period_ms, data_end, gen = \
+        struct.unpack_from(HEADER_FMT, raw, 0)
+    if magic != LOG_MAGIC:
+        raise LogFormatError("不是 WQLG 日志文件")
+    (crc,) = struct.unpack_from("<H", raw, LOG_HEADER_SIZE - 2)
+    if crc != crc16(raw[:LOG_HEADER_SIZE - 2]):
+        raise LogFormatError("文件头 CRC 错误")
+    if version not in LOG_VERSIONS or record_size != LOG_RECORD_SIZE:
+        raise LogFormatError(f"不支持的版本 {version} / 记录长度 {record_size}")
+
+    channels = []
+    off = struct.calcsize(HEADER_FMT)
+    for _ in range(chan_count):
+        name, unit, ctype, offset, scale = struct.unpack_from(CHANNEL_FMT, raw, off)
+        channels.append({
+            "name": name.rstrip(b"\0").decode("ascii"),
+            "unit": unit.rstrip(b"\0").decode("ascii"),
+            "code": TYPE_CODES[ctype],
+            "offset": offset,
+            "scale": scale,
+        })
+        off += struct.calcsize(CHANNEL_FMT)
+
+    return {
+        "version": version,
+        "header_size": header_size,
+        "flags": flags,
+        "created": created,
+        "period_ms": period_ms,
+        "data_end": data_end,
+        "gen": gen,
+        "channels": channels,
+    }
+
+
+def decode_record(header, raw):
+    """解码一条 16 字节记录，CRC 错误返回 None。"""
+    (crc,) = struct.unpack_from("<H", raw, LOG_RECORD_SIZE - 2)
+    if crc != crc16(raw[:LOG_RECORD_SIZE - 2]):
+        return None
+    ts, _, _, _, _, flags, seq, _ = struct.unpack(RECORD_FMT, raw)
+    rec = {"ts": ts, "flags": flags, "seq": seq}
+    for ch in header["channels"]:
+        (value,) = struct.unpack_from("<" + ch["code"], raw, ch["offset"])
+        rec[ch["name"]] = value / ch["scale"]
+    return rec
+
+
+def iter_records(header, data, stats=None):
+    """遍历记录区。全 0x00 / 全 0xFF 视为预分配的空白区，到此结束。"""
+    if stats is None:
+        stats = {}
+    stats.setdefault("bad_crc", 0)
+    stats.setdefault("gaps", 0)
+    last_seq = None
+    for off in range(0, len(data) - LOG_RECORD_SIZE + 1, LOG_RECORD_SIZE):
+        raw = data[off:off + LOG_RECORD_SIZE]
+        if raw == b"\0" * LOG_RECORD_SIZE or raw == b"\xff" * LOG_RECORD_SIZE:
+            break
+        rec = decode_record(header, raw)
+        if rec is None:
+            stats["bad_crc"] += 1
+            last_seq = None
+            continue
+        if last_seq is not None and rec["seq"] != (last_seq + 1) & 0xFF:
+            stats["gaps"] += 1
+        last_seq = rec["seq"]
+        yield rec
+
+
+class BitReader:
+    """按字节内高位在前读位流，越过末尾读到的位为 0。"""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def bits(self, n):
+        v = 0
+        for _ in range(n):
+            bit = 0
+            if self.pos < len(self.data) * 8:
+                bit = (self.data[self.pos >> 3] >> (7 - (self.pos & 7))) & 1
+            v = (v << 1) | bit
+            self.pos += 1
+        return v
+
+    def value(self):
+        k = 0
+        while k < len(BUCKET_BITS) - 1 and self.bits(1):
+            k += 1
+        return self.bits(BUCKET_BITS[k])
+
+
+def unzigzag(z):
+    return (z >> 1) ^ -(z & 1)
+
+
+def decode_block(block, limit=LOG_BLOCK_BITS):
+    """解码一个压缩块，返回各条记录的 16 字节原始数据（CRC 已重新计算），块无效返回 None。
+    limit 为位流可用位数，裸分区的块尾占了 8 字节，传 LOG_RAW_BITS。"""
+    if len(block) < LOG_BLOCK_SIZE:
+        return None
+    (crc,) = struct.unpack_from("<H", block, LOG_BLOCK_SIZE - 2)
+    if crc != crc16(block[:LOG_BLOCK_SIZE - 2]):
+        return None
+    first = bytearray(block[:LOG_RECORD_SIZE])
+    (count,) = struct.unpack_from("<H", block, LOG_RECORD_SIZE)
+    if count == 0 or struct.unpack_from("<H", first, 14)[0] != crc16(first[:14]):
+        return None
+
+    reader = BitReader(block[LOG_BLOCK_HDR:LOG_BLOCK_SIZE - 2])
+    prev = first
+    delta = 0
+    out = [bytes(first)]
+    for _ in range(count - 1):
+        rec = bytearray(prev)
+        delta = (delta + unzigzag(reader.value())) & 0xFFFFFFFF
+        (ts,) = struct.unpack_from("<I", prev, 0)
+        struct.pack_into("<I", rec, 0, (ts + delta) & 0xFFFFFFFF)
+        if reader.bits(1):
+            rec[12] = reader.bits(8)
+        for offset, code in BLOCK_FIELDS:
+            (value,) = struct.unpack_from("<" + code, prev, offset)
+            value = (value + unzigzag(reader.value())) & 0xFFFF
+            struct.pack_into("<H", rec, offset, value)
+        rec[13] = (prev[13] + 1) & 0xFF
+        struct.pack_into("<H", rec, 14, crc16(rec[:14]))
+        if reader.pos > limit:
+            return None
+        out.append(bytes(rec))
+        prev = rec
+    return out
+
+
+def iter_blocks(header, data, stats=None):
+    """遍历版本 2 的块区，坏块计入 bad_crc 并跳过。"""
+    if stats is None:
+        stats = {}
+    stats.setdefault("bad_crc", 0)
+    stats.setdefault("gaps", 0)
+    last_seq = None
+    for off in range(0, len(data) - LOG_BLOCK_SIZE + 1, LOG_BLOCK_SIZE):
+        block = data[off:off + LOG_BLOCK_SIZE]
+        if block == b"\0" * LOG_BLOCK_SIZE or block == b"\xff" * LOG_BLOCK_SIZE:
+            break
+        raws = decode_block(block)
+        if raws is None:
+            stats["bad_crc"] += 1
+            last_seq = None
+            continue
+        for raw in raws:
+            rec = decode_record(header, raw)
+            if last_seq is not None and rec["seq"] != (last_seq + 1) & 0xFF:
+                stats["gaps"] += 1
+            last_seq = rec["seq"]
+            yield rec
+
+
+def iter_tail_blocks(header, data, last_seq):
+    """版本 2 的 data_end 之后：只接收 CRC 正确且首条序号接续的块。"""
+    for off in range(0, len(data) - LOG_BLOCK_SIZE + 1, LOG_BLOCK_SIZE):
+        raws = decode_block(data[off:off + LOG_BLOCK_SIZE])
+        if raws is None:
+            break
+        recs = [decode_record(header, raw) for raw in raws]
+        if last_seq is not None and recs[0]["seq"] != (last_seq + 1) & 0xFF:
+            break
+        last_seq = recs[-1]["seq"]
+        yield from recs
+
+
+def iter_tail(header, data, last_seq):
+    """data_end 之后：和固件上电恢复一样，只接收 CRC 正确且序号连续的记录。"""
+    if header["version"] >= 2:
+        yield from iter_tail_blocks(header, data, last_seq)
+        return
+    for off in range(0, len(data) - LOG_RECORD_SIZE + 1, LOG_RECORD_SIZE):
+        rec = decode_record(header, data[off:off + LOG_RECORD_SIZE])
+        if rec is None or (last_seq is not None and rec["seq"] != (last_seq + 1) & 0xFF):
+            break
+        last_seq = rec["seq"]
+        yield rec
+
+
+def read_log(path, stats=None):
+    with open(path, "rb") as f:
+        blob = f.read()
+    header = parse_header(blob[:LOG_HEADER_SIZE])
+    # 预分配的文件以 data_end 为准，之后是未用空间
+    end = header["data_end"] or len(blob)
+    body = blob[header["header_size"]:end]
+    if header["version"] >= 2:
+        records = list(iter_blocks(header, body, stats))
+    else:
+        records = list(iter_records(header, body, stats))
+    if header["data_end"]:
+        last_seq = records[-1]["seq"] if records else None
+        records.extend(iter_tail(header, blob[end:], last_seq))
+    return header, records
+
+
+def open_raw(f):
+    """定位裸分区并读分区头，返回 (分区起始字节偏移, 环形区块数, 分区头原始字节, 分区头)。
+    f 可以是分区本身（第一个扇区就是分区头），也可以是整卡或镜像（查 MBR 找 0xDA 分区）。"""
+    f.seek(0)
+    sec0 = f.read(LOG_HEADER_SIZE)
+    base, count = None, None
+    if sec0[:4] == LOG_MAGIC:
+        base = 0
+    elif len(sec0) == LOG_HEADER_SIZE and sec0[510:512] == b"\x55\xaa":
+        for i in range(4):
+            entry = MBR_TABLE + 16 * i
+            start, sectors = struct.unpack_from("<II", sec0, entry + 8)
+            if sec0[entry + 4] == LOG_RAW_PART_TYPE and start:
+                base, count = start * LOG_BLOCK_SIZE, sectors
+                break
+    if base is None:
+        raise LogFormatError(f"没有找到类型 0x{LOG_RAW_PART_TYPE:02X} 的裸分区")
+    if count is None:
+        count = (f.seek(0, os.SEEK_END) - base) // LOG_BLOCK_SIZE
+
+    f.seek(base)
+    raw = f.read(LOG_HEADER_SIZE)
+    return base, count - 1, raw, parse_header(raw)
+
+
+def scan_raw(f, base, nblocks, gen):
+    """第一遍只看块尾：收集本次格式化写入、序号与位置相符且 CRC 正确的块，按序号排序返回 [(seq, pos)]。"""
+    found = []
+    pos = 0
+    f.seek(base + LOG_BLOCK_SIZE)
+    while pos < nblocks:
+        chunk = f.read(min(nblocks - pos, RAW_SCAN_BLOCKS) * LOG_BLOCK_SIZE)
+        if not chunk:
+            break
+        for off in range(0, len(chunk) - LOG_BLOCK_SIZE + 1, LOG_BLOCK_SIZE):
+            seq, blk_gen = struct.unpack_from("<II", chunk, off + LOG_RAW_TRAILER_OFS)
+            if blk_gen == gen and seq % nblocks == pos:
+                (crc,) = struct.unpack_from("<H", chunk, off + LOG_BLOCK_SIZE - 2)
+                if crc == crc16(chunk[off:off + LOG_BLOCK_SIZE - 2]):
+                    found.append((seq, pos))
+            pos += 1
+    found.sort()
+    return found
+
+
+def iter_raw(f, base, order, header, stats, bin_out=None):
+    """第二遍：按序号读块并解码，序号不连续的块计入 lost_blocks。
+    bin_out 不为 None 时同时把块原样写进去（块尾不影响解码，可以当版本 2 的 .BIN 读）。"""
+    stats.setdefault("bad_crc", 0)
+    stats.setdefault("gaps", 0)
+    stats.setdefault("lost_blocks", 0)
+    last_block = None
+    last_seq = None
+    for seq, pos in order:
+        f.seek(base + (1 + pos) * LOG_BLOCK_SIZE)
+        block = f.read(LOG_BLOCK_SIZE)
+        if bin_out is not None:
+            bin_out.write(block)
+        if last_block is not None and seq != last_block + 1:
+            stats["lost_blocks"] += seq - last_block - 1
+        last_block = seq
+        raws = decode_block(block, LOG_RAW_BITS)
+        if raws is None:
+            stats["bad_crc"] += 1
+            last_seq = None
+            continue
+        for raw in raws:
+            rec = decode_record(header, raw)
+            if last_seq is not None and rec["seq"] != (last_seq + 1) & 0xFF:
+                stats["gaps"] += 1
+            last_seq = rec["seq"]
+            yield rec
+
+
+def bin_header(raw, data_end):
+    """分区头改成文件头：填 data_end，gen 清零，重算 CRC。"""
+    hdr = bytearray(raw)
+    struct.pack_into("<II", hdr, 20, data_end, 0)
+    struct.pack_into("<H", hdr, LOG_HEADER_SIZE - 2, crc16(hdr[:LOG_HEADER_SIZE - 2]))
+    return bytes(hdr)
+
+
+def export_raw(args, stats):
+    """--raw：导出裸分区，CSV 和 .BIN 可以同时输出；只给 -b 时不打印 CSV。"""
+    with open(args.path, "rb") as f:
+        base, nblocks, raw, header = open_raw(f)
+        order = scan_raw(f, base, nblocks, header["gen"])
+        print(f"裸分区: 起始扇区 {base // LOG_BLOCK_SIZE}, {nblocks} 块, 有效 {len(order)} 块"
+              + (f", 序号 {order[0][0]}~{order[-1][0]}" if order else ""), file=sys.stderr)
+
+        bin_out = open(args.bin, "wb") if args.bin else None
+        try:
+            if bin_out is not None:
+                bin_out.write(bin_header(raw, LOG_HEADER_SIZE + len(order) * LOG_BLOCK_SIZE))
+            records = iter_raw(f, base, order, header, stats, bin_out)
+            count = 0
+            if args.output:
+                with open(args.output, "w", newline="", encoding="utf-8") as out:
+                    count = write_csv(header, records, out)
+            elif bin_out is None:
+                count = write_csv(header, records, sys.stdout)
+            else:
+                count = sum(1 for _ in records)
+        finally:
+            if bin_out is not None:
+                bin_out.close()
+    return count
+
+
+def format_time(ts, flags):
+    if flags & FLAG_TIME_UNSET:
+        return f"+{ts}s"
+    return datetime.fromtimestamp(ts, timezone.utc).astimezone().strftime("%Y-%m-%d %H:%M:%S")
+
+
+def write_csv(header, records, out):
+    names = [ch["name"] for ch in header["channels"]]
+    writer = csv.writer(out)
+    writer.writerow(["TIME"] + names + ["FLAGS", "SEQ"])
+    count = 0
+    for rec in records:
+        writer.writerow(
+            [format_time(rec["ts"], rec["flags"])]
+            + [f"{rec[n]:g}" for n in names]
+            + [f"0x{rec['flags']:02X}", rec["seq"]]
+        )
+        count += 1
+    return count
+
+
+def main():
+    parser = argparse.ArgumentParser(description="解码 SD 卡二进制日志 (LOG/*.BIN)")
+    parser.add_argument("path", help="日志文件或 LOG 目录路径；--raw 时为卡、分区设备或镜像文件")
+    parser.add_argument("-o", "--output", help="输出 CSV 文件，默认打印到屏幕")
+    parser.add_argument("--raw", action="store_true", help="导出裸分区环形日志（SD_LOG_RAW）")
+    parser.add_argument("-b", "--bin", help="--raw 时另存为版本 2 的 .BIN 文件")
+    args = parser.parse_args()
+
+    if args.raw:
+        stats = {}
+        try:
+            count = export_raw(args, stats)
+        except (OSError, LogFormatError) as exc:
+            print(f"{args.path}: {exc}", file=sys.stderr)
+            return 1
+        print(f"{count} 条记录, CRC 错误 {stats['bad_crc']}, 序号跳变 {stats['gaps']}, "
+              f"缺失块 {stats['lost_blocks']}", file=sys.stderr)
+        return 0
+
+    if os.path.isdir(args.path):
+        paths = sorted(os.path.join(args.path, name) for name in os.listdir(args.path)
+                       if name.upper().endswith(".BIN"))
+    else:
+        paths = [args.path]
+
+    stats = {}
+    header, records = None, []
+    for path in paths:
+        try:
+            header, part = read_log(path, stats)
+        except (OSError, LogFormatError) as exc:
+            print(f"{path}: {exc}", file=sys.stderr)
+            continue
+        records.extend(part)
+    if header is None:
+        print("错误: 没有可解码的日志文件", file=sys.stderr)
+        return 1
+
+    if args.output:
+        with open(args.output, "w", newline="", encoding="utf-8") as out:
+            write_csv(header, records, out)
+    else:
+        write_csv(header, records, sys.stdout)
+
+    print(f"{len(records)} 条记录, CRC 错误 {stats['bad_crc']}, 序号跳变 {stats['gaps']}",
+          file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
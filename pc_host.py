@@ -3,6 +3,8 @@ import sys
 import csv
 import json
 import random
+import struct
+import time
 from datetime import datetime
 from collections import deque
 
@@ -21,6 +23,7 @@ from PyQt5.QtWidgets import (
     QMainWindow,
     QMessageBox,
     QPlainTextEdit,
+    QProgressBar,
     QPushButton,
     QTableWidget,
     QTableWidgetItem,
@@ -35,36 +38,413 @@ import matplotlib as mpl
 from matplotlib.backends.backend_qt5agg import FigureCanvasQTAgg as FigureCanvas
 from matplotlib.figure import Figure
 
+from log_decoder import (
+    LOG_BLOCK_SIZE,
+    LOG_RECORD_SIZE,
+    LogFormatError,
+    crc16,
+    decode_record,
+    default_header,
+    read_log,
+    write_csv,
+)
+from telemetry import (
+    NEED_SCHEMA,
+    SAMPLE,
+    SCHEMA,
+    TelemetryDecoder,
+    TelemetryError,
+    cobs_decode,
+    format_sample,
+)
+
 TURB_MAX_TU = 3000.0
+QUERY_FRAME_MAGIC = 0xA5
+BULK_FRAME_MAGIC = 0xA6
+BULK_RETRY_MAX = 5      # 连续这么多次 2 秒收不到帧就当作断开，留着续传
+USB_VID = 0x0483        # 设备 USB 虚拟串口（usbcdc.h）
+USB_PID = 0x5740
+TELEM_FRAME_MAX = 256   # 遥测帧（telemetry.h）COBS 编码后的长度上限，超过就不是帧
+SCHEMA_RETRY_S = 2.0    # 收到不认识版本的采样帧时，多久重发一次 #SCHEMA
+# USART1 波特率协商（Core/Inc/uartbaud.h）：先按连接波特率连上，再请求切到高速
+FAST_BAUDS = ["不切换", "460800", "921600", "1000000", "2000000", "3000000", "4500000"]
+BAUD_REPLY_S = 2.0      # 等设备回 #OK BAUD <n> / #OK BAUD OK 的时间
+BAUD_KEEPALIVE_S = 2.0  # 高速时每隔多久发一次 #BAUD OK，设备 10 秒收不到命令就退回
+BAUD_SILENT_S = 3.0     # 高速时多久收不到完整的帧或文字行就退回
+BAUD_CRC_MAX = 3        # 高速时连续这么多帧 CRC 错就退回
+
+
+class BulkDownload:
+    """#DL 批量下载的进度，断开重连后从 next_index 续传（协议见 Core/Inc/query.h）。
+    收到的文件头和块依次追加到 path，就是版本 2 的 .BIN。"""
+
+    def __init__(self, path, t_from, t_to):
+        self.path = path
+        self.t_from = t_from
+        self.t_to = t_to
+        self.next_index = None      # 下一个要收的块编号，None 表示还没收到文件头
+        self.blocks = 0
+        self.first_ts = None
+        self.last_ts = None
+        self.done = False
+        self._file = None
+
+    def command(self):
+        if self.next_index is None:
+            return f"#DL {self.t_from} {self.t_to}\n"
+        return f"#DL {self.t_from} {self.t_to} {self.next_index}\n"
+
+    def begin(self, index, header):
+        """每次下载的第一个文件头帧：新下载时建文件，续传时接着追加。"""
+        if self.next_index is None:
+            self._file = open(self.path, "wb")
+            self._file.write(header)
+        else:
+            self._file = open(self.path, "ab")
+        # 裸分区里要续传的块已被覆盖时设备从现存最旧的块开始
+        self.next_index = index
+
+    def add(self, kind, payload):
+        if kind == "B":
+            self._file.write(payload)
+            self.blocks += 1
+            (ts,) = struct.unpack_from("<I", payload, 0)
+            if crc16(payload[:LOG_BLOCK_SIZE - 2]) == struct.unpack_from("<H", payload, LOG_BLOCK_SIZE - 2)[0]:
+                self.first_ts = ts if self.first_ts is None else self.first_ts
+                self.last_ts = ts
+        elif kind == "E":
+            self.done = True
+        self.next_index += 1
+
+    def close(self):
+        if self._file:
+            self._file.close()
+            self._file = None
+
+    def progress(self):
+        """按已收块的首条时间估算进度（0~1），块里记录的疏密不影响。"""
+        if self.done:
+            return 1.0
+        if self.first_ts is None:
+            return 0.0
+        end = min(self.t_to, int(time.time()))
+        if end <= self.first_ts:
+            return 0.0
+        return max(0.0, min(1.0, (self.last_ts - self.first_ts) / (end - self.first_ts)))
 
 
 class SerialReader(QThread):
     line_received = pyqtSignal(str)
+    telemetry_received = pyqtSignal(dict)
+    history_received = pyqtSignal(list)
+    bulk_progress = pyqtSignal(object, float)
+    bulk_finished = pyqtSignal(object)
     status = pyqtSignal(str)
     error = pyqtSignal(str)
 
-    def __init__(self, port, baudrate, parent=None):
+    def __init__(self, port, baudrate, startup_cmds=None, fast_baud=None, parent=None):
         super().__init__(parent)
         self.port = port
         self.baudrate = baudrate
+        self.startup_cmds = startup_cmds or []
+        self.fast_baud = fast_baud
         self._running = False
         self._ser = None
+        self._bulk = None
+        self._telem = TelemetryDecoder()
+        self._schema_asked = 0.0
+        self._last_seq = None
+        self._baud_state = None     # None / "request" / "confirm" / "active"
+        self._baud_deadline = 0.0
+        self._keepalive_at = 0.0
+        self._last_good = 0.0
+        self._crc_errors = 0
+
+    def start_bulk(self, download):
+        self._bulk = download
+        self.write(download.command())
+
+    def write(self, text):
+        if self._ser and self._ser.is_open:
+            try:
+                self._ser.write(text.encode("ascii"))
+            except serial.SerialException as exc:
+                self.error.emit(f"串口发送失败：{exc}")
+
+    def _read_exact(self, size):
+        buf = b""
+        idle = 0
+        while self._running and len(buf) < size and idle < 5:
+            chunk = self._ser.read(size - len(buf))
+            idle = 0 if chunk else idle + 1
+            buf += chunk
+        return buf if len(buf) == size else None
+
+    def _emit_text(self, raw):
+        for line in raw.decode(errors="ignore").splitlines():
+            line = line.strip()
+            if line and line.isprintable():
+                self._link_ok()
+                self.line_received.emit(line)
+
+    def _link_ok(self):
+        self._last_good = time.time()
+        self._crc_errors = 0
+
+    def _crc_error(self):
+        self._crc_errors += 1
+
+    def _set_baud(self, rate):
+        self._ser.baudrate = rate
+        self._ser.reset_input_buffer()
+
+    def _baud_fallback(self, reason):
+        self._baud_state = None
+        self._set_baud(self.baudrate)
+        self.status.emit(f"{reason}，退回 {self.baudrate}")
+        # 设备还在高速时这一行在它那边是接收错误，促使它也马上退回
+        self.write("#BAUD OK\n")
+
+    def _baud_line(self, line):
+        """处理设备对 #BAUD 的回复，返回 True 表示已处理。"""
+        if self._baud_state == "request" and line.startswith("#OK BAUD ") and line != "#OK BAUD OK":
+            # 设备发完这一行就切换，稍等再按新波特率确认
+            self._set_baud(int(line.split()[2]))
+            time.sleep(0.05)
+            self.write("#BAUD OK\n")
+            self._baud_state = "confirm"
+            self._baud_deadline = time.time() + BAUD_REPLY_S
+            return True
+        if self._baud_state == "confirm" and line == "#OK BAUD OK":
+            self._baud_state = "active"
+            self._keepalive_at = time.time() + BAUD_KEEPALIVE_S
+            self._link_ok()
+            self.status.emit(f"已连接 {self.port} @ {self._ser.baudrate}")
+            return True
+        if self._baud_state == "request" and line == "#ERR BAUD":
+            self._baud_state = None
+            self.status.emit(f"设备不支持 {self.fast_baud}，保持 {self.baudrate}")
+            return True
+        return False
+
+    def _baud_tick(self, keepalive=True):
+        """主循环里定时调用：等回复超时、高速下 CRC 连续出错或长时间没数据时退回连接波特率。"""
+        now = time.time()
+        if self._baud_state in ("request", "confirm") and now > self._baud_deadline:
+            if self._baud_state == "confirm":
+                self._baud_fallback(f"{self._ser.baudrate} 没有确认")
+            else:
+                self._baud_state = None
+            return
+        if self._baud_state != "active":
+            return
+        if self._crc_errors >= BAUD_CRC_MAX:
+            self._baud_fallback(f"{self._ser.baudrate} 校验连续出错")
+        elif now - self._last_good > BAUD_SILENT_S:
+            self._baud_fallback(f"{self._ser.baudrate} 收不到数据")
+        elif keepalive and now >= self._keepalive_at:
+            self._keepalive_at = now + BAUD_KEEPALIVE_S
+            self.write("#BAUD OK\n")
+
+    def _read_text(self, first):
+        """逐字节读一行文字，到 '\\n' 或 0x00（下一帧开始）为止，返回 (内容, 是否遇到 0x00)。"""
+        buf = bytearray(first)
+        while self._running:
+            b = self._ser.read(1)
+            if not b:
+                break
+            if b == b"\0":
+                return bytes(buf), True
+            buf += b
+            if b == b"\n":
+                break
+        return bytes(buf), False
+
+    def _read_frame(self):
+        """0x00 之后读一帧遥测到下一个 0x00 并解码，返回下一个字节是否还是帧的开始。
+        连接时可能从一帧中间开始读，读到的 0x00 其实是帧尾：这时中间的内容解不出来，
+        把结尾的 0x00 当作下一帧的开始，错过的最多是一帧。"""
+        raw = self._ser.read_until(b"\0", TELEM_FRAME_MAX)
+        if not raw.endswith(b"\0"):
+            self._emit_text(raw)
+            return False
+        body = raw[:-1]
+        if not body:
+            return True
+        try:
+            kind, msg = self._telem.decode(cobs_decode(body))
+        except TelemetryError:
+            self._crc_error()
+            self._emit_text(body)
+            return True
+        self._link_ok()
+
+        if kind == SCHEMA:
+            self.status.emit(f"遥测通道表版本 {msg['version']}：" +
+                             " ".join(ch["name"] for ch in msg["channels"]))
+        elif kind == NEED_SCHEMA:
+            if time.time() - self._schema_asked > SCHEMA_RETRY_S:
+                self._schema_asked = time.time()
+                self.write("#SCHEMA\n")
+        elif kind == SAMPLE:
+            if self._last_seq is not None:
+                lost = (msg["seq"] - self._last_seq - 1) & 0xFFFF
+                if 0 < lost < 0x8000:
+                    self.status.emit(f"遥测丢了 {lost} 帧（序号 {msg['seq']}）")
+            self._last_seq = msg["seq"]
+            self.telemetry_received.emit(msg)
+        return False
+
+    def _read_history(self):
+        """#QBEGIN 之后的二进制帧：0xA5, n, n 条 16 字节记录；n 为 0 表示结束。"""
+        header = default_header()
+        records = []
+        while self._running:
+            head = self._read_exact(2)
+            if not head or head[0] != QUERY_FRAME_MAGIC or head[1] == 0:
+                break
+            payload = self._read_exact(head[1] * LOG_RECORD_SIZE)
+            if payload is None:
+                break
+            for off in range(0, len(payload), LOG_RECORD_SIZE):
+                rec = decode_record(header, payload[off:off + LOG_RECORD_SIZE])
+                if rec is not None:
+                    records.append(rec)
+        return records
+
+    def _read_bulk_frame(self):
+        """读一帧批量下载数据，返回 (类型, 编号, 数据)；超时返回 None，校验错返回 False，
+        设备结束或放弃时（#END / #ERR / #OK 行）返回该行文字。"""
+        idle = 0
+        while True:
+            if not self._running:
+                return None
+            b = self._ser.read(1)
+            if not b:
+                idle += 1
+                if idle >= 2:
+                    return None
+                continue
+            if b[0] == BULK_FRAME_MAGIC:
+                break
+            if b == b"#":
+                line = (b + self._ser.readline()).decode(errors="ignore").strip()
+                if line.startswith(("#END", "#ERR", "#OK")):
+                    return line
+
+        head = self._read_exact(5)
+        if head is None:
+            return None
+        kind = chr(head[0])
+        if kind not in "HBSE":
+            return False
+        size = LOG_BLOCK_SIZE if kind in "HB" else 0
+        rest = self._read_exact(size + 2)
+        if rest is None:
+            return None
+        payload = rest[:size]
+        (crc,) = struct.unpack_from("<H", rest, size)
+        if crc != crc16(head + payload):
+            return False
+        (index,) = struct.unpack_from("<I", head, 1)
+        return kind, index, payload
+
+    def _read_bulk(self, dl):
+        """#DLBEGIN 之后：按编号顺序收帧，每收一帧回 #ACK，出错回 #NAK 让设备从断点重发。"""
+        started = False
+        nak_sent = None
+        timeouts = 0
+        t0 = time.time()
+        blocks0 = dl.blocks
+        try:
+            while self._running and not dl.done:
+                # 下载期间 #ACK 就能让设备保持高速，不另发 #BAUD OK
+                self._baud_tick(keepalive=False)
+                frame = self._read_bulk_frame()
+                if isinstance(frame, str):
+                    self.line_received.emit(frame)
+                    break
+                if frame is None:
+                    timeouts += 1
+                    if timeouts > BULK_RETRY_MAX:
+                        break
+                    self.write(f"#NAK {dl.next_index if started else 0}\n")
+                    continue
+                timeouts = 0
+                expected = dl.next_index if started else 0
+                if frame is False:
+                    self._crc_error()
+                    if nak_sent != expected:
+                        self.write(f"#NAK {expected}\n")
+                        nak_sent = expected
+                    continue
+
+                kind, index, payload = frame
+                self._link_ok()
+                if kind == "H":
+                    if not started:
+                        dl.begin(index, payload)
+                        started = True
+                    continue
+                if not started or index > dl.next_index:
+                    if nak_sent != expected:
+                        self.write(f"#NAK {expected}\n")
+                        nak_sent = expected
+                    continue
+                if index < dl.next_index:
+                    # 设备没收到之前的应答，重发了已收到的帧
+                    self.write(f"#ACK {dl.next_index}\n")
+                    continue
+
+                nak_sent = None
+                dl.add(kind, payload)
+                self.write(f"#ACK {dl.next_index}\n")
+                rate = (dl.blocks - blocks0) * LOG_BLOCK_SIZE / max(time.time() - t0, 0.001)
+                self.bulk_progress.emit(dl, rate)
+        finally:
+            dl.close()
+        if not dl.done and self._running:
+            self.write("#STOP\n")
+        self._bulk = None
+        self.bulk_finished.emit(dl)
 
     def run(self):
         try:
             self._ser = serial.Serial(self.port, self.baudrate, timeout=1)
             self.status.emit(f"已连接 {self.port} @ {self.baudrate}")
             self._running = True
+            for cmd in self.startup_cmds:
+                self.write(cmd)
+            if self.fast_baud and self.fast_baud != self.baudrate:
+                self._baud_state = "request"
+                self._baud_deadline = time.time() + BAUD_REPLY_S
+                self.write(f"#BAUD {self.fast_baud}\n")
+            in_frame = False
             while self._running:
+                raw = b""
                 try:
-                    raw = self._ser.readline()
+                    self._baud_tick()
+                    if in_frame:
+                        in_frame = self._read_frame()
+                        continue
+                    b = self._ser.read(1)
+                    if b == b"\0":
+                        in_frame = True
+                        continue
+                    if b:
+                        raw, in_frame = self._read_text(b)
+                    if raw.startswith(b"#QBEGIN"):
+                        self.history_received.emit(self._read_history())
+                        continue
+                    if raw.startswith(b"#DLBEGIN") and self._bulk:
+                        self._read_bulk(self._bulk)
+                        continue
+                    if raw.startswith(b"#") and self._baud_line(raw.decode(errors="ignore").strip()):
+                        continue
                 except serial.SerialException as exc:
                     self.error.emit(f"串口读取失败：{exc}")
                     break
-                if raw:
-                    line = raw.decode(errors="ignore").strip()
-                    if line:
-                        self.line_received.emit(line)
+                self._emit_text(raw)
         except (serial.SerialException, OSError) as exc:
             self.error.emit(f"串口打开失败：{exc}")
         finally:
@@ -95,6 +475,8 @@ class WaterQualityHost(QMainWindow):
         self.sim_timer.timeout.connect(self.generate_simulated_data)
 
         self.records = []
+        self.last_sample_ts = None
+        self.download = None
         self.series = deque(maxlen=60)
         self.raw_lines = deque(maxlen=8)
 
@@ -166,14 +548,19 @@ class WaterQualityHost(QMainWindow):
         form_layout = QFormLayout()
         self.port_box = QComboBox()
         self.manual_port = QLineEdit()
-        self.manual_port.setPlaceholderText("手动输入端口，如 /dev/cu.usbserial 或 COM3")
+        self.manual_port.setPlaceholderText("手动输入端口，如 /dev/ttyACM0、/dev/cu.usbserial 或 COM3")
         self.manual_port.setClearButtonEnabled(True)
         self.baud_box = QComboBox()
         self.baud_box.addItems(["9600", "115200", "256000"])
         self.baud_box.setCurrentText("115200")
+        # 连上后和设备协商切到高速，出错自动退回上面的波特率；USB 虚拟串口不用
+        self.fast_box = QComboBox()
+        self.fast_box.addItems(FAST_BAUDS)
+        self.fast_box.setCurrentText("921600")
         form_layout.addRow("串口", self.port_box)
         form_layout.addRow("手动端口", self.manual_port)
         form_layout.addRow("波特率", self.baud_box)
+        form_layout.addRow("高速波特率", self.fast_box)
         conn_layout.addLayout(form_layout)
 
         btn_row = QHBoxLayout()
@@ -182,6 +569,13 @@ class WaterQualityHost(QMainWindow):
         self.disconnect_btn = QPushButton("断开")
         self.disconnect_btn.setEnabled(False)
         self.simulate_btn = QPushButton("模拟数据")
+        self.history_btn = QPushButton("读取SD历史")
+        self.history_btn.setEnabled(False)
+        self.download_btn = QPushButton("批量下载")
+        self.download_btn.setEnabled(False)
+        self.history_hours = QComboBox()
+        self.history_hours.addItems(["1", "6", "24", "72", "全部"])
+        self.history_hours.setCurrentText("6")
         self.connect_btn.setObjectName("PrimaryBtn")
         self.simulate_btn.setObjectName("WarnBtn")
         btn_row.addWidget(self.refresh_btn)
@@ -190,6 +584,19 @@ class WaterQualityHost(QMainWindow):
         btn_row.addWidget(self.simulate_btn)
         conn_layout.addLayout(btn_row)
 
+        history_row = QHBoxLayout()
+        history_row.addWidget(QLabel("最近(小时)"))
+        history_row.addWidget(self.history_hours)
+        history_row.addWidget(self.history_btn)
+        history_row.addWidget(self.download_btn)
+        conn_layout.addLayout(history_row)
+
+        self.download_bar = QProgressBar()
+        self.download_bar.setRange(0, 1000)
+        self.download_bar.setFormat("%p%")
+        self.download_bar.setVisible(False)
+        conn_layout.addWidget(self.download_bar)
+
         self.status_label = QLabel("状态：未连接")
         self.status_label.setObjectName("MutedText")
         self.status_label.setStyleSheet("color:#6b7280")
@@ -203,6 +610,8 @@ class WaterQualityHost(QMainWindow):
         self.connect_btn.clicked.connect(self.connect_serial)
         self.disconnect_btn.clicked.connect(self.disconnect_serial)
         self.simulate_btn.clicked.connect(self.toggle_simulation)
+        self.history_btn.clicked.connect(self.request_history)
+        self.download_btn.clicked.connect(self.request_download)
 
         metrics_group = QGroupBox("实时参数")
         metrics_layout = QGridLayout(metrics_group)
@@ -275,7 +684,10 @@ class WaterQualityHost(QMainWindow):
 
     def refresh_ports(self):
         self.port_box.clear()
-        ports = serial.tools.list_ports.comports()
+        # 设备的 USB 虚拟串口（VID 0483 / PID 5740，Linux 下为 /dev/ttyACM0）排在最前面，
+        # 它比 USART1 快得多，波特率设置对它不起作用
+        ports = sorted(serial.tools.list_ports.comports(),
+                       key=lambda p: (p.vid, p.pid) != (USB_VID, USB_PID))
         for port in ports:
             desc = port.description or "未知设备"
             hwid = port.hwid or "HWID?"
@@ -295,20 +707,107 @@ class WaterQualityHost(QMainWindow):
         if not port or port == "未检测到串口":
             QMessageBox.warning(self, "提示", "请先连接串口设备。")
             return
+        usb = f"{USB_VID:04X}:{USB_PID:04X}" in port.upper()
         if "|" in port:
             port = port.split("|", 1)[0].strip()
         try:
             baud = int(self.baud_box.currentText())
         except ValueError:
             baud = 115200
-        self.reader = SerialReader(port, baud)
+        fast = None if usb or not self.fast_box.currentText().isdigit() else int(self.fast_box.currentText())
+        # 连接后先给设备校时；之前连过的话，把断开期间 SD 卡上的记录补传回来
+        now = int(time.time())
+        cmds = [f"#TIME {now}\n", "#SCHEMA\n"]
+        if self.last_sample_ts is not None:
+            cmds.append(f"#Q {self.last_sample_ts + 1} {now}\n")
+        self.reader = SerialReader(port, baud, cmds, fast)
         self.reader.line_received.connect(self.handle_line)
+        self.reader.telemetry_received.connect(self.handle_telemetry)
+        self.reader.history_received.connect(self.handle_history)
+        self.reader.bulk_progress.connect(self.handle_download_progress)
+        self.reader.bulk_finished.connect(self.handle_download_finished)
         self.reader.status.connect(self.set_status)
         self.reader.error.connect(self.show_error)
         self.reader.start()
         self.connect_btn.setEnabled(False)
         self.disconnect_btn.setEnabled(True)
         self.simulate_btn.setEnabled(False)
+        self.history_btn.setEnabled(True)
+        self.download_btn.setEnabled(True)
+
+    def history_range(self):
+        """下拉框选的时间范围 (起始, 结束, 说明)。"""
+        now = int(time.time())
+        text = self.history_hours.currentText()
+        if not text.isdigit():
+            return 0, now, "全部"
+        return now - int(text) * 3600, now, f"最近 {text} 小时"
+
+    def request_history(self):
+        if not self.reader:
+            return
+        t_from, t_to, desc = self.history_range()
+        self.reader.write(f"#Q {t_from} {t_to}\n")
+        self.set_status(f"正在读取{desc}的 SD 记录…")
+
+    def request_download(self):
+        """按块下载 SD 日志存成 .BIN（再解码出同名 .csv）；上次没下完时接着下。"""
+        if not self.reader:
+            return
+        if self.download is None or self.download.done:
+            t_from, t_to, desc = self.history_range()
+            path, _ = QFileDialog.getSaveFileName(self, "批量下载", "data.BIN", "Log Files (*.BIN)")
+            if not path:
+                return
+            self.download = BulkDownload(path, t_from, t_to)
+            self.set_status(f"正在下载{desc}的 SD 日志…")
+        else:
+            self.set_status(f"从第 {self.download.blocks} 块续传…")
+        self.download_btn.setEnabled(False)
+        self.history_btn.setEnabled(False)
+        self.download_bar.setValue(int(self.download.progress() * 1000))
+        self.download_bar.setVisible(True)
+        self.reader.start_bulk(self.download)
+
+    def handle_download_progress(self, dl, rate):
+        self.download_bar.setValue(int(dl.progress() * 1000))
+        self.download_bar.setFormat(f"%p%  {dl.blocks} 块  {rate / 1024:.1f} KB/s")
+
+    def handle_download_finished(self, dl):
+        self.download_btn.setEnabled(self.reader is not None)
+        self.history_btn.setEnabled(self.reader is not None)
+        if not dl.done:
+            self.download_btn.setText("续传下载")
+            self.set_status(f"下载中断，已收 {dl.blocks} 块，连接后点“续传下载”接着下")
+            return
+
+        self.download_btn.setText("批量下载")
+        self.download_bar.setValue(1000)
+        csv_path = dl.path.rsplit(".", 1)[0] + ".csv"
+        try:
+            header, records = read_log(dl.path)
+            records = [r for r in records if dl.t_from <= r["ts"] <= dl.t_to]
+            with open(csv_path, "w", newline="", encoding="utf-8") as out:
+                count = write_csv(header, records, out)
+        except (OSError, LogFormatError) as exc:
+            QMessageBox.critical(self, "错误", f"解码失败：{exc}")
+            return
+        self.set_status(f"下载完成：{dl.blocks} 块，{count} 条记录 -> {csv_path}")
+
+    def handle_history(self, records):
+        for rec in records:
+            record = {
+                "time": datetime.fromtimestamp(rec["ts"]).strftime("%m-%d %H:%M:%S"),
+                "ph": rec["PH"],
+                "temp": rec["TEMP"],
+                "tds": rec["TDS"],
+                "turb": max(0.0, min(100.0, rec["TURB"] * 100.0 / TURB_MAX_TU)),
+                "raw": f"SD #{rec['seq']} flags=0x{rec['flags']:02X}",
+            }
+            self.records.append(record)
+            self.add_table_row(record)
+        self.record_count.setText(f"记录条数：{len(self.records)}")
+        self.set_status(f"已从 SD 卡补传 {len(records)} 条记录")
 
     def disconnect_serial(self):
         if self.reader:
@@ -319,6 +818,8 @@ class WaterQualityHost(QMainWindow):
         self.connect_btn.setEnabled(True)
         self.disconnect_btn.setEnabled(False)
         self.simulate_btn.setEnabled(True)
+        self.history_btn.setEnabled(False)
+        self.download_btn.setEnabled(False)
 
     def toggle_simulation(self):
         if self.sim_timer.isActive():
@@ -342,8 +843,15 @@ class WaterQualityHost(QMainWindow):
     def handle_line(self, line):
         data = self.parse_line(line)
         if data:
+            self.last_sample_ts = int(time.time())
             self.update_data(data, line)
 
+    def handle_telemetry(self, sample):
+        data = self.normalize_payload(sample["values"])
+        if data:
+            self.last_sample_ts = int(time.time())
+            self.update_data(data, format_sample(sample))
+
     def parse_line(self, line):
         line = line.strip()
         if not line:
@@ -80,7 +80,7 @@ LoopCopyDataInit:
   cmp r4, r1
   bcc CopyDataInit
   
-/* Zero fill the bss segment. */
+/* Zero fill the bss segment. The .noinit section lies after _ebss and is left as is. */
   ldr r2, =_sbss
   ldr r4, =_ebss
   movs r3, #0
@@ -0,0 +1,144 @@
+# -*- coding: utf-8 -*-
+"""实时遥测二进制帧解码，帧格式见 Core/Inc/telemetry.h。
+
+串口上二进制帧和文字行混在一起：0x00 开始一帧，读到下一个 0x00 为止，中间是 COBS 编码的
+帧内容 + CRC16。采样帧按设备发来的通道表帧（'S'）解码，通道、类型和定点比例都不写死在这里；
+遇到没见过的版本号时先返回 NEED_SCHEMA，由调用者发 "#SCHEMA" 请设备重发通道表。
+
+用法（pc_host.py 里的 SerialReader 就是这样用的）:
+    dec = TelemetryDecoder()
+    kind, msg = dec.decode(cobs_decode(frame))
+"""
+import struct
+
+from log_decoder import FLAG_TIME_UNSET, TYPE_CODES, crc16
+
+TELEM_TYPE_SAMPLE = ord("T")
+TELEM_TYPE_SCHEMA = ord("S")
+
+SAMPLE_FMT = "<BBHIBB"          # 类型, 版本, 序号, 时间, 标志, 通道数
+SCHEMA_FMT = "<BBB"             # 类型, 版本, 通道数
+SCHEMA_ITEM_FMT = "<8s4sBH"     # 名称, 单位, 类型, scale
+
+# decode() 返回的种类
+SAMPLE = "sample"
+SCHEMA = "schema"
+NEED_SCHEMA = "need_schema"
+
+
+class TelemetryError(Exception):
+    pass
+
+
+def cobs_encode(data):
+    """COBS 编码（不含前后的 0x00），与 telemetry.c 的 Telemetry_Emit 一致，测试用。"""
+    out = bytearray([0])
+    code_pos, code = 0, 1
+    for b in data:
+        if b == 0:
+            out[code_pos] = code
+            code_pos, code = len(out), 1
+            out.append(0)
+            continue
+        out.append(b)
+        code += 1
+        if code == 0xFF:
+            out[code_pos] = code
+            code_pos, code = len(out), 1
+            out.append(0)
+    out[code_pos] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    """COBS 解码（不含前后的 0x00），格式不对时抛 TelemetryError。"""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise TelemetryError("COBS 编码错误")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class TelemetryDecoder:
+    """按版本缓存设备发来的通道表，解码采样帧。"""
+
+    def __init__(self):
+        self.schemas = {}
+
+    def decode(self, body):
+        """body 为 COBS 解码后的帧（含末尾 CRC16）。
+        返回 (SCHEMA, 通道表) / (SAMPLE, 采样) / (NEED_SCHEMA, 版本号)，CRC 或格式不对时抛 TelemetryError。
+        采样为 {"seq", "ts", "flags", "values": {通道名: 物理值}}。"""
+        if len(body) < 4:
+            raise TelemetryError("帧太短")
+        (crc,) = struct.unpack_from("<H", body, len(body) - 2)
+        body = body[:-2]
+        if crc != crc16(body):
+            raise TelemetryError("CRC 错误")
+
+        kind = body[0]
+        if kind == TELEM_TYPE_SCHEMA:
+            return SCHEMA, self._decode_schema(body)
+        if kind == TELEM_TYPE_SAMPLE:
+            return self._decode_sample(body)
+        raise TelemetryError(f"未知帧类型 0x{kind:02X}")
+
+    def _decode_schema(self, body):
+        _, version, count = struct.unpack_from(SCHEMA_FMT, body, 0)
+        off = struct.calcsize(SCHEMA_FMT)
+        if len(body) != off + count * struct.calcsize(SCHEMA_ITEM_FMT):
+            raise TelemetryError("通道表长度不对")
+
+        channels = []
+        for _ in range(count):
+            name, unit, ctype, scale = struct.unpack_from(SCHEMA_ITEM_FMT, body, off)
+            if ctype not in TYPE_CODES or scale == 0:
+                raise TelemetryError(f"通道类型 {ctype} / scale {scale} 不支持")
+            channels.append({
+                "name": name.rstrip(b"\0").decode("ascii"),
+                "unit": unit.rstrip(b"\0").decode("ascii"),
+                "code": TYPE_CODES[ctype],
+                "scale": scale,
+            })
+            off += struct.calcsize(SCHEMA_ITEM_FMT)
+
+        schema = {"version": version, "channels": channels}
+        self.schemas[version] = schema
+        return schema
+
+    def _decode_sample(self, body):
+        _, version, seq, ts, flags, count = struct.unpack_from(SAMPLE_FMT, body, 0)
+        schema = self.schemas.get(version)
+        if schema is None:
+            return NEED_SCHEMA, version
+
+        channels = schema["channels"]
+        off = struct.calcsize(SAMPLE_FMT)
+        if count != len(channels) or len(body) != off + 2 * count:
+            raise TelemetryError(f"采样帧和版本 {version} 的通道表不符")
+
+        values = {}
+        for ch in channels:
+            (raw,) = struct.unpack_from("<" + ch["code"], body, off)
+            values[ch["name"]] = raw / ch["scale"]
+            off += 2
+        return SAMPLE, {"seq": seq, "ts": ts, "flags": flags, "values": values}
+
+
+def format_sample(sample):
+    """采样的文字形式，上位机原始数据栏显示用。"""
+    fields = [f"#{sample['seq']}"]
+    if sample["flags"] & FLAG_TIME_UNSET:
+        fields.append(f"+{sample['ts']}s")
+    else:
+        fields.append(str(sample["ts"]))
+    fields += [f"{name}={value:g}" for name, value in sample["values"].items()]
+    if sample["flags"] & ~FLAG_TIME_UNSET:
+        fields.append(f"FLAGS=0x{sample['flags']:02X}")
+    return " ".join(fields)
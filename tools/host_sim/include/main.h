@@ -0,0 +1,10 @@
+/* 主机仿真：ffconf.h 会包含 main.h，这里不需要任何内容 */
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include "stm32f1xx_hal.h"
+
+/* 段名不带点，链接器生成 __start_noinit / __stop_noinit，sim_flash.c 据此保存和恢复（仿真热复位） */
+#define NOINIT_RAM  __attribute__((section("noinit")))
+
+#endif
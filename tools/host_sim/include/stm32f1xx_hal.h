@@ -0,0 +1,58 @@
+/*
+ * 主机仿真用的 HAL 替身：只提供 sdcard.c / flashlog.c / FatFs 用到的那几个类型和函数，
+ * 时钟由 sim_diskio.c 里的仿真时间驱动（见 sim_diskio.h），Flash 由 sim_flash.c 仿真。
+ */
+
+#ifndef __STM32F1xx_HAL_H
+#define __STM32F1xx_HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define __IO    volatile
+#define __weak  __attribute__((weak))
+
+typedef struct
+{
+    uint32_t PVDLevel;
+    uint32_t Mode;
+} PWR_PVDTypeDef;
+
+#define PWR_PVDLEVEL_7          0x000000E0U
+#define PWR_PVD_MODE_IT_RISING  0x00010001U
+#define PVD_IRQn                1
+
+typedef enum
+{
+    HAL_OK = 0,
+    HAL_ERROR,
+} HAL_StatusTypeDef;
+
+/* 仿真的 Flash 是主机上的数组，地址用 uintptr_t（目标板上是 uint32_t） */
+typedef struct
+{
+    uint32_t  TypeErase;
+    uint32_t  Banks;
+    uintptr_t PageAddress;
+    uint32_t  NbPages;
+} FLASH_EraseInitTypeDef;
+
+#define FLASH_TYPEERASE_PAGES       0x00U
+#define FLASH_TYPEPROGRAM_HALFWORD  0x01U
+
+uint32_t HAL_GetTick(void);
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+
+static inline void HAL_PWR_ConfigPVD(PWR_PVDTypeDef *pvd) { (void)pvd; }
+static inline void HAL_PWR_EnablePVD(void) { }
+static inline void HAL_NVIC_SetPriority(int irq, uint32_t pre, uint32_t sub) { (void)irq; (void)pre; (void)sub; }
+static inline void HAL_NVIC_EnableIRQ(int irq) { (void)irq; }
+
+/* 由 sdcard.c 实现，仿真程序可以直接调用来模拟供电跌落 */
+void HAL_PWR_PVDCallback(void);
+
+#endif
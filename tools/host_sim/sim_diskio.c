@@ -0,0 +1,329 @@
+/*
+ * 主机仿真磁盘实现，提供 user_diskio.h 声明的 USER_Driver
+ */
+
+#include "sim_diskio.h"
+
+#include "fatfs.h"
+#include "sdcache.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SIM_SECTOR_SIZE     512U
+
+static int       s_fd = -1;
+static uint8_t  *s_image = NULL;
+static uint32_t  s_sectors = 0;
+static uint32_t *s_writeCount = NULL;
+static SimDiskConfig_t s_cfg;
+static SimDiskStats_t  s_stats;
+static SD_CacheStats_t s_cacheBase;     /* 上次清零时的缓存统计 */
+
+static uint8_t   s_present = 1;     /* 0: 卡被拔出，所有访问失败 */
+static uint64_t  s_tickUs = 0;      /* 仿真时间，微秒 */
+static uint64_t  s_busyUntil = 0;   /* 卡后台编程结束的仿真时间 */
+
+uint32_t HAL_GetTick(void)
+{
+    return (uint32_t)(s_tickUs / 1000U);
+}
+
+void SimDisk_AdvanceMs(uint32_t ms)
+{
+    s_tickUs += (uint64_t)ms * 1000U;
+}
+
+static void SimDisk_Delay(uint64_t us)
+{
+    s_tickUs += us;
+    s_stats.busy_us += us;
+    if (s_cfg.real_sleep && us != 0U)
+    {
+        usleep((useconds_t)us);
+    }
+}
+
+/* 和 user_diskio.c 一样：写命令后的编程忙在后台进行，下一次访问时还没结束才需要等 */
+static void SimDisk_WaitIdle(void)
+{
+    if (s_tickUs < s_busyUntil)
+    {
+        SimDisk_Delay(s_busyUntil - s_tickUs);
+    }
+}
+
+uint8_t USER_IsBusy(void)
+{
+    return (s_tickUs < s_busyUntil) ? 1U : 0U;
+}
+
+/* 按挂载后的卷参数判断扇区属于哪个区域；未挂载（格式化期间或裸分区模式）时
+ * 扇区 0 算引导区，其它都算数据区 */
+static void SimDisk_Classify(uint32_t sector)
+{
+    const FATFS *fs = &USERFatFS;
+
+    if (fs->fs_type == 0U)
+    {
+        if (sector == 0U)
+        {
+            s_stats.write_boot++;
+        }
+        else
+        {
+            s_stats.write_data++;
+        }
+    }
+    else if (sector < fs->fatbase)
+    {
+        s_stats.write_boot++;
+    }
+    else if (sector < fs->fatbase + fs->fsize * fs->n_fats)
+    {
+        s_stats.write_fat++;
+    }
+    else if (sector < fs->database)
+    {
+        s_stats.write_root++;
+    }
+    else
+    {
+        s_stats.write_data++;
+    }
+
+    if (s_writeCount[sector]++ != 0U)
+    {
+        s_stats.rewrite_sectors++;
+    }
+}
+
+
+static DSTATUS SimDisk_Status(BYTE pdrv)
+{
+    (void)pdrv;
+    return (s_image != NULL && s_present) ? 0 : STA_NOINIT;
+}
+
+/* 以下两个是“卡”本身的读写，和 user_diskio.c 一样经 sdcache.c 调用 */
+static DRESULT SimDisk_ReadSectors(BYTE *buff, DWORD sector, UINT count)
+{
+    if (sector + count > s_sectors || count == 0U)
+    {
+        return RES_PARERR;
+    }
+    if (!s_present)
+    {
+        return RES_NOTRDY;
+    }
+
+    SimDisk_WaitIdle();
+    memcpy(buff, s_image + (size_t)sector * SIM_SECTOR_SIZE, (size_t)count * SIM_SECTOR_SIZE);
+    s_stats.read_cmds++;
+    s_stats.read_sectors += count;
+    SimDisk_Delay((uint64_t)s_cfg.read_us * count);
+    return RES_OK;
+}
+
+static DRESULT SimDisk_WriteSectors(const BYTE *buff, DWORD sector, UINT count)
+{
+    if (sector + count > s_sectors || count == 0U)
+    {
+        return RES_PARERR;
+    }
+    if (!s_present)
+    {
+        return RES_NOTRDY;
+    }
+
+    SimDisk_WaitIdle();
+    memcpy(s_image + (size_t)sector * SIM_SECTOR_SIZE, buff, (size_t)count * SIM_SECTOR_SIZE);
+    s_stats.write_cmds++;
+    s_stats.write_sectors += count;
+    for (UINT i = 0; i < count; i++)
+    {
+        SimDisk_Classify((uint32_t)(sector + i));
+    }
+    SimDisk_Delay((uint64_t)s_cfg.write_us * count);
+    s_busyUntil = s_tickUs + s_cfg.busy_us;
+    return RES_OK;
+}
+
+static DSTATUS SimDisk_Initialize(BYTE pdrv)
+{
+    (void)pdrv;
+    if (s_image == NULL || !s_present)
+    {
+        return STA_NOINIT;
+    }
+    SD_Cache_Init(SimDisk_ReadSectors, SimDisk_WriteSectors);
+    return 0;
+}
+
+static DRESULT SimDisk_Read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    (void)pdrv;
+    return SD_Cache_Read(buff, sector, count);
+}
+
+static DRESULT SimDisk_Write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    (void)pdrv;
+    return SD_Cache_Write(buff, sector, count);
+}
+
+static DRESULT SimDisk_Ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    DRESULT res;
+
+    (void)pdrv;
+    switch (cmd)
+    {
+        case CTRL_SYNC:
+            res = SD_Cache_Sync();
+            SimDisk_WaitIdle();
+            return res;
+
+        case GET_SECTOR_SIZE:
+            *(WORD *)buff = SIM_SECTOR_SIZE;
+            return RES_OK;
+
+        case GET_BLOCK_SIZE:
+            *(DWORD *)buff = s_cfg.erase_block;
+            return RES_OK;
+
+        case GET_SECTOR_COUNT:
+            *(DWORD *)buff = s_sectors;
+            return RES_OK;
+
+        default:
+            return RES_PARERR;
+    }
+}
+
+Diskio_drvTypeDef USER_Driver =
+{
+    SimDisk_Initialize,
+    SimDisk_Status,
+    SimDisk_Read,
+    SimDisk_Write,
+    SimDisk_Ioctl,
+};
+
+int SimDisk_Open(const char *path, uint32_t size_mb, const SimDiskConfig_t *cfg)
+{
+    struct stat st;
+
+    s_cfg = *cfg;
+    if (s_cfg.erase_block == 0U)
+    {
+        s_cfg.erase_block = 1U;
+    }
+
+    s_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (s_fd < 0 || fstat(s_fd, &st) != 0)
+    {
+        perror(path);
+        return -1;
+    }
+
+    /* 新文件按 size_mb 建稀疏文件 */
+    if (st.st_size == 0)
+    {
+        st.st_size = (off_t)size_mb * 1024 * 1024;
+        if (ftruncate(s_fd, st.st_size) != 0)
+        {
+            perror("ftruncate");
+            return -1;
+        }
+    }
+
+    s_sectors = (uint32_t)(st.st_size / SIM_SECTOR_SIZE);
+    s_image = mmap(NULL, (size_t)s_sectors * SIM_SECTOR_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, s_fd, 0);
+    if (s_image == MAP_FAILED)
+    {
+        perror("mmap");
+        s_image = NULL;
+        return -1;
+    }
+
+    s_writeCount = calloc(s_sectors, sizeof(uint32_t));
+    return (s_writeCount != NULL) ? 0 : -1;
+}
+
+void SimDisk_Close(void)
+{
+    if (s_image != NULL)
+    {
+        msync(s_image, (size_t)s_sectors * SIM_SECTOR_SIZE, MS_SYNC);
+        munmap(s_image, (size_t)s_sectors * SIM_SECTOR_SIZE);
+        s_image = NULL;
+    }
+    if (s_fd >= 0)
+    {
+        close(s_fd);
+        s_fd = -1;
+    }
+    free(s_writeCount);
+    s_writeCount = NULL;
+}
+
+void SimDisk_SetPresent(uint8_t present)
+{
+    s_present = present;
+}
+
+uint32_t SimDisk_Sectors(void)
+{
+    return s_sectors;
+}
+
+void SimDisk_ResetStats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(s_writeCount, 0, (size_t)s_sectors * sizeof(uint32_t));
+    SD_Cache_GetStats(&s_cacheBase);
+}
+
+const SimDiskStats_t *SimDisk_GetStats(void)
+{
+    SD_CacheStats_t cs;
+
+    SD_Cache_GetStats(&cs);
+    s_stats.cache_hits = cs.hits - s_cacheBase.hits;
+    s_stats.cache_misses = cs.misses - s_cacheBase.misses;
+    s_stats.cache_absorbed = cs.absorbed - s_cacheBase.absorbed;
+    s_stats.cache_written = cs.written - s_cacheBase.written;
+    return &s_stats;
+}
+
+uint32_t SimDisk_HotSectors(uint32_t *sector, uint32_t *count, uint32_t n)
+{
+    uint32_t found = 0;
+
+    /* n 很小，逐个插入排序即可 */
+    for (uint32_t s = 0; s < s_sectors; s++)
+    {
+        uint32_t c = s_writeCount[s];
+        if (c < 2U || (found == n && c <= count[n - 1U]))
+        {
+            continue;
+        }
+
+        uint32_t i = (found < n) ? found++ : n - 1U;
+        while (i > 0U && count[i - 1U] < c)
+        {
+            sector[i] = sector[i - 1U];
+            count[i] = count[i - 1U];
+            i--;
+        }
+        sector[i] = s;
+        count[i] = c;
+    }
+    return found;
+}
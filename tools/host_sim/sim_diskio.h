@@ -0,0 +1,59 @@
+/*
+ * 主机仿真磁盘：用 mmap 映射一个 FAT 镜像文件，代替 FATFS/Target/user_diskio.c 里的 SPI-SD 驱动
+ * - 按扇区注入可配置的读写延迟，延迟计入仿真时间（HAL_GetTick），可选真实 usleep
+ * - 统计读写命令数、扇区数，按 引导区 / FAT / 根目录 / 数据区 分类统计写扇区，
+ *   以及每个扇区被写的次数（找出反复改写的热点扇区）
+ */
+
+#ifndef __SIM_DISKIO_H
+#define __SIM_DISKIO_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t read_us;       /* 每扇区读延迟 */
+    uint32_t write_us;      /* 每扇区写延迟 */
+    uint32_t busy_us;       /* 每次写命令结束后卡在后台编程的时间（USER_IsBusy 为 1） */
+    uint32_t erase_block;   /* GET_BLOCK_SIZE 返回的擦除块大小（扇区） */
+    uint8_t  real_sleep;    /* 1: 按延迟真实 usleep，0: 只计入仿真时间 */
+} SimDiskConfig_t;
+
+typedef struct
+{
+    uint64_t read_cmds;
+    uint64_t read_sectors;
+    uint64_t write_cmds;
+    uint64_t write_sectors;
+    uint64_t write_boot;        /* MBR / 引导扇区 / FSINFO */
+    uint64_t write_fat;
+    uint64_t write_root;        /* FAT12/16 固定根目录区 */
+    uint64_t write_data;        /* 数据区（含 FAT32 根目录和子目录） */
+    uint64_t rewrite_sectors;   /* 本轮统计中已经写过又再次写的扇区数 */
+    uint64_t busy_us;           /* 在驱动里阻塞的时间累计：读写传输 + 等上一次编程结束 */
+    uint32_t cache_hits;        /* 元数据缓存（sdcache.c）读命中 / 未命中 */
+    uint32_t cache_misses;
+    uint32_t cache_absorbed;    /* 写入缓存的元数据扇区次数 / 其中实际写卡的扇区数 */
+    uint32_t cache_written;
+} SimDiskStats_t;
+
+/* 打开（必要时创建）镜像文件并映射，size_mb 仅在新建时使用。返回 0 成功 */
+int  SimDisk_Open(const char *path, uint32_t size_mb, const SimDiskConfig_t *cfg);
+void SimDisk_Close(void);
+
+uint32_t SimDisk_Sectors(void);
+
+/* 模拟拔卡（0）和插回（1）：拔出期间初始化和读写都失败 */
+void SimDisk_SetPresent(uint8_t present);
+
+/* 统计清零（包括每扇区写次数），用来排除格式化和挂载阶段的读写 */
+void SimDisk_ResetStats(void);
+const SimDiskStats_t *SimDisk_GetStats(void);
+
+/* 被写次数最多的 n 个扇区，返回实际个数 */
+uint32_t SimDisk_HotSectors(uint32_t *sector, uint32_t *count, uint32_t n);
+
+/* 仿真时间前进 ms 毫秒（主循环的采样间隔） */
+void SimDisk_AdvanceMs(uint32_t ms);
+
+#endif
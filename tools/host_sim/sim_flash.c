@@ -0,0 +1,144 @@
+/*
+ * 主机仿真片内 Flash 实现
+ */
+
+#include "sim_flash.h"
+
+#include "flashlog.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SIM_FLASH_SIZE  (FLASH_LOG_PAGES * FLASH_LOG_PAGE_SIZE)
+
+/* 链接脚本里的 FLASHLOG 区 */
+uint8_t _flashlog_start[SIM_FLASH_SIZE] __attribute__((aligned(4)));
+
+/* NOINIT_RAM 变量所在的段，由链接器生成 */
+extern uint8_t __start_noinit[];
+extern uint8_t __stop_noinit[];
+
+static char            s_path[256];
+static uint8_t         s_locked = 1;
+static SimFlashStats_t s_stats;
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    s_locked = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    s_locked = 1;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data)
+{
+    uintptr_t base = (uintptr_t)_flashlog_start;
+    uint16_t old, val = (uint16_t)Data;
+
+    if (s_locked || TypeProgram != FLASH_TYPEPROGRAM_HALFWORD ||
+        Address < base || Address + 2U > base + SIM_FLASH_SIZE || (Address & 1U) != 0U)
+    {
+        return HAL_ERROR;
+    }
+
+    /* 和 STM32F1 一样：半字不是 0xFFFF 时只允许写 0（PGERR） */
+    memcpy(&old, (void *)Address, sizeof(old));
+    if (old != 0xFFFFU && val != 0U)
+    {
+        return HAL_ERROR;
+    }
+    memcpy((void *)Address, &val, sizeof(val));
+    s_stats.programs++;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError)
+{
+    uintptr_t base = (uintptr_t)_flashlog_start;
+    uintptr_t addr = pEraseInit->PageAddress;
+
+    if (s_locked || addr < base || (addr - base) % FLASH_LOG_PAGE_SIZE != 0U ||
+        addr - base + (uintptr_t)pEraseInit->NbPages * FLASH_LOG_PAGE_SIZE > SIM_FLASH_SIZE)
+    {
+        *PageError = (uint32_t)addr;
+        return HAL_ERROR;
+    }
+
+    memset((void *)addr, 0xFF, (size_t)pEraseInit->NbPages * FLASH_LOG_PAGE_SIZE);
+    s_stats.erases += pEraseInit->NbPages;
+    *PageError = 0xFFFFFFFFUL;
+    return HAL_OK;
+}
+
+int SimFlash_Open(const char *path)
+{
+    FILE *f;
+
+    snprintf(s_path, sizeof(s_path), "%s", path);
+    memset(_flashlog_start, 0xFF, sizeof(_flashlog_start));
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    f = fopen(s_path, "rb");
+    if (f != NULL)
+    {
+        size_t n = fread(_flashlog_start, 1, sizeof(_flashlog_start), f);
+        fclose(f);
+        if (n != sizeof(_flashlog_start))
+        {
+            memset(_flashlog_start, 0xFF, sizeof(_flashlog_start));
+        }
+    }
+    return 0;
+}
+
+void SimFlash_Close(void)
+{
+    FILE *f = fopen(s_path, "wb");
+
+    if (f == NULL)
+    {
+        perror(s_path);
+        return;
+    }
+    fwrite(_flashlog_start, 1, sizeof(_flashlog_start), f);
+    fclose(f);
+}
+
+const SimFlashStats_t *SimFlash_GetStats(void)
+{
+    return &s_stats;
+}
+
+void SimNoinit_Load(const char *path)
+{
+    size_t size = (size_t)(__stop_noinit - __start_noinit);
+    FILE *f = fopen(path, "rb");
+
+    memset(__start_noinit, 0, size);
+    if (f == NULL)
+    {
+        return;
+    }
+    if (fread(__start_noinit, 1, size, f) != size)
+    {
+        memset(__start_noinit, 0, size);
+    }
+    fclose(f);
+    remove(path);
+}
+
+void SimNoinit_Save(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL)
+    {
+        perror(path);
+        return;
+    }
+    fwrite(__start_noinit, 1, (size_t)(__stop_noinit - __start_noinit), f);
+    fclose(f);
+}
@@ -0,0 +1,33 @@
+/*
+ * 主机仿真片内 Flash：flashlog.c 用的 FLASHLOG 区换成主机数组，提供 HAL_FLASH 替身
+ * - 和真实 Flash 一样只能把 1 改成 0：编程非 0xFFFF 的半字返回错误，擦除整页置 0xFF
+ * - 内容保存在镜像旁的 <镜像>.flash 文件里，下次运行接着用（仿真复位后恢复积压）
+ * - 另外仿真 .noinit RAM（NOINIT_RAM）：热复位时存进 <镜像>.ram，下次运行启动时读回
+ */
+
+#ifndef __SIM_FLASH_H
+#define __SIM_FLASH_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t erases;        /* 擦除页数 */
+    uint32_t programs;      /* 编程半字数 */
+} SimFlashStats_t;
+
+/* 读入 path（不存在时全部为 0xFF），返回 0 成功 */
+int  SimFlash_Open(const char *path);
+
+/* 写回文件 */
+void SimFlash_Close(void);
+
+const SimFlashStats_t *SimFlash_GetStats(void);
+
+/* 读回 path 里的 .noinit 内容并删掉文件（只恢复一次），没有文件时清零，相当于上电复位 */
+void SimNoinit_Load(const char *path);
+
+/* 热复位：.noinit 内容存进 path */
+void SimNoinit_Save(const char *path);
+
+#endif
@@ -0,0 +1,420 @@
+/*
+ * 日志写入链路的主机仿真（sdcard.c -> FatFs -> sim_diskio.c -> 镜像文件）
+ *
+ * 编译：
+ *   cmake -S tools/host_sim -B build-sim && cmake --build build-sim
+ * 用法：
+ *   build-sim/fatsim [选项]
+ *     -i <文件>   镜像文件，默认 sim.img；不存在时新建并格式化
+ *     -m <MB>     新建镜像大小，默认 64
+ *     -f          强制重新格式化
+ *     -a <字节>   格式化的簇大小，默认 0：和 #FORMAT YES 一样经 SD_Card_Format 格式化（SD_FORMAT_CLUSTER）
+ *     -E <扇区>   模拟卡的擦除块大小，默认 8192（4MB）
+ *     -n <条数>   记录条数，默认 10000
+ *     -p <ms>     记录间隔，默认 SD_LOG_PERIOD_MS
+ *     -e <扇区>   同步策略：每写多少扇区同步一次（SD_SYNC_EVERY_SECTORS）
+ *     -t <ms>     同步策略：同步间隔（SD_SYNC_INTERVAL_MS）
+ *     -r/-w <us>  每扇区读/写延迟
+ *     -b <us>     每次写命令后卡的编程忙时间（后台进行，下一次访问前才等）
+ *     -s          延迟真实 sleep（默认只累计到仿真时间）
+ *     -T <unix秒> 起始时间，默认 2025-10-18 00:00:00 UTC
+ *     -N <LSB>    叠加在模拟数据上的随机噪声幅度（定点最低位），默认 2
+ *     -o <第几条>:<条数>  从第几条记录起拔卡，过这么多条后插回（片内 Flash 后备，见 flashlog.h）
+ *     -R <条数>   记录这么多条后仿真热复位（看门狗）：不关文件直接退出，.noinit 存进 <镜像>.ram，
+ *                 下次不带 -f 运行时 SD_Card_Init 补写复位前没写上卡的记录（见 sdjournal.h）
+ *     -v          记录完后用 SD_Card_Locate / SD_Card_ReadNext 读回全部记录并校验
+ *     -B <文件>   记录完后按批量下载（#DL，见 query.h）的方式把 -T 起的全部块导出成版本 2 的 .BIN：
+ *                 先读一半，再像断线续传那样重新定位、从下一块编号接着读，log_decoder.py 解码核对
+ *
+ * 片内 Flash 的内容存在 <镜像>.flash，-f 时清空；拔卡期间没转存完的记录下次运行时转存。
+ * 例：fatsim -f -n 1234 -R 1234 -e 0 -t 0，再 fatsim -n 100 -T 1760751770，
+ * 最后 fatsim -n 0 -v 读回全部 1334 条，序号不跳变。
+ *
+ * rawsim（SD_LOG_RAW=1）：镜像只有一个类型 0xDA 的裸分区，-f 或没有裸分区时重建分区表
+ * 并清掉分区头；-a 不用。小镜像（如 -m 1）配合大 -n 可以仿真环形区写满回绕。
+ * 导出：python log_decoder.py --raw sim.img -o out.csv
+ *
+ * 镜像带 MBR 分区表，可在 Linux 下用
+ *   sudo mount -o loop,offset=$((<起始扇区>*512)) sim.img /mnt
+ * 挂载查看，或直接用 fdisk -l 看分区起始扇区。日志文件可用 log_decoder.py 解码。
+ */
+
+#include "crc16.h"
+#include "fatfs.h"
+#include "flashlog.h"
+#include "logrec.h"
+#include "sdcard.h"
+#include "sim_diskio.h"
+#include "sim_flash.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SIM_HOT_SECTORS     8U
+#define SIM_POLLS_PER_RECORD 8U     /* 每条记录后调用 SD_Card_Poll 的次数，间隔 1ms */
+
+#if SD_LOG_RAW
+/* 写一个只有裸分区的 MBR（和 fdisk 建 0xDA 分区一样），并清掉分区头让固件重新格式化 */
+static int Sim_RawPartition(uint8_t format)
+{
+    static uint8_t mbr[512];
+    static const uint8_t zero[512];
+    uint32_t start = (SimDisk_Sectors() >= 8192U) ? 2048U : 63U;
+    uint32_t count = SimDisk_Sectors() - start;
+
+    if (disk_initialize(0) != 0 || disk_read(0, mbr, 0, 1) != RES_OK)
+    {
+        return -1;
+    }
+    if (!format && mbr[510] == 0x55U && mbr[511] == 0xAAU && mbr[446 + 4] == LOG_RAW_PART_TYPE)
+    {
+        return 0;
+    }
+
+    memset(mbr, 0, sizeof(mbr));
+    mbr[446 + 4] = LOG_RAW_PART_TYPE;
+    memcpy(&mbr[446 + 8], &start, sizeof(start));
+    memcpy(&mbr[446 + 12], &count, sizeof(count));
+    mbr[510] = 0x55U;
+    mbr[511] = 0xAAU;
+    if (disk_write(0, mbr, 0, 1) != RES_OK || disk_write(0, zero, start, 1) != RES_OK)
+    {
+        return -1;
+    }
+    printf("已建立裸分区: 起始扇区 %lu, %lu 扇区\n", (unsigned long)start, (unsigned long)count);
+    return 0;
+}
+#endif
+
+static double Sim_Noise(uint32_t lsb, double scale)
+{
+    return (lsb == 0U) ? 0.0 : ((rand() % (int)(2U * lsb + 1U)) - (int)lsb) / scale;
+}
+
+static void Sim_Report(const char *title, uint32_t records)
+{
+    const SimDiskStats_t *st = SimDisk_GetStats();
+    uint32_t sector[SIM_HOT_SECTORS], count[SIM_HOT_SECTORS];
+    double logged = (double)records * LOG_RECORD_SIZE;
+
+    printf("== %s ==\n", title);
+    printf("  写命令 %llu 次, 写扇区 %llu（引导 %llu / FAT %llu / 根目录 %llu / 数据 %llu）\n",
+           (unsigned long long)st->write_cmds, (unsigned long long)st->write_sectors,
+           (unsigned long long)st->write_boot, (unsigned long long)st->write_fat,
+           (unsigned long long)st->write_root, (unsigned long long)st->write_data);
+    printf("  读命令 %llu 次, 读扇区 %llu\n",
+           (unsigned long long)st->read_cmds, (unsigned long long)st->read_sectors);
+    printf("  重复改写扇区 %llu, 驱动阻塞时间 %.3f s\n",
+           (unsigned long long)st->rewrite_sectors, st->busy_us / 1e6);
+    printf("  元数据缓存: 读命中 %lu / 未命中 %lu, 写入 %lu 次, 实际写卡 %lu 扇区\n",
+           (unsigned long)st->cache_hits, (unsigned long)st->cache_misses,
+           (unsigned long)st->cache_absorbed, (unsigned long)st->cache_written);
+
+    if (records != 0U)
+    {
+        printf("  每条记录: 写扇区 %.4f, 读扇区 %.4f, 阻塞 %.1f us\n",
+               (double)st->write_sectors / records, (double)st->read_sectors / records,
+               (double)st->busy_us / records);
+        printf("  写放大 %.2f（写入字节 / 记录字节）\n",
+               (double)st->write_sectors * 512.0 / logged);
+    }
+
+    uint32_t n = SimDisk_HotSectors(sector, count, SIM_HOT_SECTORS);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        printf("  热点扇区 %lu: 写 %lu 次\n", (unsigned long)sector[i], (unsigned long)count[i]);
+    }
+}
+
+/* 像上位机查询一样从头读回全部记录，检查条数、时间和序号 */
+static void Sim_Verify(uint32_t start, uint32_t records)
+{
+    static LogRecord_t buf[32];
+    SD_LogCursor_t cur;
+    uint32_t total = 0, gaps = 0, bad = 0;
+    int last = -1;
+
+    SD_Card_Sync();
+    SimDisk_ResetStats();
+    if (SD_Card_Locate(start, &cur) != 0)
+    {
+        printf("== 读回 ==\n  SD_Card_Locate 失败\n");
+        return;
+    }
+
+    for (;;)
+    {
+        int n = SD_Card_ReadNext(&cur, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            break;
+        }
+        for (int i = 0; i < n / (int)LOG_RECORD_SIZE; i++)
+        {
+            if (buf[i].crc != CRC16_Calc(&buf[i], LOG_RECORD_SIZE - 2U))
+            {
+                bad++;
+            }
+            if (last >= 0 && buf[i].seq != (uint8_t)(last + 1))
+            {
+                gaps++;
+            }
+            last = buf[i].seq;
+            total++;
+        }
+    }
+
+    printf("== 读回 ==\n  %lu / %lu 条, CRC 错误 %lu, 序号跳变 %lu\n",
+           (unsigned long)total, (unsigned long)records, (unsigned long)bad, (unsigned long)gaps);
+    Sim_Report("读回", 0);
+}
+
+/* 仿真 #DL：文件头 + 块编号 [起始, 一半) 的块，再从头定位续传剩下的块 */
+static void Sim_Export(uint32_t start, const char *path)
+{
+    static uint8_t blk[LOG_BLOCK_SIZE];
+    SD_LogCursor_t base, cur;
+    uint32_t first, total = 0, gone = 0, half = 0;
+    FILE *fp;
+
+    SD_Card_Sync();
+    SimDisk_ResetStats();
+    if (SD_Card_Locate(start, &base) != 0 || (fp = fopen(path, "wb")) == NULL)
+    {
+        printf("== 导出 ==\n  定位或打开 %s 失败\n", path);
+        return;
+    }
+    SD_Card_GetHeader(blk);
+    fwrite(blk, 1, LOG_HEADER_SIZE, fp);
+
+    first = SD_Card_SeekBlock(&base, SD_LOG_RAW ? base.offset : 0U, &cur);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        uint32_t idx = SD_Card_SeekBlock(&base, first + half, &cur);
+        for (;; idx++)
+        {
+            if (pass == 0 && half == 0U)
+            {
+                /* 第一遍先数出总块数，只读一半 */
+                SD_LogCursor_t tmp = cur;
+                uint32_t n = 0;
+                while (SD_Card_ReadRawBlock(&tmp, blk) > 0)
+                {
+                    n++;
+                }
+                half = n / 2U;
+            }
+            if (pass == 0 && idx - first >= half)
+            {
+                break;
+            }
+            int got = SD_Card_ReadRawBlock(&cur, blk);
+            if (got <= 0)
+            {
+                break;
+            }
+            if (got == 2)
+            {
+                gone++;
+                continue;
+            }
+            fwrite(blk, 1, LOG_BLOCK_SIZE, fp);
+            total++;
+        }
+    }
+    fclose(fp);
+
+    printf("== 导出 ==\n  %lu 块（续传点 %lu，已不存在 %lu）-> %s\n",
+           (unsigned long)total, (unsigned long)(first + half), (unsigned long)gone, path);
+    Sim_Report("导出", 0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *image = "sim.img";
+    uint32_t size_mb = 64, au = 0, records = 10000, period = SD_LOG_PERIOD_MS;
+    uint32_t every = SD_SYNC_EVERY_SECTORS, interval = SD_SYNC_INTERVAL_MS;
+    uint32_t start = 1760745600UL;
+    uint32_t noise = 2;
+    uint8_t  format = 0, verify = 0, card_format = 0;
+    const char *export_path = NULL;
+    uint32_t out_from = 0, out_count = 0, reset_at = 0;
+    char     flash_path[256], ram_path[256];
+    SimDiskConfig_t cfg = { 0, 0, 0, 8192U, 0 };
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "i:m:fa:E:n:p:e:t:r:w:b:sT:N:o:R:vB:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i': image = optarg; break;
+            case 'm': size_mb = strtoul(optarg, NULL, 0); break;
+            case 'f': format = 1; break;
+            case 'a': au = strtoul(optarg, NULL, 0); break;
+            case 'E': cfg.erase_block = strtoul(optarg, NULL, 0); break;
+            case 'n': records = strtoul(optarg, NULL, 0); break;
+            case 'p': period = strtoul(optarg, NULL, 0); break;
+            case 'e': every = strtoul(optarg, NULL, 0); break;
+            case 't': interval = strtoul(optarg, NULL, 0); break;
+            case 'r': cfg.read_us = strtoul(optarg, NULL, 0); break;
+            case 'w': cfg.write_us = strtoul(optarg, NULL, 0); break;
+            case 'b': cfg.busy_us = strtoul(optarg, NULL, 0); break;
+            case 's': cfg.real_sleep = 1; break;
+            case 'T': start = strtoul(optarg, NULL, 0); break;
+            case 'N': noise = strtoul(optarg, NULL, 0); break;
+            case 'o': sscanf(optarg, "%u:%u", &out_from, &out_count); break;
+            case 'R': reset_at = strtoul(optarg, NULL, 0); break;
+            case 'v': verify = 1; break;
+            case 'B': export_path = optarg; break;
+            default:
+                fprintf(stderr, "用法见 sim_main.c 文件头注释\n");
+                return 2;
+        }
+    }
+
+    if (SimDisk_Open(image, size_mb, &cfg) != 0)
+    {
+        return 1;
+    }
+    snprintf(flash_path, sizeof(flash_path), "%s.flash", image);
+    snprintf(ram_path, sizeof(ram_path), "%s.ram", image);
+    if (format)
+    {
+        remove(flash_path);
+        remove(ram_path);
+    }
+    SimFlash_Open(flash_path);
+    SimNoinit_Load(ram_path);
+    MX_FATFS_Init();
+
+#if SD_LOG_RAW
+    (void)au;
+    if (Sim_RawPartition(format) != 0)
+    {
+        fprintf(stderr, "建立裸分区失败\n");
+        return 1;
+    }
+#else
+    /* 没有文件系统或指定 -f 时格式化（FDISK 分区，和 PC 格式化的 SD 卡一样） */
+    f_mount(&USERFatFS, USERPath, 0);
+    if (format || f_mount(&USERFatFS, USERPath, 1) == FR_NO_FILESYSTEM)
+    {
+        if (au == 0U)
+        {
+            card_format = 1;    /* 挂载前由 SD_Card_Format 格式化，和 #FORMAT YES 同一路径 */
+        }
+        else
+        {
+            ret = f_mkfs(USERPath, 0, au);
+            if (ret != FR_OK)
+            {
+                fprintf(stderr, "f_mkfs 失败: %d\n", ret);
+                return 1;
+            }
+            printf("已格式化 %s: %lu 扇区\n", image, (unsigned long)SimDisk_Sectors());
+        }
+    }
+    f_mount(NULL, USERPath, 1);
+#endif
+
+    SD_Card_SetSyncPolicy((uint16_t)every, interval);
+    SD_Card_SetTime(start);
+    SimDisk_ResetStats();
+
+    ret = card_format ? SD_Card_Format() : SD_Card_Init();
+    if (ret != 0)
+    {
+        fprintf(stderr, "SD_Card_Init 失败: %d\n", ret);
+        return 1;
+    }
+#if SD_LOG_RAW
+    printf("裸分区, 擦除块 %lu 扇区, 同步策略 %lu 扇区 / %lu ms\n",
+           (unsigned long)cfg.erase_block, (unsigned long)every, (unsigned long)interval);
+#else
+    printf("FAT%s, 簇 %u 扇区, 擦除块 %lu 扇区, 同步策略 %lu 扇区 / %lu ms\n",
+           USERFatFS.fs_type == FS_FAT32 ? "32" : (USERFatFS.fs_type == FS_FAT16 ? "16" : "12"),
+           USERFatFS.csize, (unsigned long)cfg.erase_block,
+           (unsigned long)every, (unsigned long)interval);
+#endif
+    Sim_Report("挂载并打开日志", 0);
+    SimDisk_ResetStats();
+
+    /* -o 0:N：像不插卡上电一样重新初始化一次 */
+    if (out_count != 0U && out_from == 0U)
+    {
+        SD_Card_Deinit();
+        SimDisk_SetPresent(0);
+        SD_Card_Init();
+    }
+
+    /* 缓慢变化的模拟水质数据，叠加 ADC 噪声 */
+    srand(1);
+    for (uint32_t i = 0; i < records; i++)
+    {
+        double x = i * 0.001;
+        if (out_count != 0U && i == out_from)
+        {
+            SimDisk_SetPresent(0);
+        }
+        if (out_count != 0U && i == out_from + out_count)
+        {
+            SimDisk_SetPresent(1);
+        }
+        SimDisk_AdvanceMs((period > SIM_POLLS_PER_RECORD) ? period - SIM_POLLS_PER_RECORD : 0U);
+        ret = SD_Card_Log((float)(7.0 + 0.3 * sin(x) + Sim_Noise(noise, 100.0)),
+                          (float)(320.0 + 15.0 * sin(x * 0.7) + Sim_Noise(noise, 1.0)),
+                          (float)(21.0 + 2.0 * sin(x * 0.3) + Sim_Noise(noise, 100.0)),
+                          (float)(1.5 + 0.2 * sin(x * 1.3) + Sim_Noise(noise, 10.0)));
+        if (ret != 0)
+        {
+            fprintf(stderr, "第 %lu 条 SD_Card_Log 失败: %d\n", (unsigned long)i, ret);
+            break;
+        }
+
+        /* 主循环每次被 SysTick 唤醒都会调用 SD_Card_Poll，这里只仿真采样后的前几次 */
+        for (uint32_t k = 0; k < SIM_POLLS_PER_RECORD; k++)
+        {
+            SD_Card_Poll();
+            SimDisk_AdvanceMs(1);
+        }
+
+        /* 热复位：RAM 里的文件系统状态、队列和暂存块全部丢失，只留下卡、Flash 和 .noinit */
+        if (reset_at != 0U && i + 1U == reset_at)
+        {
+            printf("== 第 %lu 条后热复位 ==\n", (unsigned long)reset_at);
+            SimNoinit_Save(ram_path);
+            SimFlash_Close();
+            SimDisk_Close();
+            return 0;
+        }
+    }
+    Sim_Report("记录", records);
+    {
+        const SimFlashStats_t *fst = SimFlash_GetStats();
+        uint16_t pending;
+        uint32_t dropped, releaseErrors;
+        FlashLog_GetStats(&pending, &dropped, &releaseErrors);
+        printf("  片内 Flash: 擦除 %lu 页, 编程 %lu 半字, 待转存 %u 块, 覆盖丢弃 %lu 块, 作废失败 %lu 次\n",
+               (unsigned long)fst->erases, (unsigned long)fst->programs, pending, (unsigned long)dropped,
+               (unsigned long)releaseErrors);
+    }
+
+    if (verify)
+    {
+        Sim_Verify(start, records);
+    }
+    if (export_path != NULL)
+    {
+        Sim_Export(start, export_path);
+    }
+
+    SimDisk_ResetStats();
+    SD_Card_Deinit();
+    Sim_Report("关闭", 0);
+
+    SimFlash_Close();
+    SimDisk_Close();
+    return 0;
+}